@@ -0,0 +1,276 @@
+/***************************************************************
+ *
+ * Benchmark of IO's write paths.
+ *
+ * Every case writes records of a given size through one API
+ * (WriteString() or Write()) and one mode string, timing each call.
+ * Results are written as one CSV line per case. "peak_cached_MiB" is
+ * the most of the file found in the page cache while writing (sampled
+ * NB_CACHE_SAMPLES times, outside the timed calls and the totals), and
+ * "cached_MiB" what is still there after Close_File(): memory the output
+ * took from the rest of the node ("w:stream" bounds it).
+ *
+ *
+ *      ./io_benchmark [results.csv] [megabytes per case]
+ *
+ * (default: output/benchmark.csv, 64 MiB per case.)
+ *
+ ***************************************************************/
+
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm> // std::sort(), std::replace(), std::max()
+#include <time.h>    // clock_gettime()
+#include <unistd.h>  // gethostname(), sysconf()
+#include <fcntl.h>   // open()
+#include <sys/mman.h> // mmap(), mincore()
+#include <sys/stat.h> // fstat()
+
+#include <StdCout.hpp>
+#include <InputOutput.hpp>
+
+// Page cache samples taken while a case writes
+#define NB_CACHE_SAMPLES 64
+
+// **************************************************************
+double Wall_Time()
+/**
+ * Monotonic: per-call latencies are well below gettimeofday()'s resolution.
+ */
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return double(now.tv_sec) + 1.0e-9*double(now.tv_nsec);
+}
+
+// **************************************************************
+double Cached_Megabytes(const std::string &filename)
+/**
+ * Part of the file resident in the page cache (mincore() of a mapping,
+ * which does not itself read the file).
+ */
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return 0.0;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        close(fd);
+        return 0.0;
+    }
+
+    const size_t size = size_t(file_stat.st_size);
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return 0.0;
+
+    const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> resident((size + page_size - 1) / page_size);
+    size_t nb_resident = 0;
+    if (mincore(mapping, size, &resident[0]) == 0)
+    {
+        for (size_t i = 0 ; i < resident.size() ; i++)
+            nb_resident += (resident[i] & 1);
+    }
+    munmap(mapping, size);
+
+    return double(nb_resident) * double(page_size) / (1024.0 * 1024.0);
+}
+
+// **************************************************************
+void Sample_Cache(const std::string &filename, double &peak, double &sampling_time)
+{
+    const double start = Wall_Time();
+    peak = std::max(peak, Cached_Megabytes(filename));
+    sampling_time += Wall_Time() - start;
+}
+
+// **************************************************************
+struct Case
+{
+    std::string api;        // "WriteString" or "Write"
+    std::string mode;       // Mode string given to Open_File()
+    bool using_C_fh;
+    size_t record_size;
+    int nb_records;
+};
+
+// **************************************************************
+double Percentile(std::vector<double> &latencies, const double p)
+/**
+ * Nearest-rank percentile. "latencies" must be sorted.
+ */
+{
+    if (latencies.empty())
+        return 0.0;
+    size_t rank = size_t(p * double(latencies.size()));
+    if (rank >= latencies.size())
+        rank = latencies.size() - 1;
+    return latencies[rank];
+}
+
+// **************************************************************
+void Run(const Case &c, FILE *results, const std::string &host)
+{
+    std::string name = c.mode;
+    std::replace(name.begin(), name.end(), ':', '_');
+    std::replace(name.begin(), name.end(), '=', '_');
+    const std::string filename = "output/benchmark_" + name + ".dat";
+
+    // WriteString() prints the record as a string ("%s\n") so its
+    // size is controlled; the difference with Write() is the cost of
+    // the formatting path.
+    std::string record(c.record_size, 'x');
+    record[c.record_size-1] = '\n';
+    const std::string line = record.substr(0, c.record_size-1);
+
+    std::vector<double> latencies(c.nb_records);
+
+    IO output(true);
+    output.Set_Filename(filename);
+    const double open_time = Wall_Time();
+    if (!output.Open_File(c.mode, true, c.using_C_fh, false))
+    {
+        std_cout << "ERROR: Could not open '" << output.Get_Filename() << "' in mode '" << c.mode << "'. Skipping case.\n" << std::flush;
+        return;
+    }
+
+    // With the extension added by compressed modes
+    const std::string written_filename = output.Get_Filename();
+    const int sample_interval = std::max(1, c.nb_records / NB_CACHE_SAMPLES);
+    double peak_cached = 0.0;
+    double sampling_time = 0.0;
+
+    double in_calls = 0.0;
+    if (c.api == "WriteString")
+    {
+        for (int i = 0 ; i < c.nb_records ; i++)
+        {
+            const double start = Wall_Time();
+            output.WriteString("%s\n", line.c_str());
+            latencies[i] = Wall_Time() - start;
+            in_calls += latencies[i];
+            if ((i+1) % sample_interval == 0)
+                Sample_Cache(written_filename, peak_cached, sampling_time);
+        }
+    }
+    else
+    {
+        for (int i = 0 ; i < c.nb_records ; i++)
+        {
+            const double start = Wall_Time();
+            output.Write(record.c_str(), c.record_size);
+            latencies[i] = Wall_Time() - start;
+            in_calls += latencies[i];
+            if ((i+1) % sample_interval == 0)
+                Sample_Cache(written_filename, peak_cached, sampling_time);
+        }
+    }
+    const double close_start = Wall_Time();
+    output.Close_File();
+    const double close_time = Wall_Time() - close_start;
+    const double total = Wall_Time() - open_time - sampling_time;
+
+    const double cached = Cached_Megabytes(written_filename);
+    peak_cached = std::max(peak_cached, cached);
+    remove(written_filename.c_str());
+
+    std::sort(latencies.begin(), latencies.end());
+    const double megabytes = double(c.record_size) * double(c.nb_records) / (1024.0 * 1024.0);
+
+    // Throughput includes Close_File(): what is buffered must still be written.
+    fprintf(results, "%s,%s,%s,%s,%lu,%d,%.6f,%.6f,%.6f,%.3f,%.1f,%.3f,%.3f,%.3f,%.1f,%.1f\n",
+            host.c_str(), c.api.c_str(), c.mode.c_str(), (c.using_C_fh ? "C" : "C++"),
+            (unsigned long) c.record_size, c.nb_records,
+            total, in_calls, close_time,
+            megabytes / total, double(c.nb_records) / total,
+            1.0e6 * Percentile(latencies, 0.50),
+            1.0e6 * Percentile(latencies, 0.99),
+            1.0e6 * latencies.back(),
+            peak_cached, cached);
+    fflush(results);
+
+    std_cout
+        << c.api << " '" << c.mode << "' (" << (c.using_C_fh ? "C" : "C++") << "), "
+        << c.nb_records << " x " << c.record_size << " B: "
+        << megabytes / total << " MB/s, "
+        << double(c.nb_records) / total << " calls/s, "
+        << "p50 = " << 1.0e6 * Percentile(latencies, 0.50) << " us, "
+        << "p99 = " << 1.0e6 * Percentile(latencies, 0.99) << " us, "
+        << peak_cached << " MiB cached at most, " << cached << " after close\n";
+}
+
+// **************************************************************
+int main(int argc, char *argv[])
+{
+    const std::string results_filename = (argc > 1 ? argv[1] : "output/benchmark.csv");
+    const double megabytes_per_case = (argc > 2 ? atof(argv[2]) : 64.0);
+
+    Create_Folder_If_Does_Not_Exists("output");
+    std_cout.open("output/benchmark.log");
+
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+
+    FILE *results = fopen(results_filename.c_str(), "w");
+    if (results == NULL)
+    {
+        std_cout << "ERROR: Could not open '" << results_filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+    fprintf(results, "host,api,mode,handle,record_bytes,nb_records,total_s,in_calls_s,close_s,MB_per_s,calls_per_s,p50_us,p99_us,max_us,peak_cached_MiB,cached_MiB\n");
+
+    // C++ fstream, C FILE*, gzip, then the buffered and alternative backends
+    std::vector<Case> cases;
+    const char *modes[] = {"w", "w:C", "wz",
+                           "w:async=65536", "w:async=1048576", "w:async=16777216",
+                           "wz:threads=4", "w:mmap", "w:uring", "w:gather", "w:stream"};
+    const size_t record_sizes[] = {16, 256, 4096, 65536};
+    const char *apis[] = {"WriteString", "Write"};
+
+    for (size_t m = 0 ; m < sizeof(modes)/sizeof(modes[0]) ; m++)
+    {
+        for (size_t a = 0 ; a < sizeof(apis)/sizeof(apis[0]) ; a++)
+        {
+            for (size_t r = 0 ; r < sizeof(record_sizes)/sizeof(record_sizes[0]) ; r++)
+            {
+                // WriteString() formats into a 1 KiB buffer
+                if (std::string(apis[a]) == "WriteString" && record_sizes[r] > 1024)
+                    continue;
+
+                Case c;
+                c.api           = apis[a];
+                c.mode          = modes[m];
+                c.using_C_fh    = false;
+                // "w:C" is not a mode: it stands for "w" through a C FILE*
+                if (c.mode == "w:C")
+                {
+                    c.mode       = "w";
+                    c.using_C_fh = true;
+                }
+                c.record_size   = record_sizes[r];
+                c.nb_records    = int(megabytes_per_case * 1024.0 * 1024.0 / double(c.record_size));
+                // gzip is much slower: keep its cases short
+                if (c.mode[1] == 'z')
+                    c.nb_records /= 8;
+                if (c.nb_records < 1)
+                    c.nb_records = 1;
+                cases.push_back(c);
+            }
+        }
+    }
+
+    for (size_t i = 0 ; i < cases.size() ; i++)
+        Run(cases[i], results, host);
+
+    fclose(results);
+    std_cout << "Results written to '" << results_filename << "'\n";
+
+    return EXIT_SUCCESS;
+}
+
+// ********** End of file ***************************************
@@ -1,6 +1,7 @@
 
 #ifdef NETCDF
 
+#include <cstdlib>  // std::abs()
 #include <stdint.h> // (u)int64_t
 #include <sys/time.h> // timeval
 #include <exception>
@@ -10,6 +11,7 @@
 
 #include "Classes_NetCDF.hpp"
 #include "InputOutput.hpp"
+#include "IO_Migrator.hpp"
 
 template <class Integer>
 inline std::string IntToStr(const Integer integer, const int width = 0, const char fill = ' ')
@@ -300,6 +302,22 @@ void NetCDF_Variable::Write()
     }
 }
 
+// **************************************************************
+size_t NetCDF_Variable::Get_Bytes()
+/**
+ * Size of the data Write() sends.
+ */
+{
+    size_t type_size = 0;
+    call_netcdf_and_test(nc_inq_type(ncid, netcdf_type, NULL, &type_size), "nc_inq_type(), variable name: " + name);
+
+    size_t count = 1;
+    for (size_t i = 0 ; i < dimensions.Ns.size() ; i++)
+        count *= size_t(std::abs(dimensions.Ns[i]));
+
+    return count * type_size;
+}
+
 // **************************************************************
 void NetCDF_Variable::Print() const
 {
@@ -319,20 +337,25 @@ void NetCDF_Variable::Print() const
 // **************************************************************
 NetCDF_Out::NetCDF_Out()
 {
+    priority     = IO_Rate_Limiter::Snapshot;
     is_opened    = false;
     is_committed = false;
     is_written   = false;
+    is_emergency_client = false;
 }
 
 // **************************************************************
 NetCDF_Out::NetCDF_Out(const std::string _path, const std::string _filename, const bool netcdf4)
 {
+    priority = IO_Rate_Limiter::Snapshot;
     Open(_path, _filename, netcdf4);
 }
 
 // **************************************************************
 NetCDF_Out::NetCDF_Out(std::string _filename, const bool netcdf4)
 {
+    priority = IO_Rate_Limiter::Snapshot;
+
     // Extract the path from filename
     std::string path;
     size_t found = _filename.rfind("/");
@@ -365,10 +388,21 @@ void NetCDF_Out::Open(const std::string _path, const std::string _filename, cons
     is_opened    = false;
     is_committed = false;
     is_written   = false;
+    is_emergency_client = false;
 
     filename = _path + "/" + _filename;
     is_netcdf4 = netcdf4;
 
+    // Shared-memory sink: the variables are only described to the channel.
+    if (channel.Is_Enabled())
+    {
+        if (durability.Is_Enabled() or streaming.Is_Enabled() or staging_folder != "")
+            throw std::ios_base::failure("A shared-memory channel can't be combined with durability, streaming or staging for \"" + filename + "\".");
+        ncid = -1;
+        is_opened = true;
+        return;
+    }
+
     // Make sure output folder exists
     Create_Folder_If_Does_Not_Exists(_path);
 
@@ -377,7 +411,19 @@ void NetCDF_Out::Open(const std::string _path, const std::string _filename, cons
     int nb_try = 1;
     const int netcdf_filetype = (is_netcdf4 ? NC_NETCDF4 : NC_CLOBBER);
 
-    while (nc_create(filename.c_str(), netcdf_filetype, &ncid) != NC_NOERR)
+    // Durability policy: the file may be created under a temporary name.
+    std::string create_filename = (durability.Is_Enabled() ? durability.Open(filename) : filename);
+
+    // Staging: created in a node-local folder, migrated once closed.
+    if (staging_folder != "")
+    {
+        if (durability.Is_Enabled())
+            throw std::ios_base::failure("Staging and a durability policy can't be combined for file \"" + filename + "\".");
+        staged_filename = IO_Migrator::Instance().Stage(staging_folder, filename);
+        create_filename = staged_filename;
+    }
+
+    while (nc_create(create_filename.c_str(), netcdf_filetype, &ncid) != NC_NOERR)
     {
         // Sleep 5 seconds before retrying
         std_cout << "WARNING: Could not open file \"" << filename << "\" for writting (" << nb_try << "/" << max_nb_try << "). " << std::flush;
@@ -395,6 +441,12 @@ void NetCDF_Out::Open(const std::string _path, const std::string _filename, cons
 
     is_opened    = true;
 
+    if (streaming.Is_Enabled())
+        streaming.Open(create_filename);
+
+    // Saved if the process dies before Close() (see IO_Emergency_Enable())
+    is_emergency_client = IO_Emergency_Register(this);
+
     // Disable filling. We will be writting right away, so filling is useless.
     int old_modep;
     call_netcdf_and_test( nc_set_fill(ncid, NC_NOFILL, &old_modep), "nc_set_fill()");
@@ -413,6 +465,8 @@ void NetCDF_Out::Add_Variable(const std::string name, const int type_index,
     assert(is_opened);
     assert(pointer != NULL);
 
+    IO_Emergency_Guard guard(File_Lock());
+
     if (verbose)
         log("NetCDF_Out::Add_Variable() Adding variable '%s' (%p) of type '%d' (%s) to  file '%s'...\n",
             name.c_str(), pointer, type_index, netcdf_types_string[type_index], filename.c_str());
@@ -509,15 +563,18 @@ void NetCDF_Out::Add_Variable(const std::string name, const int type_index,
             }
 
             // Commit this dimension (set dimensions_ids[dim_name])
-            call_netcdf_and_test(
-                nc_def_dim(
-                    ncid,                       // File id
-                    dim_name.c_str(),           // Name of dimension
-                    dim_N,                      // Number of elements in that dimension
-                    &(dimensions_ids[dim_name]) // Dimension commit id pointer
-                ),
-                "nc_def_dim() (NetCDF_Out::Add_Variable()), dimension name: " + dim_name
-            );
+            if (not channel.Is_Enabled())
+            {
+                call_netcdf_and_test(
+                    nc_def_dim(
+                        ncid,                       // File id
+                        dim_name.c_str(),           // Name of dimension
+                        dim_N,                      // Number of elements in that dimension
+                        &(dimensions_ids[dim_name]) // Dimension commit id pointer
+                    ),
+                    "nc_def_dim() (NetCDF_Out::Add_Variable()), dimension name: " + dim_name
+                );
+            }
 
             if (verbose)
                 std_cout << "    NetCDF_Out::Add_Variable() 2. id committed: " << dimensions_ids[dim_name] << "\n";
@@ -532,6 +589,15 @@ void NetCDF_Out::Add_Variable(const std::string name, const int type_index,
     // Set the variable's dimension
     variables[name].Set_Dimension(dims, dimensions_ids);
 
+    if (channel.Is_Enabled())
+    {
+        std::vector<size_t> dim_sizes;
+        for (size_t i = 0 ; i < dims.size() ; i++)
+            dim_sizes.push_back(size_t(std::abs(dims.Ns[i])));
+        channel.Add_Variable(name, netcdf_types_string[variables[name].type_index], sizeof(T), dims.names, dim_sizes, units, pointer);
+        return;
+    }
+
     // Commit the variable
     variables[name].Commit();
 
@@ -596,12 +662,14 @@ void NetCDF_Out::Add_Variable(const std::string name,
 // **************************************************************
 void NetCDF_Out::Commit()
 {
+    IO_Emergency_Guard guard(File_Lock());
+
     if (verbose and is_opened)
         std_cout << "NetCDF_Out::Commit(this="<<this<<","<<filename<<", is_committed="<<(is_committed?"true ":"false")<<")..." << "\n";
 
     // Not needed for NetCDF4 (?)
     // End define mode. This tells netCDF we are done defining metadata.
-    if (not is_committed)
+    if (not is_committed and not channel.Is_Enabled())
         call_netcdf_and_test(nc_enddef(ncid), "nc_enddef() (NetCDF_Out::Commit())");
 
     is_committed = true;
@@ -610,15 +678,43 @@ void NetCDF_Out::Commit()
 // **************************************************************
 void NetCDF_Out::Write()
 {
+    IO_Emergency_Guard guard(File_Lock());
+
     if (verbose and is_opened)
         std_cout << "NetCDF_Out::Write(this="<<this<<","<<filename<<")..." << "\n";
 
     Commit();
 
+    // A snapshot for the channel's reader (dropped or waited for when it lags).
+    if (channel.Is_Enabled())
+    {
+        channel.Publish();
+        is_written = true;
+        return;
+    }
+
+    uint64_t bytes = 0;
+    for (std::map<std::string, NetCDF_Variable>::iterator it = variables.begin() ; it != variables.end(); it++ )
+        bytes += it->second.Get_Bytes();
+
+    // Drawn from the process' bandwidth before writing (see IO_Rate_Limiter).
+    if (priority != IO_Rate_Limiter::Unlimited and IO_Rate_Limiter::Instance().Is_Enabled())
+        IO_Rate_Limiter::Instance().Acquire(bytes, priority);
+
     for (std::map<std::string, NetCDF_Variable>::iterator it = variables.begin() ; it != variables.end(); it++ )
         it->second.Write();
 
     is_written = true;
+
+    // Whatever the library wrote out can leave the page cache.
+    streaming.Check();
+
+    // Group commit: after enough bytes or time since the last commit.
+    if (durability.Is_Enabled() and durability.Written(bytes))
+    {
+        call_netcdf_and_test(nc_sync(ncid), "nc_sync() (NetCDF_Out::Write())");
+        durability.Sync();
+    }
 }
 
 // **************************************************************
@@ -627,6 +723,11 @@ void NetCDF_Out::Close()
     if (verbose)
         std_cout << "NetCDF_Out::Close(this="<<this<<","<<filename<<")..." << "\n";
 
+    IO_Emergency_Unregister(this);
+
+    // The drain thread may still be saving the file: wait for it.
+    IO_Emergency_Guard guard(File_Lock());
+
     if (not is_committed)
         Commit();
 
@@ -635,10 +736,96 @@ void NetCDF_Out::Close()
 
     /* Close the file. This frees up any internal netCDF resources
      * associated with the file, and flushes any buffers. */
-    if (is_opened)
+    if (is_opened and channel.Is_Enabled())
+    {
+        channel.Close();
+    }
+    else if (is_opened)
+    {
         call_netcdf_and_test(nc_close(ncid), "nc_close() (NetCDF_Out::Close())");
 
+        streaming.Close();
+
+        // Final fsync and rename, once the file is closed.
+        durability.Close();
+
+        if (staged_filename != "")
+            IO_Migrator::Instance().Migrate(staged_filename, filename);
+        staged_filename = "";
+    }
+
     is_opened = false;
+    is_emergency_client = false;
+}
+
+// **************************************************************
+void NetCDF_Out::Emergency_Flush(const int signal_number, const bool is_fatal)
+/**
+ * At exit(), Close(). After a signal ending the process, the snapshot
+ * is written if it was not yet and the file closed (nc_close()), unless
+ * the owner is inside NetCDF_Out (its lock is still held after
+ * IO_EMERGENCY_LOCK_WAIT seconds). A durability policy is then not
+ * committed and a staged file not migrated. Nothing is done if the
+ * process goes on. Errors are ignored: the process is going down.
+ */
+{
+    if (signal_number != 0 and (not is_fatal or not emergency_lock.Try_Acquire(IO_EMERGENCY_LOCK_WAIT)))
+        return;
+
+    try
+    {
+        if (signal_number == 0)
+        {
+            Close();
+        }
+        else if (is_opened and not channel.Is_Enabled())
+        {
+            if (not is_written)
+                Write();
+            nc_close(ncid);
+            is_opened = false;
+        }
+    }
+    catch (...)
+    {
+    }
+    // After a signal, the lock is kept: the process ends next.
+}
+
+// **************************************************************
+void NetCDF_Out::Set_Durability(const IO_Durability &policy)
+{
+    if (is_opened)
+        throw std::ios_base::failure("NetCDF_Out::Set_Durability() must be called before opening file \"" + filename + "\".");
+
+    durability = policy;
+}
+
+// **************************************************************
+void NetCDF_Out::Set_Staging(const std::string folder)
+{
+    if (is_opened)
+        throw std::ios_base::failure("NetCDF_Out::Set_Staging() must be called before opening file \"" + filename + "\".");
+
+    staging_folder = folder;
+}
+
+// **************************************************************
+void NetCDF_Out::Set_Streaming(const IO_Streaming &policy)
+{
+    if (is_opened)
+        throw std::ios_base::failure("NetCDF_Out::Set_Streaming() must be called before opening file \"" + filename + "\".");
+
+    streaming = policy;
+}
+
+// **************************************************************
+void NetCDF_Out::Set_Channel(const IO_Shm_Channel &_channel)
+{
+    if (is_opened)
+        throw std::ios_base::failure("NetCDF_Out::Set_Channel() must be called before opening file \"" + filename + "\".");
+
+    channel = _channel;
 }
 
 // **************************************************************
@@ -11,6 +11,11 @@
 #include <map>
 #include <set>
 
+#include "IO_Durability.hpp"
+#include "IO_Streaming.hpp"
+#include "IO_Rate_Limiter.hpp"
+#include "IO_Emergency.hpp"
+#include "IO_Shm_Channel.hpp"
 
 #define NC_FDOUBLE -1000
 
@@ -119,10 +124,11 @@ public:
     void Units(const std::string units);
     void Commit();
     void Write();
+    size_t Get_Bytes();
     void Print() const;
 };
 
-class NetCDF_Out
+class NetCDF_Out : public IO_Emergency_Client
 {
 private:
     std::string filename;
@@ -136,6 +142,15 @@ private:
     std::map<std::string, int> dimensions_ids;
 
     std::set<uint64_t> previous_variables_ptr;
+    IO_Durability durability;
+    IO_Streaming streaming;
+    IO_Rate_Limiter::Priority priority;
+    IO_Shm_Channel channel;                 // Instead of a file when enabled, kept across Open()/Close()
+    std::string staging_folder;
+    std::string staged_filename;            // Created there, migrated at Close()
+    IO_Emergency_Lock emergency_lock;       // Held while using the file once registered
+    bool is_emergency_client;
+    inline IO_Emergency_Lock * File_Lock() { return (is_emergency_client ? &emergency_lock : NULL); }
     void call_netcdf_and_test(const int netcdf_retval, const std::string note = "");
 
 public:
@@ -170,7 +185,22 @@ public:
     void Commit();
     void Write();
     void Close();
+    void Emergency_Flush(const int signal_number, const bool is_fatal);
     void Print() const;
+
+    // Must be called before Open() (use the default constructor)
+    void Set_Durability(const IO_Durability &policy);
+    IO_Durability & Get_Durability() { return durability; }
+    // Must be called before Open() too (see IO_Migrator)
+    void Set_Staging(const std::string folder);
+    // Idem (see IO_Streaming)
+    void Set_Streaming(const IO_Streaming &policy);
+    IO_Streaming & Get_Streaming() { return streaming; }
+    // Class drawn from the rate limiter by Write() (default: snapshot)
+    void Set_Priority(const IO_Rate_Limiter::Priority _priority) { priority = _priority; }
+    // Before Open(): snapshots are published there, no file is created
+    void Set_Channel(const IO_Shm_Channel &_channel);
+    IO_Shm_Channel & Get_Channel() { return channel; }
 };
 
 class NetCDF_In
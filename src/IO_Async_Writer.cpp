@@ -0,0 +1,238 @@
+
+#include <cstdlib>  // abort()
+#include <cerrno>
+#include <sys/time.h> // gettimeofday()
+#include <time.h>   // nanosleep()
+
+#include <StdCout.hpp>
+
+#include "InputOutput.hpp"
+#include "IO_Async_Writer.hpp"
+#include "IO_Stats.hpp"
+
+// Flusher thread wakes up at least this often to pick up data
+// sitting in a partially filled front buffer (seconds).
+const double async_idle_wakeup = 0.1;
+
+// **************************************************************
+IO_Async_Writer::IO_Async_Writer()
+{
+    owner           = NULL;
+    front           = 0;
+    back_pending    = false;
+    quit            = false;
+    is_started      = false;
+    capacity        = 0;
+    nb_stalls       = 0;
+    stall_time      = 0.0;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond_work, NULL);
+    pthread_cond_init(&cond_drained, NULL);
+}
+
+// **************************************************************
+IO_Async_Writer::~IO_Async_Writer()
+{
+    Stop();
+
+    pthread_cond_destroy(&cond_drained);
+    pthread_cond_destroy(&cond_work);
+    pthread_mutex_destroy(&mutex);
+}
+
+// **************************************************************
+void IO_Async_Writer::Start(IO *_owner, const size_t _capacity)
+{
+    assert(!is_started);
+    assert(_owner != NULL);
+
+    owner           = _owner;
+    capacity        = _capacity;
+    front           = 0;
+    back_pending    = false;
+    quit            = false;
+    nb_stalls       = 0;
+    stall_time      = 0.0;
+
+    buffers[0].clear();
+    buffers[1].clear();
+    buffers[0].reserve(capacity);
+    buffers[1].reserve(capacity);
+
+    if (pthread_create(&thread, NULL, IO_Async_Writer::Thread_Main, (void *) this) != 0)
+    {
+        std_cout << "ERROR: Could not create asynchronous writer thread for file '" << owner->Get_Filename() << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    is_started = true;
+}
+
+// **************************************************************
+void IO_Async_Writer::Swap_Buffers()
+/**
+ * Hand the front buffer to the flusher thread.
+ * Mutex must be held and back buffer must be free.
+ */
+{
+    assert(!back_pending);
+
+    front        = 1 - front;
+    back_pending = true;
+    pthread_cond_signal(&cond_work);
+}
+
+// **************************************************************
+void IO_Async_Writer::Append(const char *p, const size_t size)
+{
+    assert(is_started);
+
+    pthread_mutex_lock(&mutex);
+
+    std::vector<char> &front_buffer = buffers[front];
+
+    if (!front_buffer.empty() && front_buffer.size() + size > capacity)
+    {
+        // Front buffer is full. If the flusher is still busy with the back
+        // buffer, we have no choice but to wait for it.
+        if (back_pending)
+        {
+            const double stall_start = IO_Wall_Time();
+            while (back_pending)
+                pthread_cond_wait(&cond_drained, &mutex);
+            stall_time += IO_Wall_Time() - stall_start;
+            nb_stalls++;
+        }
+        Swap_Buffers();
+    }
+
+    buffers[front].insert(buffers[front].end(), p, p + size);
+
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Async_Writer::Drain()
+/**
+ * Block until everything appended so far was handed to the file handle.
+ */
+{
+    if (!is_started)
+        return;
+
+    pthread_mutex_lock(&mutex);
+    while (back_pending || !buffers[front].empty())
+    {
+        if (!back_pending)
+            Swap_Buffers();
+        pthread_cond_wait(&cond_drained, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Async_Writer::Stop()
+{
+    if (!is_started)
+        return;
+
+    Drain();
+
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&cond_work);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+
+    is_started = false;
+}
+
+// **************************************************************
+void IO_Async_Writer::Emergency_Write()
+/**
+ * Write both buffers from the calling thread, IO_Emergency's drain
+ * thread holding the owner's emergency lock (the flusher thread can't
+ * write then). The front buffer is lost if the mutex stays held, e.g.
+ * by the interrupted thread.
+ */
+{
+    if (!is_started)
+        return;
+
+    const double start = IO_Wall_Time();
+    while (pthread_mutex_trylock(&mutex) != 0)
+    {
+        if (IO_Wall_Time() - start > IO_EMERGENCY_LOCK_WAIT)
+            return;
+        timespec duration = {0, 50000};
+        nanosleep(&duration, NULL);
+    }
+
+    for (int i = 0 ; i < 2 ; i++)
+    {
+        std::vector<char> &buffer = buffers[(front + 1 + i) % 2];
+        if (!buffer.empty())
+            owner->Write_Direct(&buffer[0], buffer.size());
+        buffer.clear();
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void * IO_Async_Writer::Thread_Main(void *writer)
+{
+    ((IO_Async_Writer *) writer)->Thread_Loop();
+    return NULL;
+}
+
+// **************************************************************
+void IO_Async_Writer::Thread_Loop()
+{
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        while (!back_pending && !quit)
+        {
+            timeval now;
+            gettimeofday(&now, NULL);
+            const double wakeup = double(now.tv_sec) + 1.0e-6*double(now.tv_usec) + async_idle_wakeup;
+            timespec deadline;
+            deadline.tv_sec  = time_t(wakeup);
+            deadline.tv_nsec = long(1.0e9*(wakeup - double(deadline.tv_sec)));
+
+            const int return_value = pthread_cond_timedwait(&cond_work, &mutex, &deadline);
+
+            // Nothing came in for a while: don't let data sit in memory.
+            if (return_value == ETIMEDOUT && !back_pending && !buffers[front].empty())
+                Swap_Buffers();
+        }
+
+        if (back_pending)
+        {
+            std::vector<char> &back_buffer = buffers[1 - front];
+
+            // Write without holding the lock so Append() can proceed. The
+            // owner's emergency lock covers the write and the clear: the
+            // drain thread sees the back buffer either full or written.
+            pthread_mutex_unlock(&mutex);
+            {
+                IO_Emergency_Guard guard(owner->Handle_Lock());
+                owner->Write_Direct(&back_buffer[0], back_buffer.size());
+                back_buffer.clear();
+            }
+            pthread_mutex_lock(&mutex);
+
+            back_pending = false;
+            pthread_cond_broadcast(&cond_drained);
+            continue;
+        }
+
+        if (quit)
+            break;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// ********** End of file ***************************************
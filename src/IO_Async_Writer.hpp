@@ -0,0 +1,68 @@
+#ifndef INC_IO_ASYNC_WRITER_hpp
+#define INC_IO_ASYNC_WRITER_hpp
+
+#include <pthread.h>
+#include <vector>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+class IO;
+
+// Default size of each of the two buffers (bytes)
+#define IO_ASYNC_DEFAULT_BUFFER_SIZE (4*1024*1024)
+
+class IO_Async_Writer
+/**
+ * Double-buffered background writer used by IO's "async" mode.
+ *
+ * The simulation thread appends to the front buffer while a dedicated
+ * flusher thread drains the back buffer through IO::Write_Direct().
+ * Appending only blocks if the front buffer is full while the back
+ * buffer is still being written (a "stall").
+ */
+{
+    private:
+        IO *owner;                  // IO object owning the file handle
+
+        pthread_t       thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_work;      // Back buffer has data (or quit)
+        pthread_cond_t  cond_drained;   // Back buffer was written to disk
+
+        std::vector<char> buffers[2];
+        int front;                  // Index of buffer filled by Append()
+        bool back_pending;          // Back buffer waiting/being written
+        bool quit;
+        bool is_started;
+        size_t capacity;            // Size of each buffer (bytes)
+
+        uint64_t nb_stalls;         // Number of times Append() had to wait
+        double   stall_time;        // Total time Append() waited (seconds)
+
+        void Swap_Buffers();
+        static void * Thread_Main(void *writer);
+        void Thread_Loop();
+
+    public:
+        IO_Async_Writer();
+        ~IO_Async_Writer();
+        void Start(IO *_owner, const size_t _capacity = IO_ASYNC_DEFAULT_BUFFER_SIZE);
+        void Append(const char *p, const size_t size);
+        void Drain();
+        void Stop();
+        void Emergency_Write();
+
+        inline bool     Is_Started()        { return is_started;    }
+        inline uint64_t Get_Nb_Stalls()     { return nb_stalls;     }
+        inline double   Get_Stall_Time()    { return stall_time;    }
+};
+
+#endif // INC_IO_ASYNC_WRITER_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,162 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy(), memset()
+
+#ifdef COMPRESS_OUTPUT
+#include <zlib.h>
+#endif // #ifdef COMPRESS_OUTPUT
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif // #ifdef HAVE_ZSTD
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif // #ifdef HAVE_LZ4
+
+#include <StdCout.hpp>
+
+#include "IO_Codec.hpp"
+
+// **************************************************************
+void IO_Codec_Raw::Compress(const char *in, const size_t size, std::vector<char> &out) const
+{
+    out.resize(size);
+    if (size > 0)
+        memcpy(&out[0], in, size);
+}
+
+#ifdef COMPRESS_OUTPUT
+// **************************************************************
+IO_Codec_Deflate::IO_Codec_Deflate(const int _level)
+{
+    level = (_level == IO_CODEC_DEFAULT_LEVEL ? Z_DEFAULT_COMPRESSION : _level);
+}
+
+// **************************************************************
+void IO_Codec_Deflate::Compress(const char *in, const size_t size, std::vector<char> &out) const
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree  = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    // windowBits of 15+16 asks zlib for a gzip header and trailer.
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std_cout << "ERROR: deflateInit2() failed (level " << level << "). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    out.resize(deflateBound(&stream, uLong(size)) + 32);
+
+    stream.next_in   = (Bytef *) in;
+    stream.avail_in  = uInt(size);
+    stream.next_out  = (Bytef *) &out[0];
+    stream.avail_out = uInt(out.size());
+
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        std_cout << "ERROR: deflate() failed. Aborting.\n" << std::flush;
+        abort();
+    }
+    out.resize(stream.total_out);
+
+    deflateEnd(&stream);
+}
+#endif // #ifdef COMPRESS_OUTPUT
+
+#ifdef HAVE_ZSTD
+// **************************************************************
+IO_Codec_Zstd::IO_Codec_Zstd(const int _level)
+{
+    level = (_level == IO_CODEC_DEFAULT_LEVEL ? 3 : _level);
+}
+
+// **************************************************************
+void IO_Codec_Zstd::Compress(const char *in, const size_t size, std::vector<char> &out) const
+{
+    out.resize(ZSTD_compressBound(size));
+
+    const size_t compressed_size = ZSTD_compress(&out[0], out.size(), in, size, level);
+    if (ZSTD_isError(compressed_size))
+    {
+        std_cout << "ERROR: ZSTD_compress() failed: " << ZSTD_getErrorName(compressed_size) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    out.resize(compressed_size);
+}
+#endif // #ifdef HAVE_ZSTD
+
+#ifdef HAVE_LZ4
+// **************************************************************
+IO_Codec_Lz4::IO_Codec_Lz4(const int _level)
+{
+    level = (_level == IO_CODEC_DEFAULT_LEVEL ? 0 : _level);
+}
+
+// **************************************************************
+void IO_Codec_Lz4::Compress(const char *in, const size_t size, std::vector<char> &out) const
+{
+    LZ4F_preferences_t preferences;
+    memset(&preferences, 0, sizeof(preferences));
+    preferences.compressionLevel = level;
+    preferences.frameInfo.contentSize = size;
+
+    out.resize(LZ4F_compressFrameBound(size, &preferences));
+
+    const size_t compressed_size = LZ4F_compressFrame(&out[0], out.size(), in, size, &preferences);
+    if (LZ4F_isError(compressed_size))
+    {
+        std_cout << "ERROR: LZ4F_compressFrame() failed: " << LZ4F_getErrorName(compressed_size) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    out.resize(compressed_size);
+}
+#endif // #ifdef HAVE_LZ4
+
+// **************************************************************
+IO_Codec * New_IO_Codec(const std::string &name, const int level)
+/**
+ * Create a codec from its name ("raw", "deflate", "zstd" or "lz4").
+ * Returns NULL if the codec is known but was not compiled in. Aborts
+ * on an unknown name.
+ */
+{
+    if (name == "raw")
+        return new IO_Codec_Raw;
+
+    if (name == "deflate" || name == "gzip")
+    {
+#ifdef COMPRESS_OUTPUT
+        return new IO_Codec_Deflate(level);
+#else // #ifdef COMPRESS_OUTPUT
+        std_cout << "Codec '" << name << "' not available. Please compile io.git with -DCOMPRESS_OUTPUT.\n";
+        return NULL;
+#endif // #ifdef COMPRESS_OUTPUT
+    }
+
+    if (name == "zstd")
+    {
+#ifdef HAVE_ZSTD
+        return new IO_Codec_Zstd(level);
+#else // #ifdef HAVE_ZSTD
+        std_cout << "Codec '" << name << "' not available. Please compile io.git with -DHAVE_ZSTD (requires libzstd).\n";
+        return NULL;
+#endif // #ifdef HAVE_ZSTD
+    }
+
+    if (name == "lz4")
+    {
+#ifdef HAVE_LZ4
+        return new IO_Codec_Lz4(level);
+#else // #ifdef HAVE_LZ4
+        std_cout << "Codec '" << name << "' not available. Please compile io.git with -DHAVE_LZ4 (requires liblz4).\n";
+        return NULL;
+#endif // #ifdef HAVE_LZ4
+    }
+
+    std_cout << "ERROR: Unknown codec '" << name << "'. Valid codecs are: raw, deflate, zstd, lz4. Aborting.\n" << std::flush;
+    abort();
+    return NULL;
+}
+
+// ********** End of file ***************************************
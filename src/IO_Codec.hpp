@@ -0,0 +1,88 @@
+#ifndef INC_IO_CODEC_hpp
+#define INC_IO_CODEC_hpp
+
+#include <string>
+#include <vector>
+#include <cstddef> // size_t
+
+// Let the codec pick its own default compression level
+#define IO_CODEC_DEFAULT_LEVEL -1
+
+class IO_Codec
+/**
+ * Block compression codec used by IO's compressed mode.
+ *
+ * Compress() turns a block into a self-contained frame. All codecs
+ * produce frames that can be concatenated: the resulting file is
+ * readable by the codec's standard tool (zcat, zstdcat, lz4cat).
+ * Compress() is const and must be callable from many threads at once.
+ */
+{
+    public:
+        virtual ~IO_Codec() {}
+        virtual std::string Name() const = 0;
+        virtual std::string Extension() const = 0;
+        virtual void Compress(const char *in, const size_t size, std::vector<char> &out) const = 0;
+};
+
+class IO_Codec_Raw : public IO_Codec
+/**
+ * No compression: frames are the input bytes.
+ */
+{
+    public:
+        std::string Name() const        { return "raw"; }
+        std::string Extension() const   { return "";    }
+        void Compress(const char *in, const size_t size, std::vector<char> &out) const;
+};
+
+#ifdef COMPRESS_OUTPUT
+class IO_Codec_Deflate : public IO_Codec
+/**
+ * zlib's deflate; each frame is a complete gzip member.
+ */
+{
+    private:
+        int level;
+    public:
+        IO_Codec_Deflate(const int _level = IO_CODEC_DEFAULT_LEVEL);
+        std::string Name() const        { return "deflate"; }
+        std::string Extension() const   { return ".gz";     }
+        void Compress(const char *in, const size_t size, std::vector<char> &out) const;
+};
+#endif // #ifdef COMPRESS_OUTPUT
+
+#ifdef HAVE_ZSTD
+class IO_Codec_Zstd : public IO_Codec
+{
+    private:
+        int level;
+    public:
+        IO_Codec_Zstd(const int _level = IO_CODEC_DEFAULT_LEVEL);
+        std::string Name() const        { return "zstd"; }
+        std::string Extension() const   { return ".zst"; }
+        void Compress(const char *in, const size_t size, std::vector<char> &out) const;
+};
+#endif // #ifdef HAVE_ZSTD
+
+#ifdef HAVE_LZ4
+class IO_Codec_Lz4 : public IO_Codec
+/**
+ * LZ4 frame format (not the raw LZ4 block format).
+ */
+{
+    private:
+        int level;
+    public:
+        IO_Codec_Lz4(const int _level = IO_CODEC_DEFAULT_LEVEL);
+        std::string Name() const        { return "lz4"; }
+        std::string Extension() const   { return ".lz4"; }
+        void Compress(const char *in, const size_t size, std::vector<char> &out) const;
+};
+#endif // #ifdef HAVE_LZ4
+
+IO_Codec * New_IO_Codec(const std::string &name, const int level = IO_CODEC_DEFAULT_LEVEL);
+
+#endif // INC_IO_CODEC_hpp
+
+// ********** End of file ***************************************
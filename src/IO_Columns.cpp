@@ -0,0 +1,651 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy(), memcmp()
+#include <sys/types.h> // off_t
+
+#include <StdCout.hpp>
+
+#include "IO_Columns.hpp"
+#include "IO_Gorilla.hpp"
+
+// **************************************************************
+template <class T>
+static void Append_Value(std::vector<char> &buffer, const T value)
+{
+    const char *p = (const char *) &value;
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+// **************************************************************
+static void Append_String(std::vector<char> &buffer, const std::string &string)
+{
+    assert(string.size() < 65536);
+    Append_Value(buffer, uint16_t(string.size()));
+    buffer.insert(buffer.end(), string.begin(), string.end());
+}
+
+// **************************************************************
+static bool Is_Columns_Option(const std::string &key)
+/**
+ * Options that write the bytes, unchanged and in order, to the file
+ * itself: readers seek to chunk offsets that must be file offsets.
+ */
+{
+    static const char *accepted[] = {"gorilla", "async", "gather", "gather_count", "mmap", "uring",
+                                     "stage", "stream", "priority"};
+    for (size_t i = 0 ; i < sizeof(accepted) / sizeof(accepted[0]) ; i++)
+    {
+        if (key == accepted[i])
+            return true;
+    }
+    return false;
+}
+
+// **************************************************************
+IO_Columns_Out::IO_Columns_Out()
+{
+    rows_per_block      = IO_COLUMNS_DEFAULT_ROWS_PER_BLOCK;
+    nb_rows_in_block    = 0;
+    nb_rows             = 0;
+    file_offset         = 0;
+    is_opened           = false;
+}
+
+// **************************************************************
+IO_Columns_Out::~IO_Columns_Out()
+{
+    Close_File();
+}
+
+// **************************************************************
+void IO_Columns_Out::Add_Column_Raw(const std::string &name, const char kind, const size_t element_size,
+                                    const char *pointer, const std::string &units)
+{
+    assert(!is_opened);
+    assert(pointer != NULL);
+    assert(element_size < 256);
+
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        if (columns[i].name == name)
+        {
+            std_cout << "ERROR: Column '" << name << "' added twice to '" << Get_Filename() << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    IO_Column column;
+    column.name         = name;
+    column.units        = units;
+    column.kind         = kind;
+    column.element_size = uint8_t(element_size);
+    column.encoding     = IO_COLUMNS_ENCODING_PLAIN;
+    column.pointer      = pointer;
+    columns.push_back(column);
+}
+
+// **************************************************************
+void IO_Columns_Out::Set_Rows_Per_Block(const uint32_t _rows_per_block)
+{
+    assert(!is_opened);
+    assert(_rows_per_block > 0);
+    rows_per_block = _rows_per_block;
+}
+
+// **************************************************************
+bool IO_Columns_Out::Open_File(const std::string full_mode, const bool quiet)
+/**
+ * Columns must be added before opening. Only writing ("w") is supported,
+ * and the file is always binary. "w:gorilla" encodes the columns.
+ * Options that compress, split, redirect or reorder the byte stream
+ * ("z", "codec", "threads", "rotate", "ring", "socket", "fifo", "index",
+ * "producers"...) are refused: accepted are "async", "gather", "mmap",
+ * "uring", "stage", "stream" and "priority".
+ */
+{
+    assert(!columns.empty());
+
+    const std::string flags = Mode_Flags(full_mode);
+    if (flags.find("a") != std::string::npos || flags.find("r") != std::string::npos)
+    {
+        std_cout << "ERROR: IO_Columns_Out only supports mode 'w' (file '" << Get_Filename() << "', mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+    // Readers seek to chunk offsets: these must be offsets in the file.
+    if (flags.find("z") != std::string::npos)
+    {
+        std_cout << "ERROR: IO_Columns_Out can't be compressed (file '" << Get_Filename() << "', mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+    size_t start = full_mode.find(':');
+    while (start != std::string::npos)
+    {
+        const size_t end = full_mode.find(':', start+1);
+        const std::string option = full_mode.substr(start+1, (end == std::string::npos ? std::string::npos : end-start-1));
+        const std::string key = option.substr(0, option.find('='));
+        if (!Is_Columns_Option(key))
+        {
+            std_cout << "ERROR: IO_Columns_Out can't use option '" << key << "' (file '" << Get_Filename() << "', mode '" << full_mode << "'): only 'gorilla', 'async', 'gather', 'mmap', 'uring', 'stage', 'stream' and 'priority' are supported. Aborting.\n" << std::flush;
+            abort();
+        }
+        start = end;
+    }
+    std::string binary_mode = full_mode;
+    if (flags.find("b") == std::string::npos)
+        binary_mode.insert(flags.size(), "b");
+
+    if (!IO::Open_File(binary_mode, quiet))
+        return false;
+
+    std::string option_value;
+    const bool use_gorilla = Mode_Option(full_mode, "gorilla", option_value);
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        const bool is_encoded = (use_gorilla && IO_Gorilla_Is_Supported(columns[i].kind, columns[i].element_size));
+        columns[i].encoding = (is_encoded ? IO_COLUMNS_ENCODING_GORILLA : IO_COLUMNS_ENCODING_PLAIN);
+    }
+
+    is_opened           = true;
+    nb_rows_in_block    = 0;
+    nb_rows             = 0;
+    file_offset         = 0;
+    block_nb_rows.clear();
+    chunk_offsets.clear();
+    chunk_sizes.clear();
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        columns[i].block.clear();
+        columns[i].block.reserve(size_t(rows_per_block) * columns[i].element_size);
+    }
+
+    Write_Header();
+
+    return true;
+}
+
+// **************************************************************
+void IO_Columns_Out::Write_Buffer()
+{
+    if (buffer.empty())
+        return;
+    IO::Write(&buffer[0], buffer.size());
+    file_offset += buffer.size();
+    buffer.clear();
+}
+
+// **************************************************************
+void IO_Columns_Out::Write_Header()
+{
+    buffer.clear();
+    buffer.insert(buffer.end(), "IOCOLS01", "IOCOLS01" + 8);
+    buffer.push_back(IO_Is_Host_Big_Endian() ? 'B' : 'L');
+    buffer.push_back(char(IO_COLUMNS_VERSION));
+    buffer.push_back(0);
+    buffer.push_back(0);
+    Append_Value(buffer, uint32_t(columns.size()));
+    Append_Value(buffer, rows_per_block);
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        buffer.push_back(columns[i].kind);
+        buffer.push_back(char(columns[i].element_size));
+        buffer.push_back(char(columns[i].encoding));
+        buffer.push_back(0);
+        Append_String(buffer, columns[i].name);
+        Append_String(buffer, columns[i].units);
+    }
+    Write_Buffer();
+}
+
+// **************************************************************
+void IO_Columns_Out::Append_Row()
+/**
+ * Store the current value of every column.
+ */
+{
+    assert(is_opened);
+
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        IO_Column &column = columns[i];
+        column.block.insert(column.block.end(), column.pointer, column.pointer + column.element_size);
+    }
+    nb_rows_in_block++;
+    nb_rows++;
+
+    if (nb_rows_in_block >= rows_per_block)
+        Write_Block();
+}
+
+// **************************************************************
+void IO_Columns_Out::Write_Block()
+{
+    if (nb_rows_in_block == 0)
+        return;
+
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        IO_Column &column = columns[i];
+        if (column.encoding == IO_COLUMNS_ENCODING_GORILLA)
+        {
+            encoded.clear();
+            IO_Gorilla_Encode(column.kind, column.element_size, &column.block[0], nb_rows_in_block, encoded);
+            column.block.swap(encoded);
+        }
+    }
+
+    buffer.clear();
+    buffer.insert(buffer.end(), "IOCB", "IOCB" + 4);
+    Append_Value(buffer, nb_rows_in_block);
+    for (size_t i = 0 ; i < columns.size() ; i++)
+        Append_Value(buffer, uint64_t(columns[i].block.size()));
+
+    uint64_t offset = file_offset + buffer.size();
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        std::vector<char> &chunk = columns[i].block;
+        chunk_offsets.push_back(offset);
+        chunk_sizes.push_back(chunk.size());
+        offset += chunk.size();
+        buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+        chunk.clear();
+    }
+    block_nb_rows.push_back(nb_rows_in_block);
+    nb_rows_in_block = 0;
+
+    Write_Buffer();
+}
+
+// **************************************************************
+void IO_Columns_Out::Write_Footer()
+{
+    const uint64_t footer_offset = file_offset;
+
+    buffer.clear();
+    buffer.insert(buffer.end(), "IOCF", "IOCF" + 4);
+    Append_Value(buffer, uint32_t(columns.size()));
+    Append_Value(buffer, uint64_t(block_nb_rows.size()));
+    for (size_t b = 0 ; b < block_nb_rows.size() ; b++)
+    {
+        Append_Value(buffer, block_nb_rows[b]);
+        for (size_t i = 0 ; i < columns.size() ; i++)
+        {
+            Append_Value(buffer, chunk_offsets[b*columns.size() + i]);
+            Append_Value(buffer, chunk_sizes[b*columns.size() + i]);
+        }
+    }
+    Append_Value(buffer, footer_offset);
+    buffer.insert(buffer.end(), "IOCOLEND", "IOCOLEND" + 8);
+    Write_Buffer();
+}
+
+// **************************************************************
+void IO_Columns_Out::Flush()
+/**
+ * Write the rows buffered so far as a (possibly short) block.
+ */
+{
+    if (!is_opened)
+        return;
+    Write_Block();
+    IO::Flush();
+}
+
+// **************************************************************
+void IO_Columns_Out::Close_File()
+{
+    if (is_opened)
+    {
+        Write_Block();
+        Write_Footer();
+        is_opened = false;
+    }
+    IO::Close_File();
+}
+
+// **************************************************************
+void IO_Columns_Out::Emergency_Flush(const int signal_number, const bool is_fatal)
+/**
+ * At exit(), write the last block and the footer as Close_File() does.
+ * After a signal, the main thread may be appending a row: only the
+ * blocks already written are saved (readers scan them without a footer).
+ */
+{
+    if (signal_number == 0)
+    {
+        Close_File();
+        return;
+    }
+    IO::Emergency_Flush(signal_number, is_fatal);
+}
+
+// **************************************************************
+IO_Columns_In::IO_Columns_In()
+{
+    fh              = NULL;
+    swap            = false;
+    rows_per_block  = 0;
+    nb_rows         = 0;
+}
+
+// **************************************************************
+IO_Columns_In::IO_Columns_In(const std::string _filename)
+{
+    fh              = NULL;
+    swap            = false;
+    rows_per_block  = 0;
+    nb_rows         = 0;
+    Open(_filename);
+}
+
+// **************************************************************
+IO_Columns_In::~IO_Columns_In()
+{
+    Close();
+}
+
+// **************************************************************
+void IO_Columns_In::Close()
+{
+    if (fh != NULL)
+        fclose(fh);
+    fh = NULL;
+}
+
+// **************************************************************
+void IO_Columns_In::Read_Bytes(void *p, const size_t size)
+{
+    if (fread(p, 1, size, fh) != size)
+    {
+        std_cout << "ERROR: Unexpected end of file '" << filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+}
+
+// **************************************************************
+template <class T>
+T IO_Columns_In::Read_Value()
+{
+    T value;
+    Read_Bytes(&value, sizeof(T));
+    if (swap)
+        IO_Swap_Bytes((char *) &value, sizeof(T), 1);
+    return value;
+}
+
+// **************************************************************
+std::string IO_Columns_In::Read_String()
+{
+    const uint16_t size = Read_Value<uint16_t>();
+    std::string string(size, ' ');
+    if (size > 0)
+        Read_Bytes(&string[0], size);
+    return string;
+}
+
+// **************************************************************
+void IO_Columns_In::Open(const std::string _filename)
+{
+    assert(fh == NULL);
+
+    filename = _filename;
+    fh = fopen(filename.c_str(), "rb");
+    if (fh == NULL)
+    {
+        std_cout << "ERROR: Could not open file '" << filename << "' for reading columns. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    char magic[8];
+    Read_Bytes(magic, 8);
+    char header[4];
+    Read_Bytes(header, 4);
+    if (memcmp(magic, "IOCOLS01", 8) != 0 || header[1] != char(IO_COLUMNS_VERSION))
+    {
+        std_cout << "ERROR: File '" << filename << "' was not written by IO_Columns_Out. Aborting.\n" << std::flush;
+        abort();
+    }
+    swap = ((header[0] == 'B') != IO_Is_Host_Big_Endian());
+
+    const uint32_t nb_columns = Read_Value<uint32_t>();
+    rows_per_block = Read_Value<uint32_t>();
+
+    columns.clear();
+    columns.resize(nb_columns);
+    for (uint32_t i = 0 ; i < nb_columns ; i++)
+    {
+        char description[4];
+        Read_Bytes(description, 4);
+        columns[i].kind         = description[0];
+        columns[i].element_size = uint8_t(description[1]);
+        columns[i].encoding     = uint8_t(description[2]);
+        columns[i].pointer      = NULL;
+        columns[i].name         = Read_String();
+        columns[i].units        = Read_String();
+
+        const bool is_known = (columns[i].encoding == IO_COLUMNS_ENCODING_PLAIN ||
+                               (columns[i].encoding == IO_COLUMNS_ENCODING_GORILLA && IO_Gorilla_Is_Supported(columns[i].kind, columns[i].element_size)));
+        if (!is_known)
+        {
+            std_cout << "ERROR: Unsupported encoding " << int(columns[i].encoding) << " for column '" << columns[i].name << "' in file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    const off_t header_end = ftello(fh);
+    if (!Read_Footer(header_end))
+        Scan_Blocks(header_end);
+
+    nb_rows = 0;
+    for (size_t b = 0 ; b < block_nb_rows.size() ; b++)
+        nb_rows += block_nb_rows[b];
+}
+
+// **************************************************************
+bool IO_Columns_In::Read_Footer(const long header_end)
+/**
+ * Load the block index from the footer.
+ * @return false if the file has no (valid) footer
+ */
+{
+    fseeko(fh, 0, SEEK_END);
+    const off_t file_size = ftello(fh);
+    if (file_size < off_t(header_end) + 16)
+        return false;
+
+    fseeko(fh, file_size - 16, SEEK_SET);
+    const uint64_t footer_offset = Read_Value<uint64_t>();
+    char magic[8];
+    Read_Bytes(magic, 8);
+    if (memcmp(magic, "IOCOLEND", 8) != 0 || footer_offset >= uint64_t(file_size))
+        return false;
+
+    fseeko(fh, off_t(footer_offset), SEEK_SET);
+    char footer_magic[4];
+    Read_Bytes(footer_magic, 4);
+    if (memcmp(footer_magic, "IOCF", 4) != 0 || Read_Value<uint32_t>() != columns.size())
+        return false;
+
+    const uint64_t nb_blocks = Read_Value<uint64_t>();
+    block_nb_rows.resize(nb_blocks);
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        columns[i].offsets.resize(nb_blocks);
+        columns[i].sizes.resize(nb_blocks);
+    }
+    for (uint64_t b = 0 ; b < nb_blocks ; b++)
+    {
+        block_nb_rows[b] = Read_Value<uint64_t>();
+        for (size_t i = 0 ; i < columns.size() ; i++)
+        {
+            columns[i].offsets[b] = Read_Value<uint64_t>();
+            columns[i].sizes[b]   = Read_Value<uint64_t>();
+        }
+    }
+
+    return true;
+}
+
+// **************************************************************
+void IO_Columns_In::Scan_Blocks(const long header_end)
+/**
+ * No footer: build the index by hopping from block header to block
+ * header. A truncated last block is ignored.
+ */
+{
+    std_cout << "WARNING: File '" << filename << "' has no footer (not closed properly?). Scanning blocks.\n";
+
+    fseeko(fh, 0, SEEK_END);
+    const uint64_t file_size = uint64_t(ftello(fh));
+
+    block_nb_rows.clear();
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        columns[i].offsets.clear();
+        columns[i].sizes.clear();
+    }
+
+    const uint64_t block_header_size = 8 + 8*columns.size();
+    uint64_t position = uint64_t(header_end);
+    while (position + block_header_size <= file_size)
+    {
+        fseeko(fh, off_t(position), SEEK_SET);
+        char magic[4];
+        Read_Bytes(magic, 4);
+        if (memcmp(magic, "IOCB", 4) != 0)
+            break;
+        const uint32_t rows = Read_Value<uint32_t>();
+
+        std::vector<uint64_t> sizes(columns.size());
+        uint64_t offset = position + block_header_size;
+        for (size_t i = 0 ; i < columns.size() ; i++)
+            sizes[i] = Read_Value<uint64_t>();
+        uint64_t end = offset;
+        for (size_t i = 0 ; i < columns.size() ; i++)
+            end += sizes[i];
+        if (end > file_size)
+            break;
+
+        for (size_t i = 0 ; i < columns.size() ; i++)
+        {
+            columns[i].offsets.push_back(offset);
+            columns[i].sizes.push_back(sizes[i]);
+            offset += sizes[i];
+        }
+        block_nb_rows.push_back(rows);
+        position = end;
+    }
+}
+
+// **************************************************************
+int IO_Columns_In::Column_Index(const std::string &name) const
+{
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        if (columns[i].name == name)
+            return int(i);
+    }
+    std_cout << "ERROR: Column '" << name << "' not found in file '" << filename << "'. Aborting.\n" << std::flush;
+    abort();
+    return -1;
+}
+
+// **************************************************************
+void IO_Columns_In::Read_Chunk(const int column, const size_t block)
+{
+    chunk.resize(columns[column].sizes[block]);
+    fseeko(fh, off_t(columns[column].offsets[block]), SEEK_SET);
+    if (!chunk.empty())
+        Read_Bytes(&chunk[0], chunk.size());
+}
+
+// **************************************************************
+template <class Stored, class T>
+static void Convert_Values(const char *raw, const size_t count, T *out)
+{
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        Stored value;
+        memcpy(&value, raw + i*sizeof(Stored), sizeof(Stored));
+        out[i] = T(value);
+    }
+}
+
+// **************************************************************
+template <class T>
+void IO_Columns_In::Convert(const IO_Column &column, const size_t count, T *out)
+/**
+ * Convert the values in "chunk" to T, decoding them first if needed.
+ */
+{
+    if (count == 0)
+        return;
+
+    bool is_valid = (chunk.size() == count * column.element_size);
+    if (column.encoding == IO_COLUMNS_ENCODING_GORILLA)
+    {
+        // Decoded in the host's byte order.
+        decoded.resize(count * column.element_size);
+        is_valid = IO_Gorilla_Decode(column.kind, column.element_size, (chunk.empty() ? NULL : &chunk[0]), chunk.size(), count, &decoded[0]);
+        chunk.swap(decoded);
+    }
+    if (!is_valid)
+    {
+        std_cout << "ERROR: Corrupted chunk of column '" << column.name << "' in file '" << filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+    if (swap and column.encoding == IO_COLUMNS_ENCODING_PLAIN)
+        IO_Swap_Bytes(&chunk[0], column.element_size, count);
+
+    const char *raw = &chunk[0];
+    const int type = 256*int(column.kind) + int(column.element_size);
+    switch (type)
+    {
+        case 256*'f' + 4: Convert_Values<float>   (raw, count, out); break;
+        case 256*'f' + 8: Convert_Values<double>  (raw, count, out); break;
+        case 256*'i' + 1: Convert_Values<int8_t>  (raw, count, out); break;
+        case 256*'i' + 2: Convert_Values<int16_t> (raw, count, out); break;
+        case 256*'i' + 4: Convert_Values<int32_t> (raw, count, out); break;
+        case 256*'i' + 8: Convert_Values<int64_t> (raw, count, out); break;
+        case 256*'u' + 1: Convert_Values<uint8_t> (raw, count, out); break;
+        case 256*'u' + 2: Convert_Values<uint16_t>(raw, count, out); break;
+        case 256*'u' + 4: Convert_Values<uint32_t>(raw, count, out); break;
+        case 256*'u' + 8: Convert_Values<uint64_t>(raw, count, out); break;
+        case 256*'c' + 1: Convert_Values<char>    (raw, count, out); break;
+        default:
+            std_cout << "ERROR: Unsupported type '" << column.kind << "' (" << int(column.element_size) << " bytes) for column '" << column.name << "'. Aborting.\n" << std::flush;
+            abort();
+    }
+}
+
+// **************************************************************
+template <class T>
+void IO_Columns_In::Read(const int column, std::vector<T> &values)
+/**
+ * Read a whole column. Only this column's chunks are read from disk.
+ */
+{
+    assert(fh != NULL);
+    assert(column >= 0 && column < int(columns.size()));
+
+    values.resize(nb_rows);
+    size_t row = 0;
+    for (size_t b = 0 ; b < block_nb_rows.size() ; b++)
+    {
+        Read_Chunk(column, b);
+        Convert(columns[column], block_nb_rows[b], (values.empty() ? NULL : &values[row]));
+        row += block_nb_rows[b];
+    }
+}
+
+// **************************************************************
+// Templates specializations
+template void IO_Columns_In::Read<short>(           const int column, std::vector<short>            &values);
+template void IO_Columns_In::Read<unsigned short>(  const int column, std::vector<unsigned short>   &values);
+template void IO_Columns_In::Read<int>(             const int column, std::vector<int>              &values);
+template void IO_Columns_In::Read<unsigned int>(    const int column, std::vector<unsigned int>     &values);
+template void IO_Columns_In::Read<long>(            const int column, std::vector<long>             &values);
+template void IO_Columns_In::Read<unsigned long>(   const int column, std::vector<unsigned long>    &values);
+template void IO_Columns_In::Read<float>(           const int column, std::vector<float>            &values);
+template void IO_Columns_In::Read<double>(          const int column, std::vector<double>           &values);
+
+// ********** End of file ***************************************
@@ -0,0 +1,179 @@
+#ifndef INC_IO_COLUMNS_hpp
+#define INC_IO_COLUMNS_hpp
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "InputOutput.hpp"
+#include "IO_Records.hpp"
+
+// Default number of rows stored in each column block
+#define IO_COLUMNS_DEFAULT_ROWS_PER_BLOCK 1024
+
+// File layout (all integers in the byte order given in the header):
+//
+//  Header: "IOCOLS01", order ('L'/'B'), version, 2 reserved bytes,
+//          uint32 nb_columns, uint32 rows_per_block, then per column:
+//          kind, element size, encoding (0: plain, 1: Gorilla,
+//          see IO_Gorilla.hpp), reserved,
+//          uint16 + name, uint16 + units
+//  Blocks: "IOCB", uint32 nb_rows, uint64 chunk size per column,
+//          then each column's chunk (its values for these rows)
+//  Footer: "IOCF", uint32 nb_columns, uint64 nb_blocks, then per block:
+//          uint64 nb_rows and, per column, uint64 offset + uint64 size
+//  Tail:   uint64 footer offset, "IOCOLEND"
+//
+// The footer lets readers seek directly to a column's chunks. If it is
+// missing (run killed before Close_File()), readers walk the block
+// headers instead, still without reading other columns' data.
+
+#define IO_COLUMNS_VERSION          2
+#define IO_COLUMNS_ENCODING_PLAIN   0
+#define IO_COLUMNS_ENCODING_GORILLA 1
+
+struct IO_Column
+{
+    std::string name;
+    std::string units;
+    char        kind;           // See IO_Type_Kind
+    uint8_t     element_size;
+    uint8_t     encoding;
+    const char *pointer;        // Writer: where to read the value at each row
+    std::vector<char>     block;    // Writer: values of the current block
+    std::vector<uint64_t> offsets;  // Reader: chunk offset in each block
+    std::vector<uint64_t> sizes;    // Reader: chunk size in each block
+};
+
+// **************************************************************
+class IO_Columns_Out : public IO
+/**
+ * Column-oriented binary time series.
+ *
+ * Like NetCDF_Out::Add_Variable(), columns are declared with a pointer
+ * to the value; Append_Row() reads every pointer. Rows are buffered
+ * and stored in blocks, column by column, so a single column can be
+ * read back (IO_Columns_In) without going through the whole file.
+ *
+ *      IO_Columns_Out energies;
+ *      energies.Init(period, "output/energies.col");
+ *      energies.Add_Column("time",   &time,   "s");
+ *      energies.Add_Column("energy", &energy, "J");
+ *      energies.Open_File();
+ *      ...
+ *      if (energies.Is_Output_Permitted(time))
+ *          energies.Append_Row();
+ *      ...
+ *      energies.Close_File();
+ *
+ * With Open_File("w:gorilla"), each chunk is encoded for slowly
+ * changing values (see IO_Gorilla.hpp): XOR of consecutive floating
+ * point values, or delta-of-delta of their bits when they are regularly
+ * spaced (time), delta-of-delta of integers. Columns of other types
+ * stay plain.
+ *
+ * Since IO's methods are not virtual, Close_File() must be called on
+ * this class (the destructor does it). At exit() with the emergency
+ * handlers enabled (IO_Emergency_Enable()), Emergency_Flush() does it.
+ */
+{
+    private:
+        std::vector<IO_Column> columns;
+        uint32_t rows_per_block;
+        uint32_t nb_rows_in_block;
+        uint64_t nb_rows;
+        uint64_t file_offset;           // Bytes written so far
+        bool is_opened;
+
+        // Index written in the footer
+        std::vector<uint64_t> block_nb_rows;
+        std::vector<uint64_t> chunk_offsets;    // nb_blocks * nb_columns
+        std::vector<uint64_t> chunk_sizes;
+
+        std::vector<char> buffer;
+        std::vector<char> encoded;
+
+        void Add_Column_Raw(const std::string &name, const char kind, const size_t element_size,
+                            const char *pointer, const std::string &units);
+        void Write_Buffer();
+        void Write_Header();
+        void Write_Block();
+        void Write_Footer();
+
+    public:
+        IO_Columns_Out();
+        ~IO_Columns_Out();
+
+        template <class T>
+        int Add_Column(const std::string name, const T *const pointer, const std::string units = "")
+        {
+            Add_Column_Raw(name, IO_Type_Kind<T>::value, sizeof(T), (const char *) pointer, units);
+            return int(columns.size()) - 1;
+        }
+        void Set_Rows_Per_Block(const uint32_t _rows_per_block);
+
+        bool Open_File(const std::string full_mode = "w", const bool quiet = false);
+        void Append_Row();
+        void Flush();
+        void Close_File();
+        void Emergency_Flush(const int signal_number, const bool is_fatal);
+
+        inline uint64_t Get_Nb_Rows()       { return nb_rows; }
+};
+
+// **************************************************************
+class IO_Columns_In
+/**
+ * Read files written by IO_Columns_Out, one column at a time.
+ * Values are converted to the requested type.
+ */
+{
+    private:
+        std::string filename;
+        FILE *fh;
+        bool swap;                  // File byte order differs from host
+        uint32_t rows_per_block;
+        uint64_t nb_rows;
+        std::vector<IO_Column> columns;
+        std::vector<uint64_t> block_nb_rows;
+        std::vector<char> chunk;
+        std::vector<char> decoded;
+
+        void Read_Bytes(void *p, const size_t size);
+        template <class T> T Read_Value();
+        std::string Read_String();
+        bool Read_Footer(const long header_end);
+        void Scan_Blocks(const long header_end);
+        void Read_Chunk(const int column, const size_t block);
+        template <class T> void Convert(const IO_Column &column, const size_t count, T *out);
+
+    public:
+        IO_Columns_In();
+        IO_Columns_In(const std::string _filename);
+        ~IO_Columns_In();
+        void Open(const std::string _filename);
+        void Close();
+
+        int         Column_Index(const std::string &name) const;
+        int         Get_Nb_Columns() const                  { return int(columns.size()); }
+        std::string Get_Column_Name(const int column) const { return columns[column].name;  }
+        std::string Get_Column_Units(const int column) const{ return columns[column].units; }
+        uint64_t    Get_Nb_Rows() const                     { return nb_rows; }
+
+        template <class T> void Read(const int column, std::vector<T> &values);
+        template <class T> void Read(const std::string &name, std::vector<T> &values)
+        {
+            Read(Column_Index(name), values);
+        }
+};
+
+#endif // INC_IO_COLUMNS_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,219 @@
+
+#include <cstdlib>  // abort()
+#include <cstdio>   // rename()
+#include <cstring>  // strerror()
+#include <cerrno>
+#include <fcntl.h>  // open()
+#include <unistd.h> // fsync(), close()
+
+#include <StdCout.hpp>
+
+#include "IO_Durability.hpp"
+#include "IO_Stats.hpp"
+
+// **************************************************************
+static void Fsync_Folder(const std::string &path)
+/**
+ * Best effort: some filesystems can't fsync a folder.
+ */
+{
+    const int folder_fd = open(path.c_str(), O_RDONLY);
+    if (folder_fd == -1)
+        return;
+    fsync(folder_fd);
+    close(folder_fd);
+}
+
+// **************************************************************
+IO_Durability::IO_Durability(const Policy _policy, const bool _atomic_rename)
+{
+    policy          = _policy;
+    atomic_rename   = _atomic_rename;
+    group_bytes     = 0;
+    group_time      = 0.0;
+    fd              = -1;
+    is_open         = false;
+    pending_bytes   = 0;
+    last_commit     = 0.0;
+    nb_writes       = 0;
+    nb_fsyncs       = 0;
+    fsync_time      = 0.0;
+}
+
+// **************************************************************
+IO_Durability::IO_Durability(const IO_Durability &other)
+{
+    fd      = -1;
+    is_open = false;
+    *this   = other;
+}
+
+// **************************************************************
+IO_Durability & IO_Durability::operator=(const IO_Durability &other)
+/**
+ * Copy the policy and statistics, not the state of an opened file.
+ */
+{
+    if (this == &other)
+        return *this;
+
+    assert(!is_open);
+
+    policy          = other.policy;
+    atomic_rename   = other.atomic_rename;
+    group_bytes     = other.group_bytes;
+    group_time      = other.group_time;
+    pending_bytes   = 0;
+    last_commit     = 0.0;
+    nb_writes       = other.nb_writes;
+    nb_fsyncs       = other.nb_fsyncs;
+    fsync_time      = other.fsync_time;
+
+    return *this;
+}
+
+// **************************************************************
+IO_Durability::~IO_Durability()
+{
+    if (fd != -1)
+        close(fd);
+}
+
+// **************************************************************
+void IO_Durability::Set_Group_Commit(const uint64_t bytes, const double milliseconds)
+{
+    assert(bytes > 0 || milliseconds > 0.0);
+
+    policy      = Group_Commit;
+    group_bytes = bytes;
+    group_time  = 1.0e-3 * milliseconds;
+}
+
+// **************************************************************
+std::string IO_Durability::Open(const std::string &_filename)
+/**
+ * Start tracking a file about to be created.
+ * @return  Name under which the file must be created
+ */
+{
+    // Previous file not closed (its opening failed): forget it.
+    if (fd != -1)
+        close(fd);
+    fd              = -1;
+
+    filename        = _filename;
+    open_filename   = (atomic_rename ? filename + ".tmp" : filename);
+    is_open         = true;
+    pending_bytes   = 0;
+    last_commit     = IO_Wall_Time();
+    nb_writes       = 0;
+    nb_fsyncs       = 0;
+    fsync_time      = 0.0;
+
+    return open_filename;
+}
+
+// **************************************************************
+bool IO_Durability::Written(const size_t bytes)
+/**
+ * Account for a write.
+ * @return  true if the owner should flush its buffers and call Sync()
+ */
+{
+    if (!is_open)
+        return false;
+
+    nb_writes++;
+    pending_bytes += bytes;
+
+    if (policy != Group_Commit)
+        return false;
+
+    if (group_bytes > 0 && pending_bytes >= group_bytes)
+        return true;
+    if (group_time > 0.0 && IO_Wall_Time() - last_commit >= group_time)
+        return true;
+
+    return false;
+}
+
+// **************************************************************
+void IO_Durability::Sync()
+/**
+ * fsync() the file. The owner must have flushed its own buffers.
+ * fsync() on any descriptor of a file commits all its data, so a
+ * descriptor of our own is used whatever the owner's backend.
+ */
+{
+    assert(is_open);
+
+    if (fd == -1)
+    {
+        fd = open(open_filename.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            std_cout << "ERROR: Could not open '" << open_filename << "' to fsync it: " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    const double start = IO_Wall_Time();
+    if (fsync(fd) != 0)
+    {
+        std_cout << "ERROR: Could not fsync '" << open_filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    last_commit = IO_Wall_Time();
+    fsync_time += last_commit - start;
+    nb_fsyncs++;
+    pending_bytes = 0;
+}
+
+// **************************************************************
+void IO_Durability::Close()
+/**
+ * Called once the owner closed the file: final commit, then rename.
+ */
+{
+    if (!is_open)
+        return;
+
+    // Closing may have written more (buffers, NetCDF header): always commit.
+    if (policy != None)
+        Sync();
+
+    if (fd != -1)
+        close(fd);
+    fd = -1;
+
+    if (atomic_rename)
+    {
+        if (rename(open_filename.c_str(), filename.c_str()) != 0)
+        {
+            std_cout << "ERROR: Could not rename '" << open_filename << "' to '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        // The rename itself is only durable once the folder is committed.
+        if (policy != None)
+        {
+            const size_t slash = filename.rfind('/');
+            Fsync_Folder(slash == std::string::npos ? std::string(".") : filename.substr(0, slash+1));
+        }
+    }
+
+    is_open = false;
+}
+
+// **************************************************************
+void IO_Durability::Print()
+{
+    const char *names[] = {"none", "fsync on close", "group commit"};
+    std_cout
+        << "Durability of '" << filename << "':\n"
+        << "    policy:          " << names[policy] << (atomic_rename ? ", atomic rename" : "") << "\n"
+        << "    writes:          " << nb_writes << "\n"
+        << "    fsyncs:          " << nb_fsyncs << " (" << fsync_time << " s)\n"
+        << "    fsyncs saved:    " << Get_Nb_Fsyncs_Saved() << "\n";
+}
+
+// ********** End of file ***************************************
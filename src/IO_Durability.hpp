@@ -0,0 +1,93 @@
+#ifndef INC_IO_DURABILITY_hpp
+#define INC_IO_DURABILITY_hpp
+
+#include <string>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+class IO_Durability
+/**
+ * How hard IO and NetCDF_Out try to get data onto stable storage.
+ *
+ *      None            Leave it to the kernel (default).
+ *      Fsync_On_Close  fsync() once, when the file is closed.
+ *      Group_Commit    fsync() when "bytes" were written or "milliseconds"
+ *                      elapsed since the last fsync (checked at each
+ *                      write), and when the file is closed.
+ *
+ * With "atomic_rename", the file is written as "<name>.tmp" and renamed
+ * to its final name when closed (after the fsync, if any), so a crash
+ * never leaves a partial file under the final name.
+ *
+ *      IO_Durability durability(IO_Durability::Group_Commit, true);
+ *      durability.Set_Group_Commit(64*1024*1024, 1000.0);
+ *      checkpoint.Set_Durability(durability);
+ *      checkpoint.Open_File("wb");
+ *      ...
+ *      checkpoint.Close_File();
+ *      checkpoint.Get_Durability().Print();
+ *
+ * The policy is copied by the object it is attached to; statistics are
+ * read back from that copy. They count the writes reaching the file
+ * (after "async" or "producers" buffering); "fsyncs saved" is how many
+ * more fsync() calls syncing after every such write would have cost.
+ */
+{
+    public:
+        enum Policy
+        {
+            None            = 0,
+            Fsync_On_Close  = 1,
+            Group_Commit    = 2
+        };
+
+    private:
+        Policy policy;
+        bool atomic_rename;
+        uint64_t group_bytes;       // Commit after this many bytes (0: never)
+        double group_time;          // Commit after this long (seconds, 0: never)
+
+        std::string filename;       // Final name
+        std::string open_filename;  // Name actually written to
+        int fd;                     // Opened on first Sync()
+        bool is_open;
+        uint64_t pending_bytes;     // Written since last commit
+        double last_commit;         // Wall time of last commit
+
+        uint64_t nb_writes;
+        uint64_t nb_fsyncs;
+        double fsync_time;          // Total time spent in fsync() (seconds)
+
+    public:
+        IO_Durability(const Policy _policy = None, const bool _atomic_rename = false);
+        IO_Durability(const IO_Durability &other);
+        IO_Durability & operator=(const IO_Durability &other);
+        ~IO_Durability();
+
+        void Set_Group_Commit(const uint64_t bytes, const double milliseconds);
+
+        // Used by the file's owner
+        std::string Open(const std::string &_filename);
+        bool Written(const size_t bytes);
+        void Sync();
+        void Close();
+
+        inline bool     Is_Enabled()        { return (policy != None || atomic_rename); }
+        inline Policy   Get_Policy()        { return policy;        }
+        inline bool     Is_Atomic_Rename()  { return atomic_rename; }
+        inline uint64_t Get_Nb_Writes()     { return nb_writes;     }
+        inline uint64_t Get_Nb_Fsyncs()     { return nb_fsyncs;     }
+        inline uint64_t Get_Nb_Fsyncs_Saved() { return (nb_writes > nb_fsyncs ? nb_writes - nb_fsyncs : 0); }
+        inline double   Get_Fsync_Time()    { return fsync_time;    }
+        void Print();
+};
+
+#endif // INC_IO_DURABILITY_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,321 @@
+
+#include <cstdlib>  // atexit()
+#include <cstring>  // memset()
+#include <cerrno>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>   // poll()
+#include <fcntl.h>  // fcntl()
+#include <unistd.h> // pipe(), read(), write(), getpid()
+#include <time.h>   // nanosleep()
+
+#include <StdCout.hpp>
+
+#include "IO_Emergency.hpp"
+#include "IO_Stats.hpp"
+
+// Slots are taken and released with atomic operations, so that the
+// signal handler can walk them without a lock.
+static IO_Emergency_Client * volatile clients[IO_EMERGENCY_MAX_CLIENTS];
+
+static const int fatal_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGTERM, SIGINT};
+static const int nb_fatal_signals = int(sizeof(fatal_signals)/sizeof(fatal_signals[0]));
+static struct sigaction previous_actions[sizeof(fatal_signals)/sizeof(fatal_signals[0])];
+static volatile int handlers_installed = 0;
+static volatile int draining = 0;
+
+// The signal handler writes {signal number, is fatal} to "wake_pipe" and
+// waits for a byte on "done_pipe": the drain thread does the rest.
+static int wake_pipe[2] = {-1, -1};
+static int done_pipe[2] = {-1, -1};
+static pid_t drain_pid = 0;         // Not in a fork()ed child: no drain thread there
+
+// **************************************************************
+static void Flush_Clients(const int signal_number, const bool is_fatal, const bool async_signal_safe)
+{
+    for (int i = 0 ; i < IO_EMERGENCY_MAX_CLIENTS ; i++)
+    {
+        IO_Emergency_Client *client = clients[i];
+        if (client != NULL and client->Is_Async_Signal_Safe() == async_signal_safe)
+            client->Emergency_Flush(signal_number, is_fatal);
+    }
+}
+
+// **************************************************************
+static bool Read_Full(const int fd, char *p, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t nb_read = read(fd, p, size);
+        if (nb_read < 0 and errno == EINTR)
+            continue;
+        if (nb_read <= 0)
+            return false;
+        p    += nb_read;
+        size -= size_t(nb_read);
+    }
+    return true;
+}
+
+// **************************************************************
+static void * Drain_Thread_Main(void *)
+/**
+ * Signals are blocked here: they go to the other threads, whose
+ * handler waits for this one.
+ */
+{
+    sigset_t all_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, NULL);
+
+    int request[2];
+    while (Read_Full(wake_pipe[0], (char *) request, sizeof(request)))
+    {
+        Flush_Clients(request[0], (request[1] != 0), false);
+
+        const char done = 1;
+        while (write(done_pipe[1], &done, 1) < 0 and errno == EINTR)
+            ;
+    }
+    return NULL;
+}
+
+// **************************************************************
+static void Wake_Drain_Thread(const int signal_number, const bool is_fatal)
+/**
+ * Async-signal-safe: write(), poll() and read() only. Gives up after
+ * IO_EMERGENCY_TIMEOUT seconds.
+ */
+{
+    if (wake_pipe[1] == -1 or getpid() != drain_pid)
+        return;
+
+    const int request[2] = {signal_number, int(is_fatal)};
+    if (write(wake_pipe[1], request, sizeof(request)) != ssize_t(sizeof(request)))
+        return;
+
+    struct pollfd done;
+    done.fd     = done_pipe[0];
+    done.events = POLLIN;
+    // Interrupted polls count as full slices: the wait stays bounded.
+    for (int waited = 0 ; waited < 1000*IO_EMERGENCY_TIMEOUT ; waited += 100)
+    {
+        done.revents = 0;
+        if (poll(&done, 1, 100) > 0)
+        {
+            char byte;
+            if (read(done_pipe[0], &byte, 1) == 1)
+                return;
+        }
+    }
+}
+
+// **************************************************************
+static void Emergency_Signal_Handler(int signal_number, siginfo_t *info, void *context)
+/**
+ * Drain every client (not while already draining), then hand the signal
+ * to the previous handler, or to the default action which terminates
+ * the process. A signal that was ignored stays ignored.
+ */
+{
+    int index = 0;
+    while (index < nb_fatal_signals - 1 and fatal_signals[index] != signal_number)
+        index++;
+    struct sigaction &previous = previous_actions[index];
+
+    const bool has_siginfo = ((previous.sa_flags & SA_SIGINFO) != 0);
+    if (!has_siginfo and previous.sa_handler == SIG_IGN)
+        return;
+    const bool is_fatal = (!has_siginfo and previous.sa_handler == SIG_DFL);
+
+    // A signal raised while draining (e.g. a crash in a flush) goes straight on.
+    if (__sync_bool_compare_and_swap(&draining, 0, 1))
+    {
+        const int saved_errno = errno;
+        Flush_Clients(signal_number, is_fatal, true);
+        Wake_Drain_Thread(signal_number, is_fatal);
+        errno = saved_errno;
+
+        // The process goes on: a later signal or exit() drains again.
+        if (!is_fatal)
+            __sync_lock_release(&draining);
+    }
+
+    if (has_siginfo)
+    {
+        previous.sa_sigaction(signal_number, info, context);
+    }
+    else if (previous.sa_handler == SIG_DFL)
+    {
+        sigaction(signal_number, &previous, NULL);
+        raise(signal_number);
+    }
+    else
+    {
+        previous.sa_handler(signal_number);
+    }
+}
+
+// **************************************************************
+static void Emergency_At_Exit()
+{
+    if (__sync_bool_compare_and_swap(&draining, 0, 1))
+    {
+        Flush_Clients(0, true, true);
+        Flush_Clients(0, true, false);
+    }
+}
+
+// **************************************************************
+static void Start_Drain_Thread()
+{
+    if (pipe(wake_pipe) != 0 or pipe(done_pipe) != 0)
+    {
+        std_cout << "WARNING: Could not create the emergency drain pipes: only flight recorders will be saved if the process dies from a signal.\n";
+        wake_pipe[1] = -1;
+        return;
+    }
+    for (int i = 0 ; i < 2 ; i++)
+    {
+        fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(done_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, Drain_Thread_Main, NULL) != 0)
+    {
+        std_cout << "WARNING: Could not create the emergency drain thread: only flight recorders will be saved if the process dies from a signal.\n";
+        wake_pipe[1] = -1;
+    }
+    pthread_attr_destroy(&attributes);
+    drain_pid = getpid();
+}
+
+// **************************************************************
+void IO_Emergency_Lock::Acquire()
+{
+    const pthread_t self = pthread_self();
+    // "owner" is set before "depth": a non-zero depth comes with its owner.
+    if (depth > 0)
+    {
+        __sync_synchronize();
+        if (pthread_equal(owner, self))
+        {
+            depth++;
+            return;
+        }
+    }
+
+    while (!__sync_bool_compare_and_swap(&held, 0, 1))
+    {
+        timespec duration = {0, 50000};
+        nanosleep(&duration, NULL);
+    }
+    owner = self;
+    __sync_synchronize();
+    depth = 1;
+}
+
+// **************************************************************
+bool IO_Emergency_Lock::Try_Acquire(const double timeout)
+/**
+ * @return  false if another thread still held the lock after "timeout" seconds
+ */
+{
+    const pthread_t self = pthread_self();
+    if (depth > 0)
+    {
+        __sync_synchronize();
+        if (pthread_equal(owner, self))
+        {
+            depth++;
+            return true;
+        }
+    }
+
+    const double start = IO_Wall_Time();
+    while (!__sync_bool_compare_and_swap(&held, 0, 1))
+    {
+        if (IO_Wall_Time() - start > timeout)
+            return false;
+        timespec duration = {0, 50000};
+        nanosleep(&duration, NULL);
+    }
+    owner = self;
+    __sync_synchronize();
+    depth = 1;
+    return true;
+}
+
+// **************************************************************
+void IO_Emergency_Lock::Release()
+{
+    assert(depth > 0);
+
+    depth--;
+    if (depth == 0)
+        __sync_lock_release(&held);
+}
+
+// **************************************************************
+void IO_Emergency_Enable()
+/**
+ * Install the drain thread, the signal handlers and the atexit()
+ * function; outputs opened from then on are saved if the process dies.
+ * Call it early in main(), before other threads start writing, and
+ * after installing the application's own handlers for these signals
+ * (they are then called after the drain).
+ */
+{
+    if (__sync_bool_compare_and_swap(&handlers_installed, 0, 1))
+    {
+        Start_Drain_Thread();
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = Emergency_Signal_Handler;
+        action.sa_flags     = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        for (int i = 0 ; i < nb_fatal_signals ; i++)
+            sigaction(fatal_signals[i], &action, &previous_actions[i]);
+        atexit(Emergency_At_Exit);
+    }
+}
+
+// **************************************************************
+bool IO_Emergency_Is_Enabled()
+{
+    return (handlers_installed != 0);
+}
+
+// **************************************************************
+bool IO_Emergency_Register(IO_Emergency_Client *client)
+/**
+ * @return  false if the client won't be saved (not enabled, or no room)
+ */
+{
+    assert(client != NULL);
+
+    if (!IO_Emergency_Is_Enabled())
+        return false;
+
+    for (int i = 0 ; i < IO_EMERGENCY_MAX_CLIENTS ; i++)
+    {
+        if (__sync_bool_compare_and_swap(&clients[i], (IO_Emergency_Client *) NULL, client))
+            return true;
+    }
+    std_cout << "WARNING: More than " << IO_EMERGENCY_MAX_CLIENTS << " open outputs: one of them won't be saved if the process dies.\n";
+    return false;
+}
+
+// **************************************************************
+void IO_Emergency_Unregister(IO_Emergency_Client *client)
+{
+    for (int i = 0 ; i < IO_EMERGENCY_MAX_CLIENTS ; i++)
+        __sync_bool_compare_and_swap(&clients[i], client, (IO_Emergency_Client *) NULL);
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,85 @@
+#ifndef INC_IO_EMERGENCY_hpp
+#define INC_IO_EMERGENCY_hpp
+
+#include <cstddef> // NULL
+#include <pthread.h>
+
+// Maximum number of objects drained by the emergency path
+#define IO_EMERGENCY_MAX_CLIENTS 4096
+
+// Seconds the signal handler waits for the drain thread
+#define IO_EMERGENCY_TIMEOUT 10
+
+// Seconds the drain thread waits for an output's writer to let it go
+#define IO_EMERGENCY_LOCK_WAIT 0.1
+
+class IO_Emergency_Client
+/**
+ * Object with buffered output to save when the process dies: once
+ * IO_Emergency_Enable() was called, every IO opened for writing,
+ * NetCDF_Out and flight recorder registers itself.
+ *
+ * Emergency_Flush() is called at exit() (signal_number 0: the object
+ * should close as usual) or after SIGSEGV, SIGBUS, SIGFPE, SIGILL,
+ * SIGABRT, SIGTERM or SIGINT. After a signal, clients whose
+ * Emergency_Flush() is async-signal-safe are called from the handler
+ * itself; the others from a drain thread started beforehand, which the
+ * handler wakes up and waits for (at most IO_EMERGENCY_TIMEOUT seconds,
+ * e.g. if the interrupted thread holds a lock the drain needs).
+ * "is_fatal" tells that the process dies next (default action of the
+ * signal): files can be closed. Otherwise the process goes on, and a
+ * later signal or exit() calls Emergency_Flush() again.
+ */
+{
+    public:
+        virtual ~IO_Emergency_Client() {}
+        virtual void Emergency_Flush(const int signal_number, const bool is_fatal) = 0;
+        virtual bool Is_Async_Signal_Safe() { return false; }
+};
+
+class IO_Emergency_Lock
+/**
+ * Held by a client's owner while it uses its file handles, and by the
+ * drain thread while it saves the client: writers then wait, until the
+ * end if the process is dying. Recursive for the thread holding it.
+ * Clients only take it once registered (see IO_Emergency_Enable()).
+ */
+{
+    private:
+        volatile int held;
+        volatile int depth;             // Of the owner's acquisitions
+        pthread_t owner;
+
+    public:
+        IO_Emergency_Lock() : held(0), depth(0) {}
+        IO_Emergency_Lock(const IO_Emergency_Lock &) : held(0), depth(0) {}
+        IO_Emergency_Lock & operator=(const IO_Emergency_Lock &) { return *this; }
+
+        void Acquire();
+        bool Try_Acquire(const double timeout);
+        void Release();
+};
+
+class IO_Emergency_Guard
+/**
+ * Holds "lock" for its lifetime, if not NULL.
+ */
+{
+    private:
+        IO_Emergency_Lock *lock;
+        IO_Emergency_Guard(const IO_Emergency_Guard &);
+        IO_Emergency_Guard & operator=(const IO_Emergency_Guard &);
+
+    public:
+        IO_Emergency_Guard(IO_Emergency_Lock *_lock) : lock(_lock) { if (lock != NULL) lock->Acquire(); }
+        ~IO_Emergency_Guard()                                      { if (lock != NULL) lock->Release(); }
+};
+
+void IO_Emergency_Enable();
+bool IO_Emergency_Is_Enabled();
+bool IO_Emergency_Register(IO_Emergency_Client *client);
+void IO_Emergency_Unregister(IO_Emergency_Client *client);
+
+#endif // INC_IO_EMERGENCY_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,119 @@
+
+#include <cstdlib>  // abort()
+#include <cstdio>   // vsnprintf()
+#include <sys/uio.h> // iovec
+
+#include <StdCout.hpp>
+
+#include "InputOutput.hpp"
+#include "IO_Gather.hpp"
+
+#ifndef va_copy
+#define va_copy(destination, source) __va_copy(destination, source)
+#endif // #ifndef va_copy
+
+// **************************************************************
+IO_Gather::IO_Gather()
+{
+    owner           = NULL;
+    used            = 0;
+    capacity        = 0;
+    nb_fragments    = 0;
+    max_fragments   = 0;
+    nb_batches      = 0;
+}
+
+// **************************************************************
+void IO_Gather::Start(IO *_owner, const size_t _capacity, const size_t _max_fragments)
+{
+    assert(_owner != NULL);
+    assert(_capacity > 0);
+
+    owner           = _owner;
+    capacity        = _capacity;
+    max_fragments   = _max_fragments;
+    used            = 0;
+    nb_fragments    = 0;
+    nb_batches      = 0;
+    batch.resize(capacity + 1);
+}
+
+// **************************************************************
+void IO_Gather::Write_Batch(const char *p, const size_t size)
+/**
+ * Write the batch followed by p[0, size) in one call.
+ */
+{
+    struct iovec iov[2];
+    int nb = 0;
+    if (used > 0)
+    {
+        iov[nb].iov_base = (void *) &batch[0];
+        iov[nb].iov_len  = used;
+        nb++;
+    }
+    if (size > 0)
+    {
+        iov[nb].iov_base = (void *) p;
+        iov[nb].iov_len  = size;
+        nb++;
+    }
+    if (nb == 0)
+        return;
+
+    owner->Write_Vector(iov, nb);
+    used            = 0;
+    nb_fragments    = 0;
+    nb_batches++;
+}
+
+// **************************************************************
+void IO_Gather::Flush()
+{
+    Write_Batch(NULL, 0);
+}
+
+// **************************************************************
+size_t IO_Gather::Append_Formatted(const char *format, va_list args)
+/**
+ * printf() directly into the batch.
+ * @return  Number of characters written
+ */
+{
+    for (int attempt = 0 ; attempt < 2 ; attempt++)
+    {
+        va_list args_copy;
+        va_copy(args_copy, args);
+        const int length = vsnprintf(&batch[used], capacity + 1 - used, format, args_copy);
+        va_end(args_copy);
+        if (length < 0)
+        {
+            std_cout << "Couldn't call vsnprintf! Aborting.\n" << std::flush;
+            abort();
+        }
+        if (size_t(length) <= capacity - used)
+        {
+            used += size_t(length);
+            if (++nb_fragments == max_fragments)
+                Flush();
+            return size_t(length);
+        }
+        if (size_t(length) > capacity)
+        {
+            // Longer than a whole batch: written with it, from scratch.
+            scratch.resize(size_t(length) + 1);
+            va_copy(args_copy, args);
+            vsnprintf(&scratch[0], scratch.size(), format, args_copy);
+            va_end(args_copy);
+            Write_Batch(&scratch[0], size_t(length));
+            return size_t(length);
+        }
+        Flush();
+    }
+
+    // Fits in an empty batch: can't be here.
+    assert(false);
+    return 0;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,69 @@
+#ifndef INC_IO_GATHER_hpp
+#define INC_IO_GATHER_hpp
+
+#include <vector>
+#include <cstring>  // memcpy()
+#include <cstdarg>
+#include <cstddef>  // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+class IO;
+
+// Default size threshold of a batch (bytes)
+#define IO_GATHER_DEFAULT_SIZE (64*1024)
+
+class IO_Gather
+/**
+ * Write coalescing used by IO's "gather" mode.
+ *
+ * Small writes are copied (WriteString() formats in place) one after
+ * the other into a batch, which is handed to IO::Write_Vector() when
+ * it reaches "capacity" bytes or "max_fragments" writes: a single
+ * writev() on the C handle, a single write on the fstream. A write
+ * that does not fit is not copied: it goes out in the same writev()
+ * as the batch.
+ */
+{
+    private:
+        IO *owner;                  // IO object owning the file handle
+        std::vector<char> batch;    // capacity bytes, plus one for vsnprintf()'s '\0'
+        std::vector<char> scratch;  // Formatted strings longer than the batch
+        size_t used;                // Bytes in the batch
+        size_t capacity;
+        size_t nb_fragments;        // Writes in the batch
+        size_t max_fragments;       // 0: no limit
+        uint64_t nb_batches;        // Number of Write_Vector() calls
+
+        void Write_Batch(const char *p, const size_t size);
+
+    public:
+        IO_Gather();
+        void Start(IO *_owner, const size_t _capacity = IO_GATHER_DEFAULT_SIZE, const size_t _max_fragments = 0);
+        size_t Append_Formatted(const char *format, va_list args);
+        void Flush();
+
+        inline void Append(const char *p, const size_t size)
+        {
+            if (size > capacity - used)
+            {
+                Write_Batch(p, size);
+                return;
+            }
+            memcpy(&batch[used], p, size);
+            used += size;
+            if (++nb_fragments == max_fragments)
+                Flush();
+        }
+
+        inline uint64_t Get_Nb_Batches()    { return nb_batches; }
+};
+
+#endif // INC_IO_GATHER_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,474 @@
+
+#include <cstring>  // memcpy()
+#include <vector>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include <StdCout.hpp>
+
+#include "IO_Gorilla.hpp"
+
+// **************************************************************
+static inline uint64_t Low_Bits(const int nb_bits)
+{
+    return (nb_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << nb_bits) - 1);
+}
+
+// **************************************************************
+class Bit_Writer
+{
+    private:
+        std::vector<char> &out;
+        uint64_t buffer;
+        int nb_bits;                    // Pending in "buffer", less than 8
+
+    public:
+        Bit_Writer(std::vector<char> &_out) : out(_out), buffer(0), nb_bits(0) {}
+
+        inline void Put(const uint64_t value, const int size)
+        {
+            if (size > 32)
+            {
+                Put(value >> 32, size - 32);
+                Put(value, 32);
+                return;
+            }
+            buffer   = (buffer << size) | (value & Low_Bits(size));
+            nb_bits += size;
+            while (nb_bits >= 8)
+            {
+                nb_bits -= 8;
+                out.push_back(char((buffer >> nb_bits) & 0xFF));
+            }
+        }
+
+        inline void Finish()
+        {
+            if (nb_bits > 0)
+                out.push_back(char((buffer << (8 - nb_bits)) & 0xFF));
+            nb_bits = 0;
+        }
+};
+
+// **************************************************************
+class Bit_Reader
+{
+    private:
+        const unsigned char *p;
+        size_t size;
+        size_t position;
+        uint64_t buffer;
+        int nb_bits;
+
+    public:
+        bool overflow;                  // Read past the end
+
+        Bit_Reader(const char *_p, const size_t _size)
+            : p((const unsigned char *) _p), size(_size), position(0), buffer(0), nb_bits(0), overflow(false) {}
+
+        inline uint64_t Get(const int count)
+        {
+            if (count > 32)
+            {
+                const uint64_t high = Get(count - 32);
+                return (high << 32) | Get(32);
+            }
+            while (nb_bits < count)
+            {
+                buffer = (buffer << 8) | (position < size ? uint64_t(p[position]) : 0);
+                overflow = (overflow || position >= size);
+                position++;
+                nb_bits += 8;
+            }
+            nb_bits -= count;
+            return (buffer >> nb_bits) & Low_Bits(count);
+        }
+};
+
+// **************************************************************
+static inline uint64_t Zigzag(const uint64_t value)
+{
+    return (value << 1) ^ (0 - (value >> 63));
+}
+
+// **************************************************************
+static inline uint64_t Unzigzag(const uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+// **************************************************************
+static inline void Put_Varint(std::vector<char> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+// **************************************************************
+static inline bool Get_Varint(const unsigned char *p, const size_t size, size_t &position, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0 ; shift < 64 ; shift += 7)
+    {
+        if (position >= size)
+            return false;
+        const unsigned char byte = p[position++];
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// **************************************************************
+template <class Stored>
+static void Encode_Integers(const char *values, const size_t count, std::vector<char> &encoded)
+/**
+ * Differences are taken modulo 2^64, so any integer type round-trips.
+ */
+{
+    uint64_t previous = 0;
+    uint64_t previous_delta = 0;
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        Stored stored;
+        memcpy(&stored, values + i*sizeof(Stored), sizeof(Stored));
+        const uint64_t value = uint64_t(int64_t(stored));
+        const uint64_t delta = value - previous;
+        if (i == 0)
+            Put_Varint(encoded, Zigzag(value));
+        else if (i == 1)
+            Put_Varint(encoded, Zigzag(delta));
+        else
+            Put_Varint(encoded, Zigzag(delta - previous_delta));
+        previous_delta  = delta;
+        previous        = value;
+    }
+}
+
+// **************************************************************
+template <class Stored>
+static bool Decode_Integers(const char *encoded, const size_t size, const size_t count, char *values)
+{
+    size_t position = 0;
+    uint64_t previous = 0;
+    uint64_t delta = 0;
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        uint64_t zigzag;
+        if (!Get_Varint((const unsigned char *) encoded, size, position, zigzag))
+            return false;
+        if (i == 0)
+        {
+            previous = Unzigzag(zigzag);
+        }
+        else
+        {
+            delta     = (i == 1 ? Unzigzag(zigzag) : delta + Unzigzag(zigzag));
+            previous += delta;
+        }
+
+        const Stored stored = Stored(int64_t(previous));
+        memcpy(values + i*sizeof(Stored), &stored, sizeof(Stored));
+    }
+    return (position == size);
+}
+
+// **************************************************************
+template <class Bits>
+static void Encode_Floats(const char *values, const size_t count, std::vector<char> &encoded)
+/**
+ * "Bits" is the unsigned integer of the floating point type's size.
+ */
+{
+    const int width = int(8*sizeof(Bits));
+    Bit_Writer writer(encoded);
+    uint64_t previous = 0;
+    int previous_leading  = -1;         // No window yet
+    int previous_trailing = 0;
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        Bits bits;
+        memcpy(&bits, values + i*sizeof(Bits), sizeof(Bits));
+        const uint64_t value = uint64_t(bits);
+        if (i == 0)
+        {
+            writer.Put(value, width);
+            previous = value;
+            continue;
+        }
+
+        const uint64_t x = value ^ previous;
+        previous = value;
+        if (x == 0)
+        {
+            writer.Put(0, 1);
+            continue;
+        }
+
+        int leading = __builtin_clzll(x) - (64 - width);
+        const int trailing = __builtin_ctzll(x);
+        if (leading > 31)
+            leading = 31;
+
+        if (previous_leading >= 0 && leading >= previous_leading && trailing >= previous_trailing)
+        {
+            writer.Put(2, 2);
+            writer.Put(x >> previous_trailing, width - previous_leading - previous_trailing);
+        }
+        else
+        {
+            const int length = width - leading - trailing;
+            writer.Put(3, 2);
+            writer.Put(uint64_t(leading), 5);
+            writer.Put(uint64_t(length & 63), 6);
+            writer.Put(x >> trailing, length);
+            previous_leading  = leading;
+            previous_trailing = trailing;
+        }
+    }
+    writer.Finish();
+}
+
+// **************************************************************
+template <class Bits>
+static bool Decode_Floats(const char *encoded, const size_t size, const size_t count, char *values)
+{
+    const int width = int(8*sizeof(Bits));
+    Bit_Reader reader(encoded, size);
+    uint64_t previous = 0;
+    int leading  = 0;
+    int trailing = 0;
+    for (size_t i = 0 ; i < count && !reader.overflow ; i++)
+    {
+        if (i == 0)
+        {
+            previous = reader.Get(width);
+        }
+        else if (reader.Get(1) == 1)
+        {
+            if (reader.Get(1) == 1)
+            {
+                leading = int(reader.Get(5));
+                int length = int(reader.Get(6));
+                if (length == 0)
+                    length = 64;
+                trailing = width - leading - length;
+                if (trailing < 0)
+                    return false;
+            }
+            previous ^= reader.Get(width - leading - trailing) << trailing;
+        }
+
+        const Bits bits = Bits(previous);
+        memcpy(values + i*sizeof(Bits), &bits, sizeof(Bits));
+    }
+    return !reader.overflow;
+}
+
+// Bits of the delta-of-delta after the prefixes '10', '110' and '1110'
+static const int step_bits[3] = {7, 9, 12};
+
+// **************************************************************
+static inline uint64_t Sign_Extend(const uint64_t value, const int width)
+{
+    const uint64_t sign = uint64_t(1) << (width - 1);
+    return ((value & Low_Bits(width)) ^ sign) - sign;
+}
+
+// **************************************************************
+template <class Bits>
+static void Encode_Float_Steps(const char *values, const size_t count, std::vector<char> &encoded)
+/**
+ * Delta-of-delta of the bit patterns, modulo 2^width.
+ */
+{
+    const int width = int(8*sizeof(Bits));
+    Bit_Writer writer(encoded);
+    uint64_t previous = 0;
+    uint64_t previous_delta = 0;
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        Bits bits;
+        memcpy(&bits, values + i*sizeof(Bits), sizeof(Bits));
+        const uint64_t value = uint64_t(bits);
+        if (i == 0)
+        {
+            writer.Put(value, width);
+            previous = value;
+            continue;
+        }
+
+        const uint64_t delta = value - previous;
+        const uint64_t zigzag = Zigzag(Sign_Extend(delta - previous_delta, width)) & Low_Bits(width);
+        previous_delta  = delta;
+        previous        = value;
+
+        if (zigzag == 0)
+        {
+            writer.Put(0, 1);
+            continue;
+        }
+        // Prefix: as many ones as the size class, then a zero (but for the last).
+        int size_class = 0;
+        while (size_class < 3 && zigzag >= (uint64_t(1) << step_bits[size_class]))
+            size_class++;
+        if (size_class < 3)
+        {
+            writer.Put(Low_Bits(size_class + 1) << 1, size_class + 2);
+            writer.Put(zigzag, step_bits[size_class]);
+        }
+        else
+        {
+            writer.Put(Low_Bits(4), 4);
+            writer.Put(zigzag, width);
+        }
+    }
+    writer.Finish();
+}
+
+// **************************************************************
+template <class Bits>
+static bool Decode_Float_Steps(const char *encoded, const size_t size, const size_t count, char *values)
+{
+    const int width = int(8*sizeof(Bits));
+    Bit_Reader reader(encoded, size);
+    uint64_t previous = 0;
+    uint64_t delta = 0;
+    for (size_t i = 0 ; i < count && !reader.overflow ; i++)
+    {
+        if (i == 0)
+        {
+            previous = reader.Get(width);
+        }
+        else
+        {
+            int size_class = 0;
+            while (size_class < 4 && reader.Get(1) == 1)
+                size_class++;
+            uint64_t zigzag = 0;
+            if (size_class > 0)
+                zigzag = reader.Get(size_class < 4 ? step_bits[size_class - 1] : width);
+            delta    += Unzigzag(zigzag);
+            previous += delta;
+        }
+
+        const Bits bits = Bits(previous);
+        memcpy(values + i*sizeof(Bits), &bits, sizeof(Bits));
+    }
+    return !reader.overflow;
+}
+
+// **************************************************************
+template <class Bits>
+static void Encode_Float_Chunk(const char *values, const size_t count, std::vector<char> &encoded)
+/**
+ * Both encodings are tried: a column switches to the steps when they
+ * are smaller, chunk by chunk.
+ */
+{
+    const size_t start = encoded.size();
+    encoded.push_back(char(IO_GORILLA_FLOAT_XOR));
+    Encode_Floats<Bits>(values, count, encoded);
+
+    std::vector<char> steps;
+    steps.reserve(encoded.size() - start);
+    steps.push_back(char(IO_GORILLA_FLOAT_STEPS));
+    Encode_Float_Steps<Bits>(values, count, steps);
+    if (steps.size() < encoded.size() - start)
+    {
+        encoded.resize(start);
+        encoded.insert(encoded.end(), steps.begin(), steps.end());
+    }
+}
+
+// **************************************************************
+template <class Bits>
+static bool Decode_Float_Chunk(const char *encoded, const size_t size, const size_t count, char *values)
+{
+    if (size == 0)
+        return false;
+    if (encoded[0] == char(IO_GORILLA_FLOAT_XOR))
+        return Decode_Floats<Bits>(encoded + 1, size - 1, count, values);
+    if (encoded[0] == char(IO_GORILLA_FLOAT_STEPS))
+        return Decode_Float_Steps<Bits>(encoded + 1, size - 1, count, values);
+    return false;
+}
+
+// **************************************************************
+bool IO_Gorilla_Is_Supported(const char kind, const size_t element_size)
+{
+    if (kind == 'f')
+        return (element_size == 4 || element_size == 8);
+    if (kind == 'i' || kind == 'u' || kind == 'c')
+        return (element_size == 1 || element_size == 2 || element_size == 4 || element_size == 8);
+    return false;
+}
+
+// **************************************************************
+void IO_Gorilla_Encode(const char kind, const size_t element_size,
+                       const char *values, const size_t count,
+                       std::vector<char> &encoded)
+/**
+ * Append the encoding of "count" values (host byte order) to "encoded".
+ */
+{
+    assert(IO_Gorilla_Is_Supported(kind, element_size));
+
+    const int type = 256*int(kind) + int(element_size);
+    switch (type)
+    {
+        case 256*'f' + 4: Encode_Float_Chunk<uint32_t>(values, count, encoded); break;
+        case 256*'f' + 8: Encode_Float_Chunk<uint64_t>(values, count, encoded); break;
+        case 256*'i' + 1: Encode_Integers<int8_t>     (values, count, encoded); break;
+        case 256*'i' + 2: Encode_Integers<int16_t>    (values, count, encoded); break;
+        case 256*'i' + 4: Encode_Integers<int32_t>    (values, count, encoded); break;
+        case 256*'i' + 8: Encode_Integers<int64_t>    (values, count, encoded); break;
+        case 256*'u' + 1: Encode_Integers<uint8_t>    (values, count, encoded); break;
+        case 256*'u' + 2: Encode_Integers<uint16_t>   (values, count, encoded); break;
+        case 256*'u' + 4: Encode_Integers<uint32_t>   (values, count, encoded); break;
+        case 256*'u' + 8: Encode_Integers<uint64_t>   (values, count, encoded); break;
+        case 256*'c' + 1: Encode_Integers<char>       (values, count, encoded); break;
+    }
+}
+
+// **************************************************************
+bool IO_Gorilla_Decode(const char kind, const size_t element_size,
+                       const char *encoded, const size_t size,
+                       const size_t count, char *values)
+/**
+ * Decode "count" values into "values" (host byte order).
+ * @return  false if "encoded" is not a valid encoding of "count" values
+ */
+{
+    if (!IO_Gorilla_Is_Supported(kind, element_size))
+        return false;
+
+    const int type = 256*int(kind) + int(element_size);
+    switch (type)
+    {
+        case 256*'f' + 4: return Decode_Float_Chunk<uint32_t>(encoded, size, count, values);
+        case 256*'f' + 8: return Decode_Float_Chunk<uint64_t>(encoded, size, count, values);
+        case 256*'i' + 1: return Decode_Integers<int8_t>     (encoded, size, count, values);
+        case 256*'i' + 2: return Decode_Integers<int16_t>    (encoded, size, count, values);
+        case 256*'i' + 4: return Decode_Integers<int32_t>    (encoded, size, count, values);
+        case 256*'i' + 8: return Decode_Integers<int64_t>    (encoded, size, count, values);
+        case 256*'u' + 1: return Decode_Integers<uint8_t>    (encoded, size, count, values);
+        case 256*'u' + 2: return Decode_Integers<uint16_t>   (encoded, size, count, values);
+        case 256*'u' + 4: return Decode_Integers<uint32_t>   (encoded, size, count, values);
+        case 256*'u' + 8: return Decode_Integers<uint64_t>   (encoded, size, count, values);
+        case 256*'c' + 1: return Decode_Integers<char>       (encoded, size, count, values);
+    }
+    return false;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,44 @@
+#ifndef INC_IO_GORILLA_hpp
+#define INC_IO_GORILLA_hpp
+
+#include <vector>
+#include <cstddef> // size_t
+
+// **************************************************************
+// Time-series encoding of "Gorilla" (Pelkonen et al., VLDB 2015), for
+// values that change slowly from one row to the next. Each chunk is
+// encoded on its own, the first value as is:
+//
+//  Floating point ('f', 4 or 8 bytes): a first byte tells which of
+//      two encodings was the smaller for this chunk.
+//      0: XOR with the previous value, bit-packed: '0' if identical;
+//      '10' + the meaningful bits if they fit in the previous window
+//      of leading/trailing zeros; '11' + 5 bits of leading zeros + 6
+//      bits of length (0 for 64) + the meaningful bits otherwise.
+//      1: for regularly spaced values (time, positions on a grid),
+//      delta-of-delta of the bit patterns taken as integers, as the
+//      paper's timestamps: '0' if zero, then '10', '110' or '1110' +
+//      7, 9 or 12 bits of the zigzagged value, '1111' + all of them.
+//      Rounding makes it 0 or +-1 ulp: about 5 bits per row.
+//  Integers ('i', 'u', 'c'): delta-of-delta (first value, first
+//      delta, then change of delta), each a zigzag varint. Steps,
+//      counters and integer timestamps take one byte per row.
+//
+// Bits are packed most significant first, so encoded chunks don't
+// depend on the host's byte order.
+
+// First byte of floating point chunks
+#define IO_GORILLA_FLOAT_XOR    0
+#define IO_GORILLA_FLOAT_STEPS  1
+
+bool IO_Gorilla_Is_Supported(const char kind, const size_t element_size);
+void IO_Gorilla_Encode(const char kind, const size_t element_size,
+                       const char *values, const size_t count,
+                       std::vector<char> &encoded);
+bool IO_Gorilla_Decode(const char kind, const size_t element_size,
+                       const char *encoded, const size_t size,
+                       const size_t count, char *values);
+
+#endif // INC_IO_GORILLA_hpp
+
+// ********** End of file ***************************************
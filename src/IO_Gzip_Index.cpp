@@ -0,0 +1,301 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memset()
+#include <cerrno>
+#include <algorithm> // std::min(), std::upper_bound()
+#include <sys/stat.h>
+
+#ifdef COMPRESS_OUTPUT
+#include <zlib.h>
+#endif // #ifdef COMPRESS_OUTPUT
+
+#include <StdCout.hpp>
+
+#include "IO_Gzip_Index.hpp"
+#include "IO_Reader.hpp"
+#include "IO_Text_Parser.hpp"
+
+// **************************************************************
+static bool Parse_Offset(const char *&p, const char *end, uint64_t &value)
+{
+    while (p < end && *p == ' ')
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = 10*value + uint64_t(*p++ - '0');
+    return true;
+}
+
+// **************************************************************
+static bool Is_Before_Offset(const uint64_t offset, const IO_Gzip_Index_Entry &entry)
+{
+    return (offset < entry.uncompressed_offset);
+}
+
+// **************************************************************
+static bool Is_Before_Time(const IO_Gzip_Index_Entry &entry, const double time)
+{
+    return (entry.time < time);
+}
+
+// **************************************************************
+bool IO_Gzip_Index::Load(const std::string &index_filename)
+/**
+ * @return false if there is no index file
+ */
+{
+    entries.clear();
+
+    struct stat status;
+    if (stat(index_filename.c_str(), &status) != 0)
+        return false;
+    if (status.st_size == 0)
+        return true;
+
+    IO_Reader reader(index_filename);
+    IO_Span line;
+    while (reader.Next_Line(line))
+    {
+        if (line.Empty() || line[0] == '#')
+            continue;
+
+        IO_Gzip_Index_Entry entry;
+        const char *p   = line.data;
+        const char *end = line.data + line.size;
+        if (!Parse_Offset(p, end, entry.uncompressed_offset) || !Parse_Offset(p, end, entry.compressed_offset))
+        {
+            std_cout << "ERROR: Invalid line in gzip index '" << index_filename << "': '" << line.String() << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        while (p < end && *p == ' ')
+            p++;
+        entry.time = IO_Parse_Double(p, end);
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+// **************************************************************
+int IO_Gzip_Index::Find_Offset(const uint64_t uncompressed_offset) const
+/**
+ * @return last restart point at or before the offset, -1 if none
+ */
+{
+    const std::vector<IO_Gzip_Index_Entry>::const_iterator after =
+        std::upper_bound(entries.begin(), entries.end(), uncompressed_offset, Is_Before_Offset);
+    return int(after - entries.begin()) - 1;
+}
+
+// **************************************************************
+int IO_Gzip_Index::Find_Time(const double time) const
+/**
+ * Writes at "time" can't be before the last restart point with an
+ * earlier time (times don't decrease), but can be before the first
+ * one at "time" if it was emitted in the middle of the time step.
+ * @return last restart point strictly before "time", or the first one
+ */
+{
+    const std::vector<IO_Gzip_Index_Entry>::const_iterator first =
+        std::lower_bound(entries.begin(), entries.end(), time, Is_Before_Time);
+    const int i = int(first - entries.begin()) - 1;
+    return (i < 0 ? (entries.empty() ? -1 : 0) : i);
+}
+
+#ifdef COMPRESS_OUTPUT
+// **************************************************************
+IO_Gzip_Index_Writer::IO_Gzip_Index_Writer()
+{
+    fh              = NULL;
+    stream          = NULL;
+    interval        = IO_GZIP_INDEX_DEFAULT_INTERVAL;
+    uncompressed    = 0;
+    compressed      = 0;
+    last_restart    = 0;
+    flushed         = 0;
+    has_restart     = false;
+    time            = 0.0;
+}
+
+// **************************************************************
+IO_Gzip_Index_Writer::~IO_Gzip_Index_Writer()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Gzip_Index_Writer::Open(const std::string &_filename, const std::string &_index_filename,
+                                const bool append, const int level, const size_t _interval)
+/**
+ * When appending, a new gzip member is started after the existing
+ * ones; the uncompressed size of the file is found by inflating from
+ * its last restart point.
+ */
+{
+    assert(fh == NULL);
+    assert(_interval > 0);
+
+    filename        = _filename;
+    index_filename  = _index_filename;
+    interval        = _interval;
+    uncompressed    = 0;
+    compressed      = 0;
+    last_restart    = 0;
+    flushed         = 0;
+    has_restart     = false;
+    time            = 0.0;
+
+    struct stat status;
+    const bool existing = (append && stat(filename.c_str(), &status) == 0 && status.st_size > 0);
+    if (existing)
+    {
+        IO_Gzip_Index index;
+        if (!index.Load(index_filename))
+        {
+            std_cout << "ERROR: Can't append to file '" << filename << "' in 'index' mode: index '" << index_filename << "' not found. Aborting.\n" << std::flush;
+            abort();
+        }
+        const uint64_t last = (index.Empty() ? 0 : index[index.Size()-1].uncompressed_offset);
+
+        IO_Reader reader(filename);
+        IO_Span rest;
+        reader.Seek_Offset(last);
+        reader.Read_All(rest);
+        uncompressed = last + rest.size;
+        flushed      = uncompressed;
+        compressed   = uint64_t(status.st_size);
+    }
+
+    fh = fopen(filename.c_str(), (append ? "ab" : "wb"));
+    if (fh == NULL)
+        return false;
+
+    index_fh.open(index_filename.c_str(), (existing ? std::ios_base::out | std::ios_base::app : std::ios_base::out));
+    if (!index_fh.is_open())
+    {
+        std_cout << "ERROR: Could not open gzip index '" << index_filename << "' for writing. Aborting.\n" << std::flush;
+        abort();
+    }
+    index_fh.precision(17);
+    if (!existing)
+        index_fh << "# Restart points of '" << filename << "': uncompressed_offset compressed_offset time\n";
+
+    z_stream *z = new z_stream;
+    memset(z, 0, sizeof(z_stream));
+    // windowBits of 15+16 asks zlib for a gzip header and trailer.
+    if (deflateInit2(z, (level == IO_CODEC_DEFAULT_LEVEL ? Z_DEFAULT_COMPRESSION : level), Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        std_cout << "ERROR: deflateInit2() failed for file '" << filename << "' (level " << level << "). Aborting.\n" << std::flush;
+        abort();
+    }
+    stream = (void *) z;
+    out.resize(256*1024);
+
+    return true;
+}
+
+// **************************************************************
+void IO_Gzip_Index_Writer::Deflate(const char *p, size_t size, const int flush)
+{
+    z_stream *z = (z_stream *) stream;
+
+    do
+    {
+        // avail_in is an uInt
+        const size_t n_in = std::min(size, size_t(1) << 30);
+        z->next_in  = (Bytef *) p;
+        z->avail_in = uInt(n_in);
+        p    += n_in;
+        size -= n_in;
+
+        do
+        {
+            z->next_out  = (Bytef *) &out[0];
+            z->avail_out = uInt(out.size());
+            if (deflate(z, (size == 0 ? flush : Z_NO_FLUSH)) == Z_STREAM_ERROR)
+            {
+                std_cout << "ERROR: deflate() failed for file '" << filename << "'. Aborting.\n" << std::flush;
+                abort();
+            }
+            const size_t n_out = out.size() - z->avail_out;
+            if (n_out > 0 && fwrite(&out[0], 1, n_out, fh) != n_out)
+            {
+                std_cout << "ERROR: Could not write to file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+                abort();
+            }
+            compressed += n_out;
+        } while (z->avail_out == 0);
+    } while (size > 0);
+}
+
+// **************************************************************
+void IO_Gzip_Index_Writer::Restart()
+/**
+ * Full flush: everything received is written out and the next deflate
+ * block starts at a byte boundary without references to earlier data.
+ */
+{
+    Deflate(NULL, 0, Z_FULL_FLUSH);
+    last_restart = uncompressed;
+    flushed      = uncompressed;
+    has_restart  = true;
+    index_fh << uncompressed << ' ' << compressed << ' ' << time << '\n';
+}
+
+// **************************************************************
+void IO_Gzip_Index_Writer::Write(const char *p, const size_t size)
+{
+    assert(fh != NULL);
+
+    if (!has_restart || uncompressed - last_restart >= interval)
+        Restart();
+
+    Deflate(p, size, Z_NO_FLUSH);
+    uncompressed += size;
+}
+
+// **************************************************************
+void IO_Gzip_Index_Writer::Flush()
+/**
+ * Everything received is pushed out of zlib (sync flush, which keeps
+ * the dictionary, so frequent flushes barely change the ratio).
+ */
+{
+    if (fh == NULL)
+        return;
+
+    if (uncompressed > flushed)
+    {
+        Deflate(NULL, 0, Z_SYNC_FLUSH);
+        flushed = uncompressed;
+    }
+
+    fflush(fh);
+    index_fh.flush();
+}
+
+// **************************************************************
+void IO_Gzip_Index_Writer::Close()
+{
+    if (fh == NULL)
+        return;
+
+    Deflate(NULL, 0, Z_FINISH);
+    deflateEnd((z_stream *) stream);
+    delete (z_stream *) stream;
+    stream = NULL;
+    out.clear();
+
+    if (fclose(fh) != 0)
+    {
+        std_cout << "ERROR: Could not close file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    fh = NULL;
+    index_fh.close();
+}
+#endif // #ifdef COMPRESS_OUTPUT
+
+// ********** End of file ***************************************
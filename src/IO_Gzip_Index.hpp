@@ -0,0 +1,116 @@
+#ifndef INC_IO_GZIP_INDEX_hpp
+#define INC_IO_GZIP_INDEX_hpp
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+#include "IO_Codec.hpp"
+
+// Default number of uncompressed bytes between restart points
+#define IO_GZIP_INDEX_DEFAULT_INTERVAL  (1024*1024)
+
+// The index of "file.txt.gz" is "file.txt.gz.idx"
+#define IO_GZIP_INDEX_EXTENSION         ".idx"
+
+// **************************************************************
+struct IO_Gzip_Index_Entry
+/**
+ * Restart point: inflating can start at "compressed_offset" (raw
+ * deflate, no dictionary needed), which holds the uncompressed byte at
+ * "uncompressed_offset", written at simulation time "time".
+ */
+{
+    uint64_t uncompressed_offset;
+    uint64_t compressed_offset;
+    double   time;
+};
+
+// **************************************************************
+class IO_Gzip_Index
+/**
+ * Restart points of a gzip file written in "index" mode, loaded from
+ * its sidecar text file (one "uncompressed compressed time" line per
+ * restart point).
+ */
+{
+    private:
+        std::vector<IO_Gzip_Index_Entry> entries;
+
+    public:
+        bool Load(const std::string &index_filename);
+
+        int Find_Offset(const uint64_t uncompressed_offset) const;
+        int Find_Time(const double time) const;
+
+        inline bool Empty() const                               { return entries.empty();   }
+        inline size_t Size() const                              { return entries.size();    }
+        inline const IO_Gzip_Index_Entry & operator[](const size_t i) const { return entries[i]; }
+};
+
+#ifdef COMPRESS_OUTPUT
+// **************************************************************
+class IO_Gzip_Index_Writer : public IO_Sink
+/**
+ * Seekable gzip output ("index" mode option).
+ *
+ * Data is deflated as a single gzip member. Every "interval"
+ * uncompressed bytes, at the start of the next Write() (so a record is
+ * never split), the compressor emits a full flush point: the
+ * dictionary is reset and the output is byte aligned, so inflating can
+ * restart there. Each restart point is appended to the sidecar index
+ * with the time given to Set_Time().
+ *
+ * Flush() is a sync flush instead of gzflush(Z_FINISH): the member and
+ * the dictionary go on, so flushing often costs a few bytes per call
+ * instead of the ratio. The file stays a regular gzip file.
+ * IO_Reader::Seek_Time() and Seek_Offset() use the index.
+ */
+{
+    private:
+        std::string filename;
+        std::string index_filename;
+        FILE *fh;
+        std::ofstream index_fh;
+        void *stream;                   // z_stream (zlib.h is only included by the .cpp)
+        std::vector<char> out;          // Deflated bytes, before fwrite()
+
+        size_t interval;
+        uint64_t uncompressed;          // Bytes received
+        uint64_t compressed;            // Bytes written to the file
+        uint64_t last_restart;          // Uncompressed offset of the last restart point
+        uint64_t flushed;               // Uncompressed bytes pushed out by Flush() or Restart()
+        bool has_restart;               // At least one restart point in this member
+        double time;
+
+        void Deflate(const char *p, size_t size, const int flush);
+        void Restart();
+
+    public:
+        IO_Gzip_Index_Writer();
+        ~IO_Gzip_Index_Writer();
+        bool Open(const std::string &_filename, const std::string &_index_filename,
+                  const bool append, const int level = IO_CODEC_DEFAULT_LEVEL,
+                  const size_t _interval = IO_GZIP_INDEX_DEFAULT_INTERVAL);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        inline void Set_Time(const double _time)    { time = _time;         }
+        inline uint64_t Get_Uncompressed_Size()     { return uncompressed;  }
+        inline uint64_t Get_Compressed_Size()       { return compressed;    }
+};
+#endif // #ifdef COMPRESS_OUTPUT
+
+#endif // INC_IO_GZIP_INDEX_hpp
+
+// ********** End of file ***************************************
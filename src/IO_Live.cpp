@@ -0,0 +1,598 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy(), memset(), strerror()
+#include <cerrno>
+#include <fcntl.h>  // open(), fcntl()
+#include <unistd.h> // read(), close(), unlink()
+#include <signal.h> // pthread_sigmask(), sigtimedwait()
+#include <poll.h>   // poll()
+#include <time.h>   // nanosleep()
+#include <sys/socket.h>
+#include <sys/un.h> // sockaddr_un
+#include <sys/uio.h> // writev()
+#include <sys/stat.h> // mkfifo(), lstat()
+
+#include <StdCout.hpp>
+
+#include "IO_Live.hpp"
+#include "IO_Stats.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif // #ifndef MSG_NOSIGNAL
+
+// **************************************************************
+static void Put_Little_Endian(char *p, uint64_t value, const int nb_bytes)
+{
+    for (int i = 0 ; i < nb_bytes ; i++)
+    {
+        p[i] = char(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+// **************************************************************
+static uint64_t Get_Little_Endian(const char *p, const int nb_bytes)
+{
+    uint64_t value = 0;
+    for (int i = nb_bytes - 1 ; i >= 0 ; i--)
+        value = (value << 8) | uint64_t((unsigned char) p[i]);
+    return value;
+}
+
+// **************************************************************
+static ssize_t Send_Vector(const int fd, const bool is_fifo, iovec *vector, const int nb_vectors)
+/**
+ * Non-blocking write that never raises SIGPIPE. Pipes have no
+ * MSG_NOSIGNAL: SIGPIPE is blocked around the write and, if the write
+ * raised it, consumed.
+ */
+{
+    if (!is_fifo)
+    {
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov     = vector;
+        message.msg_iovlen  = nb_vectors;
+        return sendmsg(fd, &message, MSG_NOSIGNAL);
+    }
+
+    sigset_t sigpipe, previous, pending;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &previous);
+    sigpending(&pending);
+    const bool was_pending = (sigismember(&pending, SIGPIPE) == 1);
+
+    const ssize_t written = writev(fd, vector, nb_vectors);
+    const int error = errno;
+    if (written < 0 && error == EPIPE && !was_pending)
+    {
+        timespec no_wait = {0, 0};
+        sigtimedwait(&sigpipe, NULL, &no_wait);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    errno = error;
+    return written;
+}
+
+// **************************************************************
+IO_Live_Writer::IO_Live_Writer()
+{
+    is_open         = false;
+    is_fifo         = false;
+    text            = true;
+    backlog         = IO_LIVE_DEFAULT_BACKLOG;
+    listen_fd       = -1;
+    last_accept     = 0.0;
+    time            = 0.0;
+    sequence        = 0;
+    nb_dropped      = 0;
+    nb_subscribed   = 0;
+    bytes_sent      = 0;
+}
+
+// **************************************************************
+IO_Live_Writer::~IO_Live_Writer()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Live_Writer::Open(const std::string &_filename, const bool _is_fifo, const bool _text,
+                          const size_t _backlog)
+/**
+ * Create the socket (replacing a stale one) or the named pipe.
+ * Nobody has to be listening yet.
+ */
+{
+    filename    = _filename;
+    is_fifo     = _is_fifo;
+    text        = _text;
+    backlog     = _backlog;
+    last_accept = 0.0;
+    time        = 0.0;
+    sequence    = 0;
+    nb_dropped  = 0;
+
+    struct stat existing;
+    const bool exists = (lstat(filename.c_str(), &existing) == 0);
+
+    if (is_fifo)
+    {
+        if (exists && !S_ISFIFO(existing.st_mode))
+        {
+            std_cout << "ERROR: '" << filename << "' exists and is not a named pipe.\n" << std::flush;
+            return false;
+        }
+        if (!exists && mkfifo(filename.c_str(), 0644) != 0)
+        {
+            std_cout << "ERROR: Could not create named pipe '" << filename << "': " << strerror(errno) << ".\n" << std::flush;
+            return false;
+        }
+        is_open = true;
+        return true;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (filename.size() >= sizeof(address.sun_path))
+    {
+        std_cout << "ERROR: Socket name '" << filename << "' is longer than " << sizeof(address.sun_path) - 1 << " characters.\n" << std::flush;
+        return false;
+    }
+    strcpy(address.sun_path, filename.c_str());
+
+    if (exists && !S_ISSOCK(existing.st_mode))
+    {
+        std_cout << "ERROR: '" << filename << "' exists and is not a socket.\n" << std::flush;
+        return false;
+    }
+    if (exists)
+        unlink(filename.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1
+        || fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK) != 0
+        || bind(listen_fd, (sockaddr *) &address, sizeof(address)) != 0
+        || listen(listen_fd, 16) != 0)
+    {
+        std_cout << "ERROR: Could not listen on socket '" << filename << "': " << strerror(errno) << ".\n" << std::flush;
+        if (listen_fd != -1)
+            close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    is_open = true;
+    return true;
+}
+
+// **************************************************************
+void IO_Live_Writer::Frame(const char type, char *header, const size_t size)
+{
+    assert(size <= 0xFFFFFFFFul);
+
+    uint64_t time_bits;
+    memcpy(&time_bits, &time, sizeof(time_bits));
+
+    Put_Little_Endian(header, uint64_t(size), 4);
+    header[4] = type;
+    header[5] = char(IO_LIVE_VERSION);
+    header[6] = char(text ? 1 : 0);
+    header[7] = 0;
+    Put_Little_Endian(header + 8, sequence, 8);
+    Put_Little_Endian(header + 16, time_bits, 8);
+}
+
+// **************************************************************
+void IO_Live_Writer::Accept()
+/**
+ * Take new subscribers, at most every IO_LIVE_ACCEPT_INTERVAL seconds.
+ * Each gets a hello frame first.
+ */
+{
+    const double now = IO_Wall_Time();
+    if (now - last_accept < IO_LIVE_ACCEPT_INTERVAL)
+        return;
+    last_accept = now;
+
+    while (true)
+    {
+        int fd = -1;
+        if (is_fifo)
+        {
+            // Fails (ENXIO) while nobody has the pipe open for reading.
+            if (subscribers.empty())
+                fd = open(filename.c_str(), O_WRONLY | O_NONBLOCK);
+        }
+        else
+        {
+            fd = accept(listen_fd, NULL, NULL);
+            if (fd != -1)
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+        if (fd == -1)
+            return;
+
+        Subscriber subscriber;
+        subscriber.fd   = fd;
+        subscriber.sent = 0;
+        subscribers.push_back(subscriber);
+        nb_subscribed++;
+
+        char header[IO_LIVE_FRAME_HEADER_SIZE];
+        Frame('H', header, filename.size());
+        if (!Send(subscribers.back(), header, filename.data(), filename.size()))
+            Disconnect(subscribers.size() - 1);
+    }
+}
+
+// **************************************************************
+bool IO_Live_Writer::Drain(Subscriber &subscriber)
+/**
+ * Send what is queued, as much as possible without blocking.
+ * @return  false if the subscriber is gone
+ */
+{
+    while (subscriber.sent < subscriber.pending.size())
+    {
+        iovec vector;
+        vector.iov_base = &subscriber.pending[subscriber.sent];
+        vector.iov_len  = subscriber.pending.size() - subscriber.sent;
+        const ssize_t written = Send_Vector(subscriber.fd, is_fifo, &vector, 1);
+        if (written < 0 && (errno == EAGAIN || errno == EINTR))
+            return true;
+#if EAGAIN != EWOULDBLOCK
+        if (written < 0 && errno == EWOULDBLOCK)
+            return true;
+#endif // #if EAGAIN != EWOULDBLOCK
+        if (written <= 0)
+            return false;
+        subscriber.sent += size_t(written);
+        bytes_sent      += uint64_t(written);
+    }
+    subscriber.pending.clear();
+    subscriber.sent = 0;
+    return true;
+}
+
+// **************************************************************
+bool IO_Live_Writer::Send(Subscriber &subscriber, const char *header, const char *p, const size_t size)
+/**
+ * Send a frame, or queue it, or drop it: frames are never cut.
+ * @return  false if the subscriber is gone
+ */
+{
+    if (!Drain(subscriber))
+        return false;
+
+    const size_t frame_size = IO_LIVE_FRAME_HEADER_SIZE + size;
+    size_t written = 0;
+    if (subscriber.pending.empty())
+    {
+        iovec vectors[2];
+        vectors[0].iov_base = (void *) header;
+        vectors[0].iov_len  = IO_LIVE_FRAME_HEADER_SIZE;
+        vectors[1].iov_base = (void *) p;
+        vectors[1].iov_len  = size;
+        const ssize_t result = Send_Vector(subscriber.fd, is_fifo, vectors, 2);
+#if EAGAIN != EWOULDBLOCK
+        if (result < 0 && errno == EWOULDBLOCK)
+            errno = EAGAIN;
+#endif // #if EAGAIN != EWOULDBLOCK
+        if (result < 0 && errno != EAGAIN && errno != EINTR)
+            return false;
+        written = (result > 0 ? size_t(result) : 0);
+        bytes_sent += uint64_t(written);
+        if (written == frame_size)
+            return true;
+    }
+
+    // A frame started has to be finished, whatever the backlog.
+    const size_t queued = subscriber.pending.size() - subscriber.sent;
+    if (written == 0 && queued + frame_size > backlog)
+    {
+        nb_dropped++;
+        return true;
+    }
+
+    subscriber.pending.erase(subscriber.pending.begin(), subscriber.pending.begin() + subscriber.sent);
+    subscriber.sent = 0;
+    for (size_t i = written ; i < frame_size ; )
+    {
+        const char *source = (i < IO_LIVE_FRAME_HEADER_SIZE ? header + i : p + (i - IO_LIVE_FRAME_HEADER_SIZE));
+        const size_t length = (i < IO_LIVE_FRAME_HEADER_SIZE ? IO_LIVE_FRAME_HEADER_SIZE - i : frame_size - i);
+        subscriber.pending.insert(subscriber.pending.end(), source, source + length);
+        i += length;
+    }
+    return true;
+}
+
+// **************************************************************
+void IO_Live_Writer::Disconnect(const size_t i)
+{
+    close(subscribers[i].fd);
+    subscribers.erase(subscribers.begin() + i);
+}
+
+// **************************************************************
+void IO_Live_Writer::Write(const char *p, const size_t size)
+/**
+ * Without subscribers, a write costs a clock read.
+ */
+{
+    // Hello frames carry the last sequence number sent before joining.
+    Accept();
+    sequence++;
+    if (subscribers.empty())
+        return;
+
+    char header[IO_LIVE_FRAME_HEADER_SIZE];
+    Frame('D', header, size);
+    for (size_t i = subscribers.size() ; i-- > 0 ; )
+    {
+        if (!Send(subscribers[i], header, p, size))
+            Disconnect(i);
+    }
+}
+
+// **************************************************************
+void IO_Live_Writer::Set_Time(const double _time)
+/**
+ * Called every step: subscribers are welcomed even between writes.
+ */
+{
+    time = _time;
+    if (is_open)
+        Accept();
+}
+
+// **************************************************************
+void IO_Live_Writer::Flush()
+/**
+ * Send what is queued, without waiting for slow subscribers.
+ */
+{
+    if (!is_open)
+        return;
+
+    Accept();
+    for (size_t i = subscribers.size() ; i-- > 0 ; )
+    {
+        if (!Drain(subscribers[i]))
+            Disconnect(i);
+    }
+}
+
+// **************************************************************
+void IO_Live_Writer::Close()
+/**
+ * Subscribers still behind after IO_LIVE_CLOSE_TIMEOUT seconds lose
+ * the rest, end frame included.
+ */
+{
+    if (!is_open)
+        return;
+
+    char header[IO_LIVE_FRAME_HEADER_SIZE];
+    Frame('E', header, 0);
+    for (size_t i = subscribers.size() ; i-- > 0 ; )
+    {
+        if (!Send(subscribers[i], header, NULL, 0))
+            Disconnect(i);
+    }
+
+    const double start = IO_Wall_Time();
+    while (!subscribers.empty() && IO_Wall_Time() - start < IO_LIVE_CLOSE_TIMEOUT)
+    {
+        std::vector<pollfd> writable(subscribers.size());
+        for (size_t i = 0 ; i < subscribers.size() ; i++)
+        {
+            writable[i].fd      = subscribers[i].fd;
+            writable[i].events  = POLLOUT;
+            writable[i].revents = 0;
+        }
+        poll(&writable[0], nfds_t(writable.size()), 10);
+        for (size_t i = subscribers.size() ; i-- > 0 ; )
+        {
+            if (!Drain(subscribers[i]) || subscribers[i].pending.empty())
+                Disconnect(i);
+        }
+    }
+    for (size_t i = subscribers.size() ; i-- > 0 ; )
+        Disconnect(i);
+
+    if (listen_fd != -1)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(filename.c_str());
+    }
+    is_open = false;
+}
+
+// **************************************************************
+void IO_Live_Writer::Print()
+{
+    std_cout
+        << "Live output '" << filename << "' (" << (is_fifo ? "named pipe" : "socket") << "):\n"
+        << "    records:         " << sequence << "\n"
+        << "    subscribers:     " << subscribers.size() << " (" << nb_subscribed << " so far)\n"
+        << "    bytes sent:      " << bytes_sent << "\n"
+        << "    frames dropped:  " << nb_dropped << "\n";
+}
+
+// **************************************************************
+IO_Live_Reader::IO_Live_Reader()
+{
+    fd          = -1;
+    text        = true;
+    sequence    = 0;
+    nb_missed   = 0;
+    has_record  = false;
+    time        = 0.0;
+}
+
+// **************************************************************
+IO_Live_Reader::IO_Live_Reader(const std::string &path, const double timeout)
+{
+    fd          = -1;
+    text        = true;
+    sequence    = 0;
+    nb_missed   = 0;
+    has_record  = false;
+    time        = 0.0;
+
+    if (!Open(path, timeout))
+    {
+        std_cout << "ERROR: Could not subscribe to live output '" << path << "' within " << timeout << " s. Aborting.\n" << std::flush;
+        abort();
+    }
+}
+
+// **************************************************************
+IO_Live_Reader::~IO_Live_Reader()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Live_Reader::Open(const std::string &path, const double timeout)
+/**
+ * @return  false if no writer said hello within "timeout" seconds
+ */
+{
+    Close();
+    nb_missed   = 0;
+    has_record  = false;
+
+    const double start = IO_Wall_Time();
+    while (fd == -1)
+    {
+        struct stat existing;
+        if (stat(path.c_str(), &existing) == 0 && S_ISFIFO(existing.st_mode))
+        {
+            // Non-blocking, so that the writer's next check finds us.
+            fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        }
+        else if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+        {
+            sockaddr_un address;
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd != -1 && connect(fd, (sockaddr *) &address, sizeof(address)) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        if (fd != -1)
+            break;
+
+        if (timeout >= 0.0 && IO_Wall_Time() - start > timeout)
+            return false;
+        timespec duration = {0, 50000000};
+        nanosleep(&duration, NULL);
+    }
+
+    // The hello frame comes once the writer noticed us.
+    pollfd waiting;
+    waiting.fd      = fd;
+    waiting.events  = POLLIN;
+    const double left = (timeout < 0.0 ? -1.0 : timeout - (IO_Wall_Time() - start));
+    if (left >= 0.0 ? poll(&waiting, 1, int(1000.0 * left)) <= 0 : poll(&waiting, 1, -1) <= 0)
+    {
+        Close();
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    char header[IO_LIVE_FRAME_HEADER_SIZE];
+    if (!Read_Full(header, IO_LIVE_FRAME_HEADER_SIZE) || header[4] != 'H')
+    {
+        Close();
+        return false;
+    }
+    name.resize(size_t(Get_Little_Endian(header, 4)));
+    if (!name.empty() && !Read_Full(&name[0], name.size()))
+    {
+        Close();
+        return false;
+    }
+    text        = (header[6] & 1) != 0;
+    sequence    = Get_Little_Endian(header + 8, 8);
+    has_record  = true;
+
+    return true;
+}
+
+// **************************************************************
+bool IO_Live_Reader::Read_Full(char *p, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t nb_read = read(fd, p, size);
+        if (nb_read < 0 && errno == EINTR)
+            continue;
+        if (nb_read <= 0)
+            return false;
+        p    += nb_read;
+        size -= size_t(nb_read);
+    }
+    return true;
+}
+
+// **************************************************************
+bool IO_Live_Reader::Next()
+{
+    if (fd == -1)
+        return false;
+
+    while (true)
+    {
+        char header[IO_LIVE_FRAME_HEADER_SIZE];
+        if (!Read_Full(header, IO_LIVE_FRAME_HEADER_SIZE))
+            return false;
+        if (header[5] != char(IO_LIVE_VERSION))
+        {
+            std_cout << "ERROR: Live output '" << name << "' uses protocol version " << int(header[5]) << ", not " << IO_LIVE_VERSION << ". Aborting.\n" << std::flush;
+            abort();
+        }
+
+        // Hello and end frames leave the last record alone.
+        std::string other;
+        std::string &payload = (header[4] == 'D' ? record : other);
+        payload.resize(size_t(Get_Little_Endian(header, 4)));
+        if (!payload.empty() && !Read_Full(&payload[0], payload.size()))
+            return false;
+
+        if (header[4] == 'E')
+            return false;
+        if (header[4] != 'D')
+            continue;
+
+        const uint64_t frame_sequence = Get_Little_Endian(header + 8, 8);
+        if (has_record && frame_sequence > sequence + 1)
+            nb_missed += frame_sequence - sequence - 1;
+        sequence    = frame_sequence;
+        has_record  = true;
+
+        const uint64_t time_bits = Get_Little_Endian(header + 16, 8);
+        memcpy(&time, &time_bits, sizeof(time));
+        return true;
+    }
+}
+
+// **************************************************************
+void IO_Live_Reader::Close()
+{
+    if (fd != -1)
+        close(fd);
+    fd = -1;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,152 @@
+#ifndef INC_IO_LIVE_hpp
+#define INC_IO_LIVE_hpp
+
+#include <string>
+#include <vector>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+
+// Bytes queued per subscriber before records are dropped for it
+#define IO_LIVE_DEFAULT_BACKLOG (1024*1024)
+// How often new subscribers are looked for (seconds)
+#define IO_LIVE_ACCEPT_INTERVAL 0.1
+// How long Close() waits for subscribers to take what is queued (seconds)
+#define IO_LIVE_CLOSE_TIMEOUT 1.0
+
+// **************************************************************
+// Frame, all integers little-endian:
+//      [0-3]   payload size (uint32)
+//      [4]     type: 'H' (hello, payload: the IO's file name),
+//              'D' (data, payload: one IO write) or 'E' (end)
+//      [5]     version (1)
+//      [6]     flags: 1 if the records are text
+//      [7]     0
+//      [8-15]  sequence number of the write (uint64), gaps are drops
+//      [16-23] simulation time (IEEE double, IO::Set_Time())
+//      [24-]   payload
+#define IO_LIVE_FRAME_HEADER_SIZE   24
+#define IO_LIVE_VERSION             1
+
+class IO_Live_Writer : public IO_Sink
+/**
+ * Live output ("socket" or "fifo" mode options): each write is sent as
+ * a frame to the subscribers, instead of being written to a file.
+ *
+ * With "socket", the file name is a UNIX stream socket listened on;
+ * any number of subscribers connect and get the frames written after
+ * they did, starting with a hello frame. With "fifo", the file name
+ * is a named pipe (created if needed), written to while a reader has
+ * it open.
+ *
+ * New subscribers are taken by Write(), Flush() and Set_Time(), at
+ * most every IO_LIVE_ACCEPT_INTERVAL seconds: a subscriber connecting
+ * while nothing is written waits for the next of these calls for its
+ * hello frame.
+ *
+ * Sends never block. What a subscriber can't take at once is queued,
+ * up to "backlog" bytes; beyond, whole frames are dropped for that
+ * subscriber only. Subscribers that leave are forgotten. Close() sends
+ * an end frame, waiting at most IO_LIVE_CLOSE_TIMEOUT seconds for
+ * subscribers to take what is queued, and removes the socket.
+ */
+{
+    private:
+        struct Subscriber
+        {
+            int fd;
+            std::vector<char> pending;  // Frames not sent yet
+            size_t sent;                // Of "pending"
+        };
+
+        std::string filename;
+        bool is_open;
+        bool is_fifo;
+        bool text;
+        size_t backlog;
+        int listen_fd;                  // Socket only
+        std::vector<Subscriber> subscribers;
+        double last_accept;
+        double time;
+
+        uint64_t sequence;
+        uint64_t nb_dropped;            // Frames, over all subscribers
+        uint64_t nb_subscribed;
+        uint64_t bytes_sent;
+
+        void Accept();
+        bool Send(Subscriber &subscriber, const char *header, const char *p, const size_t size);
+        bool Drain(Subscriber &subscriber);
+        void Frame(const char type, char *header, const size_t size);
+        void Disconnect(const size_t i);
+
+    public:
+        IO_Live_Writer();
+        ~IO_Live_Writer();
+        bool Open(const std::string &_filename, const bool _is_fifo, const bool _text,
+                  const size_t _backlog = IO_LIVE_DEFAULT_BACKLOG);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        void Set_Time(const double _time);
+        inline int64_t  Get_Physical_Bytes()            { return IO_SINK_NOT_STORED;    }
+        inline size_t   Get_Nb_Subscribers()            { return subscribers.size();    }
+        inline uint64_t Get_Nb_Records()                { return sequence;              }
+        inline uint64_t Get_Nb_Dropped()                { return nb_dropped;            }
+        void Print();
+};
+
+class IO_Live_Reader
+/**
+ * Subscriber of an IO_Live_Writer, e.g. a monitoring dashboard:
+ *
+ *      IO_Live_Reader live("output/diagnostics.txt");
+ *      while (live.Next())
+ *          std::cout << live.Get_Time() << ": " << live.Get_Record();
+ *
+ * Open() connects to the socket, or opens the named pipe, waiting up
+ * to "timeout" seconds (negative: forever) for the writer. Next()
+ * blocks until the next record and returns false at the end frame or
+ * when the writer is gone.
+ */
+{
+    private:
+        int fd;
+        std::string name;               // Writer's file name (hello frame)
+        bool text;
+        std::string record;
+        uint64_t sequence;
+        uint64_t nb_missed;             // Dropped by the writer for us
+        bool has_record;
+        double time;
+
+        bool Read_Full(char *p, size_t size);
+
+    public:
+        IO_Live_Reader();
+        IO_Live_Reader(const std::string &path, const double timeout = -1.0);
+        ~IO_Live_Reader();
+
+        bool Open(const std::string &path, const double timeout = -1.0);
+        bool Next();
+        void Close();
+
+        inline const std::string &  Get_Record()        { return record;    }
+        inline uint64_t             Get_Sequence()      { return sequence;  }
+        inline uint64_t             Get_Nb_Missed()     { return nb_missed; }
+        inline double               Get_Time()          { return time;      }
+        inline std::string          Get_Name()          { return name;      }
+        inline bool                 Is_Text()           { return text;      }
+};
+
+#endif // INC_IO_LIVE_hpp
+
+// ********** End of file ***************************************
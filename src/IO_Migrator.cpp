@@ -0,0 +1,354 @@
+
+#include <cstdlib>  // abort(), atexit()
+#include <cstdio>   // rename()
+#include <cstring>  // strerror()
+#include <cerrno>
+#include <vector>
+#include <sstream>
+#include <fcntl.h>  // open()
+#include <unistd.h> // read(), write(), fsync(), close(), unlink(), getpid()
+#include <time.h>   // nanosleep()
+
+#include <StdCout.hpp>
+
+#include "InputOutput.hpp"
+#include "IO_Migrator.hpp"
+#include "IO_Stats.hpp"
+
+// Never deleted: files may still be migrated from atexit() functions.
+static IO_Migrator *instance = NULL;
+static pthread_once_t instance_once = PTHREAD_ONCE_INIT;
+
+// **************************************************************
+static void Sleep_Seconds(const double seconds)
+{
+    timespec duration;
+    duration.tv_sec  = time_t(seconds);
+    duration.tv_nsec = long(1.0e9 * (seconds - double(duration.tv_sec)));
+    while (nanosleep(&duration, &duration) != 0 && errno == EINTR)
+        ;
+}
+
+// **************************************************************
+IO_Migrator::IO_Migrator()
+{
+    bandwidth       = 0.0;
+    nb_staged       = 0;
+    nb_landed       = 0;
+    nb_failed       = 0;
+    bytes_landed    = 0;
+    copy_time       = 0.0;
+    quit            = false;
+    exiting         = false;
+    has_thread      = false;
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond_job, NULL);
+    pthread_cond_init(&cond_landed, NULL);
+}
+
+// **************************************************************
+void IO_Migrator::Create_Instance()
+{
+    instance = new IO_Migrator;
+    atexit(IO_Migrator::Wait_At_Exit);
+    pthread_atfork(NULL, NULL, IO_Migrator::Reset_In_Child);
+}
+
+// **************************************************************
+void IO_Migrator::Reset_In_Child()
+/**
+ * The thread is not copied by fork(), and the parent's files are
+ * not the child's to migrate.
+ */
+{
+    pthread_mutex_init(&instance->mutex, NULL);
+    pthread_cond_init(&instance->cond_job, NULL);
+    pthread_cond_init(&instance->cond_landed, NULL);
+    instance->jobs.clear();
+    instance->pending.clear();
+    instance->has_thread = false;
+}
+
+// **************************************************************
+IO_Migrator & IO_Migrator::Instance()
+{
+    pthread_once(&instance_once, IO_Migrator::Create_Instance);
+    return *instance;
+}
+
+// **************************************************************
+void IO_Migrator::Wait_At_Exit()
+/**
+ * Files closed later by other atexit() functions (see IO_Emergency)
+ * are copied by their caller.
+ */
+{
+    instance->Wait();
+
+    pthread_mutex_lock(&instance->mutex);
+    instance->exiting = true;
+    instance->quit    = true;
+    pthread_cond_signal(&instance->cond_job);
+    pthread_mutex_unlock(&instance->mutex);
+
+    if (instance->has_thread)
+        pthread_join(instance->thread, NULL);
+    instance->has_thread = false;
+}
+
+// **************************************************************
+std::string IO_Migrator::Stage(const std::string &folder, const std::string &filename)
+/**
+ * @return  Name under which "filename" must be written: in "folder",
+ *          unique among the processes sharing it
+ */
+{
+    Create_Folder_If_Does_Not_Exists(folder);
+
+    pthread_mutex_lock(&mutex);
+    const uint64_t number = nb_staged++;
+    pthread_mutex_unlock(&mutex);
+
+    const size_t slash = filename.rfind('/');
+    std::ostringstream staged_filename;
+    staged_filename << folder << "/" << getpid() << "." << number << "." << (slash == std::string::npos ? filename : filename.substr(slash+1));
+    return staged_filename.str();
+}
+
+// **************************************************************
+void IO_Migrator::Migrate(const std::string &staged_filename, const std::string &filename)
+/**
+ * Queue a closed file. Returns at once, except during exit().
+ */
+{
+    Job job;
+    job.staged_filename = staged_filename;
+    job.filename        = filename;
+
+    pthread_mutex_lock(&mutex);
+    pending.insert(filename);
+    if (exiting)
+    {
+        const double limit = bandwidth;
+        pthread_mutex_unlock(&mutex);
+        uint64_t bytes = 0;
+        const double start = IO_Wall_Time();
+        const bool success = Copy(job, limit, bytes);
+        pthread_mutex_lock(&mutex);
+        copy_time += IO_Wall_Time() - start;
+        Finish(job, success, bytes);
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    if (!has_thread)
+    {
+        quit = false;
+        if (pthread_create(&thread, NULL, IO_Migrator::Thread_Main, (void *) this) != 0)
+        {
+            std_cout << "ERROR: Could not create migration thread for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        has_thread = true;
+    }
+    jobs.push_back(job);
+    pthread_cond_signal(&cond_job);
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Migrator::Set_Bandwidth(const double bytes_per_second)
+/**
+ * Takes effect at the next file.
+ */
+{
+    assert(bytes_per_second >= 0.0);
+
+    pthread_mutex_lock(&mutex);
+    bandwidth = bytes_per_second;
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+bool IO_Migrator::Is_Landed(const std::string &filename)
+/**
+ * @return  false while "filename" is queued or being copied
+ */
+{
+    pthread_mutex_lock(&mutex);
+    const bool is_landed = (pending.find(filename) == pending.end());
+    pthread_mutex_unlock(&mutex);
+    return is_landed;
+}
+
+// **************************************************************
+void IO_Migrator::Wait(const std::string &filename)
+/**
+ * Block until "filename" has landed, or every file if none is given.
+ */
+{
+    pthread_mutex_lock(&mutex);
+    while (filename == "" ? !pending.empty() : pending.find(filename) != pending.end())
+        pthread_cond_wait(&cond_landed, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+size_t IO_Migrator::Get_Nb_Pending()
+{
+    pthread_mutex_lock(&mutex);
+    const size_t nb_pending = pending.size();
+    pthread_mutex_unlock(&mutex);
+    return nb_pending;
+}
+
+// **************************************************************
+bool IO_Migrator::Copy(const Job &job, const double limit, uint64_t &bytes)
+/**
+ * Copy to "<filename>.tmp", fsync() and rename, pacing the writes to
+ * "limit" bytes per second. The staged file is removed once landed.
+ */
+{
+    const std::string temporary = job.filename + ".tmp";
+    std::string failure;
+
+    const int in = open(job.staged_filename.c_str(), O_RDONLY);
+    const int out = (in == -1 ? -1 : open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (in == -1 or out == -1)
+        failure = strerror(errno);
+
+    std::vector<char> chunk(in == -1 or out == -1 ? 0 : IO_MIGRATOR_CHUNK_SIZE);
+    const double start = IO_Wall_Time();
+    bytes = 0;
+    while (failure == "")
+    {
+        const ssize_t nb_read = read(in, &chunk[0], chunk.size());
+        if (nb_read < 0 && errno == EINTR)
+            continue;
+        if (nb_read < 0)
+            failure = strerror(errno);
+        if (nb_read <= 0)
+            break;
+
+        const char *p = &chunk[0];
+        size_t left = size_t(nb_read);
+        while (left > 0 and failure == "")
+        {
+            const ssize_t written = write(out, p, left);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+            {
+                failure = (written < 0 ? strerror(errno) : "nothing written");
+                break;
+            }
+            p    += written;
+            left -= size_t(written);
+        }
+        bytes += uint64_t(nb_read);
+
+        if (limit > 0.0)
+        {
+            const double ahead = double(bytes) / limit - (IO_Wall_Time() - start);
+            if (ahead > 0.0)
+                Sleep_Seconds(ahead);
+        }
+    }
+
+    if (out != -1)
+    {
+        if (failure == "" and fsync(out) != 0)
+            failure = strerror(errno);
+        if (close(out) != 0 and failure == "")
+            failure = strerror(errno);
+    }
+    if (in != -1)
+        close(in);
+    if (failure == "" and rename(temporary.c_str(), job.filename.c_str()) != 0)
+        failure = strerror(errno);
+
+    if (failure != "")
+    {
+        std_cout << "ERROR: Could not migrate '" << job.staged_filename << "' to '" << job.filename << "': " << failure << ". The staged file is kept.\n" << std::flush;
+        if (out != -1)
+            unlink(temporary.c_str());
+        return false;
+    }
+
+    unlink(job.staged_filename.c_str());
+    return true;
+}
+
+// **************************************************************
+void IO_Migrator::Finish(const Job &job, const bool success, const uint64_t bytes)
+/**
+ * Called with the mutex held.
+ */
+{
+    if (success)
+    {
+        nb_landed++;
+        bytes_landed += bytes;
+    }
+    else
+    {
+        nb_failed++;
+    }
+    // Failed files are not pending anymore either: waiting for them would never end.
+    pending.erase(pending.find(job.filename));
+    pthread_cond_broadcast(&cond_landed);
+}
+
+// **************************************************************
+void * IO_Migrator::Thread_Main(void *migrator)
+{
+    ((IO_Migrator *) migrator)->Thread_Loop();
+    return NULL;
+}
+
+// **************************************************************
+void IO_Migrator::Thread_Loop()
+{
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        while (jobs.empty() && !quit)
+            pthread_cond_wait(&cond_job, &mutex);
+
+        if (jobs.empty())
+            break;
+
+        const Job job = jobs.front();
+        jobs.pop_front();
+        const double limit = bandwidth;
+        pthread_mutex_unlock(&mutex);
+
+        uint64_t bytes = 0;
+        const double start = IO_Wall_Time();
+        const bool success = Copy(job, limit, bytes);
+
+        pthread_mutex_lock(&mutex);
+        copy_time += IO_Wall_Time() - start;
+        Finish(job, success, bytes);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Migrator::Print()
+{
+    pthread_mutex_lock(&mutex);
+    std_cout
+        << "Migration of staged files:\n"
+        << "    landed:          " << nb_landed << " (" << double(bytes_landed) / (1024.0*1024.0) << " MiB in " << copy_time << " s)\n"
+        << "    pending:         " << pending.size() << "\n"
+        << "    failed:          " << nb_failed << "\n"
+        << "    bandwidth limit: ";
+    if (bandwidth > 0.0)
+        std_cout << bandwidth / (1024.0*1024.0) << " MiB/s\n";
+    else
+        std_cout << "none\n";
+    pthread_mutex_unlock(&mutex);
+}
+
+// ********** End of file ***************************************
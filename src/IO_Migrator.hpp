@@ -0,0 +1,93 @@
+#ifndef INC_IO_MIGRATOR_hpp
+#define INC_IO_MIGRATOR_hpp
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <set>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// Size of the reads and writes of a migration, and granularity of the bandwidth limit (bytes)
+#define IO_MIGRATOR_CHUNK_SIZE (4*1024*1024)
+
+class IO_Migrator
+/**
+ * Burst-buffer staging ("stage" mode option of IO, NetCDF_Out's
+ * Set_Staging()): files are written to a fast node-local folder and,
+ * once closed, copied to their final name by a background thread.
+ *
+ * There is one migrator per process (Instance()), so files are copied
+ * one at a time and Set_Bandwidth() bounds the bandwidth the process
+ * takes from the shared filesystem. A file lands atomically: it is
+ * copied to "<name>.tmp", synced, then renamed; the staged copy is
+ * then removed (or kept if the copy failed).
+ *
+ *      IO_Migrator::Instance().Set_Bandwidth(200.0e6);    // 200 MB/s
+ *      snapshot.Open_File("wb:stage=/local/scratch");
+ *      ...
+ *      snapshot.Close_File();  // Returns at once
+ *      ...
+ *      IO_Migrator::Instance().Wait();
+ *
+ * exit() waits until every file has landed. Files staged when the
+ * process is killed stay in the staging folder.
+ */
+{
+    private:
+        struct Job
+        {
+            std::string staged_filename;
+            std::string filename;
+        };
+
+        std::deque<Job> jobs;
+        std::multiset<std::string> pending;     // Final names, queued or being copied
+        double bandwidth;                       // Bytes per second, 0: no limit
+        uint64_t nb_staged;
+        uint64_t nb_landed;
+        uint64_t nb_failed;
+        uint64_t bytes_landed;
+        double copy_time;                       // Seconds, including the pauses of the limit
+
+        bool quit;
+        bool exiting;                           // Past the atexit() wait: migrate in the caller
+        pthread_t thread;
+        bool has_thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_job;
+        pthread_cond_t  cond_landed;
+
+        IO_Migrator();
+        static void Create_Instance();
+        bool Copy(const Job &job, const double limit, uint64_t &bytes);
+        void Finish(const Job &job, const bool success, const uint64_t bytes);
+        static void * Thread_Main(void *migrator);
+        void Thread_Loop();
+        static void Wait_At_Exit();
+        static void Reset_In_Child();
+
+    public:
+        static IO_Migrator & Instance();
+
+        std::string Stage(const std::string &folder, const std::string &filename);
+        void Migrate(const std::string &staged_filename, const std::string &filename);
+        void Set_Bandwidth(const double bytes_per_second);
+        bool Is_Landed(const std::string &filename);
+        void Wait(const std::string &filename = "");
+
+        size_t   Get_Nb_Pending();
+        inline uint64_t Get_Nb_Landed()         { return nb_landed;     }
+        inline uint64_t Get_Nb_Failed()         { return nb_failed;     }
+        inline uint64_t Get_Bytes_Landed()      { return bytes_landed;  }
+        void Print();
+};
+
+#endif // INC_IO_MIGRATOR_hpp
+
+// ********** End of file ***************************************
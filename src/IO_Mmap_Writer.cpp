@@ -0,0 +1,183 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy()
+#include <cerrno>
+#include <algorithm> // std::min()
+#include <fcntl.h>  // open(), fallocate()
+#include <unistd.h> // ftruncate(), sysconf()
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <StdCout.hpp>
+
+#include "IO_Mmap_Writer.hpp"
+
+// **************************************************************
+IO_Mmap_Writer::IO_Mmap_Writer()
+{
+    fd              = -1;
+    window          = NULL;
+    window_offset   = 0;
+    window_size     = IO_MMAP_DEFAULT_WINDOW_SIZE;
+    file_size       = 0;
+    allocated       = 0;
+}
+
+// **************************************************************
+IO_Mmap_Writer::~IO_Mmap_Writer()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Mmap_Writer::Open(const std::string &_filename, const bool append,
+                          const size_t _window_size)
+{
+    assert(fd == -1);
+    assert(_window_size > 0);
+
+    filename = _filename;
+
+    // Mappings start on page boundaries: use a whole number of pages.
+    const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+    window_size = ((_window_size + page_size - 1) / page_size) * page_size;
+
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+    if (fd == -1)
+        return false;
+
+    file_size = 0;
+    if (append)
+    {
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0)
+        {
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        file_size = uint64_t(file_stat.st_size);
+    }
+    allocated = file_size;
+
+    Map_Window((file_size / page_size) * page_size);
+
+    return true;
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Reserve(const uint64_t end)
+/**
+ * Make sure the file extends to "end" so the mapping never points past
+ * its end (which would raise SIGBUS on access). Running out of disk
+ * space is reported here rather than as a SIGBUS in Write().
+ */
+{
+    if (end <= allocated)
+        return;
+
+    int error = -1;
+#ifdef __linux__
+    error = fallocate(fd, 0, off_t(allocated), off_t(end - allocated));
+    if (error != 0 && errno == ENOSPC)
+    {
+        std_cout << "ERROR: No space left to extend file '" << filename << "' to " << end << " bytes. Aborting.\n" << std::flush;
+        abort();
+    }
+#endif // #ifdef __linux__
+    // Filesystem without fallocate() support: extend a sparse file instead.
+    if (error != 0 && ftruncate(fd, off_t(end)) != 0)
+    {
+        std_cout << "ERROR: Could not extend file '" << filename << "' to " << end << " bytes. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    allocated = end;
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Map_Window(const uint64_t offset)
+{
+    assert(window == NULL);
+
+    Reserve(offset + window_size);
+
+    void *mapping = mmap(NULL, window_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, off_t(offset));
+    if (mapping == MAP_FAILED)
+    {
+        std_cout << "ERROR: Could not map " << window_size << " bytes of file '" << filename << "' at offset " << offset << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    window          = (char *) mapping;
+    window_offset   = offset;
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Unmap_Window()
+/**
+ * Dirty pages stay in the page cache; the kernel writes them back.
+ */
+{
+    if (window == NULL)
+        return;
+    munmap(window, window_size);
+    window = NULL;
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Write(const char *p, const size_t size)
+{
+    assert(window != NULL);
+
+    size_t written = 0;
+    while (written < size)
+    {
+        size_t position = size_t(file_size - window_offset);
+        if (position == window_size)
+        {
+            Unmap_Window();
+            Map_Window(window_offset + window_size);
+            position = 0;
+        }
+
+        const size_t n = std::min(size - written, window_size - position);
+        memcpy(window + position, p + written, n);
+        written   += n;
+        file_size += n;
+    }
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Flush()
+/**
+ * Start writing back the current window. Like fflush(), this does not
+ * wait for the data to reach the disk.
+ */
+{
+    if (window == NULL)
+        return;
+
+    const size_t used = size_t(file_size - window_offset);
+    if (used > 0)
+        msync(window, used, MS_ASYNC);
+}
+
+// **************************************************************
+void IO_Mmap_Writer::Close()
+{
+    if (fd == -1)
+        return;
+
+    Flush();
+    Unmap_Window();
+
+    // Drop the preallocated tail. The mapping must be gone first: pages
+    // mapped past the end of the file can't be touched anymore.
+    if (ftruncate(fd, off_t(file_size)) != 0)
+        std_cout << "WARNING: Could not truncate file '" << filename << "' to " << file_size << " bytes.\n";
+
+    close(fd);
+    fd = -1;
+}
+
+// ********** End of file ***************************************
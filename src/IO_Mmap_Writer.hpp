@@ -0,0 +1,59 @@
+#ifndef INC_IO_MMAP_WRITER_hpp
+#define INC_IO_MMAP_WRITER_hpp
+
+#include <string>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+
+// Default size of the mapped window, also the preallocation extent (bytes)
+#define IO_MMAP_DEFAULT_WINDOW_SIZE (64*1024*1024)
+
+class IO_Mmap_Writer : public IO_Sink
+/**
+ * Append-only output through a memory mapping.
+ *
+ * The file is preallocated one extent at a time (fallocate()) and a
+ * window of the same size is mapped; writes are copied directly into
+ * the mapping. When the window is full it is unmapped and the next
+ * extent is mapped. Close() trims the preallocated tail so the file
+ * ends at the last byte written.
+ *
+ * If the process dies before Close(), the file keeps its zero-filled
+ * preallocated tail.
+ */
+{
+    private:
+        std::string filename;
+        int fd;
+        char *window;               // Mapping of the current window
+        uint64_t window_offset;     // File offset of the window (page aligned)
+        size_t window_size;
+        uint64_t file_size;         // Bytes written (logical size)
+        uint64_t allocated;         // Bytes reserved on disk
+
+        void Reserve(const uint64_t end);
+        void Map_Window(const uint64_t offset);
+        void Unmap_Window();
+
+    public:
+        IO_Mmap_Writer();
+        ~IO_Mmap_Writer();
+        bool Open(const std::string &_filename, const bool append,
+                  const size_t _window_size = IO_MMAP_DEFAULT_WINDOW_SIZE);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        inline uint64_t Get_File_Size() { return file_size; }
+};
+
+#endif // INC_IO_MMAP_WRITER_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,292 @@
+
+#include <cstdlib>  // abort()
+#include <algorithm> // std::min()
+
+#include <StdCout.hpp>
+
+#include "IO_Parallel_Compressor.hpp"
+
+// **************************************************************
+IO_Parallel_Compressor::IO_Parallel_Compressor()
+{
+    fh              = NULL;
+    codec           = NULL;
+    block_size      = IO_PARALLEL_DEFAULT_BLOCK_SIZE;
+    max_in_flight   = 1;
+    current         = NULL;
+    writing         = false;
+    quit            = false;
+    nb_members      = 0;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond_job, NULL);
+    pthread_cond_init(&cond_written, NULL);
+}
+
+// **************************************************************
+IO_Parallel_Compressor::~IO_Parallel_Compressor()
+{
+    Close();
+
+    pthread_cond_destroy(&cond_written);
+    pthread_cond_destroy(&cond_job);
+    pthread_mutex_destroy(&mutex);
+}
+
+// **************************************************************
+bool IO_Parallel_Compressor::Open(const std::string &_filename, const bool append,
+                                  IO_Codec *_codec, const int nb_threads,
+                                  const size_t _block_size)
+/**
+ * Takes ownership of the codec, even on failure.
+ */
+{
+    assert(fh == NULL);
+    assert(_codec != NULL);
+    assert(nb_threads >= 0);
+    assert(_block_size > 0);
+
+    if (codec != NULL)
+        delete codec;
+    codec       = _codec;
+    filename    = _filename;
+    block_size  = _block_size;
+    writing     = false;
+    quit        = false;
+    nb_members  = 0;
+
+    // Concatenated frames are valid, so appending is trivial.
+    fh = fopen(filename.c_str(), (append ? "ab" : "wb"));
+    if (fh == NULL)
+        return false;
+
+    // Limit memory usage: a slow disk must eventually block Write().
+    max_in_flight = (nb_threads == 0 ? 1 : size_t(2*nb_threads));
+
+    threads.resize(nb_threads);
+    for (int i = 0 ; i < nb_threads ; i++)
+    {
+        if (pthread_create(&threads[i], NULL, IO_Parallel_Compressor::Thread_Main, (void *) this) != 0)
+        {
+            std_cout << "ERROR: Could not create compression thread " << i << " for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    return true;
+}
+
+// **************************************************************
+IO_Parallel_Compressor::Block * IO_Parallel_Compressor::New_Block()
+{
+    Block *block = NULL;
+
+    pthread_mutex_lock(&mutex);
+    if (!free_blocks.empty())
+    {
+        block = free_blocks.back();
+        free_blocks.pop_back();
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (block == NULL)
+    {
+        block = new Block;
+        block->in.reserve(block_size);
+    }
+    block->done = false;
+
+    return block;
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Compress(Block *block)
+/**
+ * Compress a block into a complete, independent frame.
+ */
+{
+    codec->Compress((block->in.empty() ? NULL : &block->in[0]), block->in.size(), block->out);
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Submit()
+/**
+ * Queue the current block for compression.
+ */
+{
+    assert(current != NULL);
+
+    Block *block = current;
+    current = NULL;
+
+    pthread_mutex_lock(&mutex);
+    while (in_flight.size() >= max_in_flight)
+        pthread_cond_wait(&cond_written, &mutex);
+    in_flight.push_back(block);
+
+    if (threads.empty())
+    {
+        pthread_mutex_unlock(&mutex);
+        Compress(block);
+        pthread_mutex_lock(&mutex);
+        block->done = true;
+        pthread_mutex_unlock(&mutex);
+        Write_Completed();
+    }
+    else
+    {
+        jobs.push_back(block);
+        pthread_cond_signal(&cond_job);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Write_Completed()
+/**
+ * Write to disk, in order, every compressed block at the head of the
+ * in-flight list. Only one thread at a time does so; others return.
+ */
+{
+    pthread_mutex_lock(&mutex);
+    while (!writing && !in_flight.empty() && in_flight.front()->done)
+    {
+        Block *block = in_flight.front();
+        in_flight.pop_front();
+        writing = true;
+        pthread_mutex_unlock(&mutex);
+
+        if (!block->out.empty() && fwrite(&block->out[0], 1, block->out.size(), fh) != block->out.size())
+        {
+            std_cout << "ERROR: Could not write compressed block to file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+
+        pthread_mutex_lock(&mutex);
+        writing = false;
+        nb_members++;
+        block->in.clear();
+        block->out.clear();
+        free_blocks.push_back(block);
+        pthread_cond_broadcast(&cond_written);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Write(const char *p, const size_t size)
+{
+    assert(fh != NULL);
+
+    size_t written = 0;
+    while (written < size)
+    {
+        if (current == NULL)
+            current = New_Block();
+
+        const size_t n = std::min(size - written, block_size - current->in.size());
+        current->in.insert(current->in.end(), p + written, p + written + n);
+        written += n;
+
+        if (current->in.size() >= block_size)
+            Submit();
+    }
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Flush()
+/**
+ * Compress and write everything received so far. The partial block
+ * becomes its own frame.
+ */
+{
+    if (fh == NULL)
+        return;
+
+    if (current != NULL && !current->in.empty())
+        Submit();
+
+    pthread_mutex_lock(&mutex);
+    while (!in_flight.empty() || writing)
+        pthread_cond_wait(&cond_written, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+    fflush(fh);
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Close()
+{
+    if (fh == NULL)
+        return;
+
+    // Like gzclose(), an empty stream still produces a valid (empty) compressed file.
+    if (nb_members == 0 && in_flight.empty() && (current == NULL || current->in.empty()))
+    {
+        if (current == NULL)
+            current = New_Block();
+        Submit();
+    }
+
+    Flush();
+
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_broadcast(&cond_job);
+    pthread_mutex_unlock(&mutex);
+
+    for (size_t i = 0 ; i < threads.size() ; i++)
+        pthread_join(threads[i], NULL);
+    threads.clear();
+
+    fclose(fh);
+    fh = NULL;
+
+    if (current != NULL)
+        delete current;
+    current = NULL;
+    for (size_t i = 0 ; i < free_blocks.size() ; i++)
+        delete free_blocks[i];
+    free_blocks.clear();
+
+    delete codec;
+    codec = NULL;
+}
+
+// **************************************************************
+void * IO_Parallel_Compressor::Thread_Main(void *compressor)
+{
+    ((IO_Parallel_Compressor *) compressor)->Thread_Loop();
+    return NULL;
+}
+
+// **************************************************************
+void IO_Parallel_Compressor::Thread_Loop()
+{
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        while (jobs.empty() && !quit)
+            pthread_cond_wait(&cond_job, &mutex);
+
+        if (jobs.empty())
+            break;
+
+        Block *block = jobs.front();
+        jobs.pop_front();
+        pthread_mutex_unlock(&mutex);
+
+        Compress(block);
+
+        pthread_mutex_lock(&mutex);
+        block->done = true;
+        pthread_mutex_unlock(&mutex);
+
+        Write_Completed();
+
+        pthread_mutex_lock(&mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,86 @@
+#ifndef INC_IO_PARALLEL_COMPRESSOR_hpp
+#define INC_IO_PARALLEL_COMPRESSOR_hpp
+
+#include <pthread.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+#include "IO_Codec.hpp"
+
+// Default uncompressed size of each independent block (bytes)
+#define IO_PARALLEL_DEFAULT_BLOCK_SIZE (1024*1024)
+
+class IO_Parallel_Compressor : public IO_Sink
+/**
+ * Block-parallel compressed output (pigz/BGZF style).
+ *
+ * The stream is cut into blocks of "block_size" bytes. Each block is
+ * compressed independently into a complete frame (a gzip member for
+ * the deflate codec) by a pool of worker threads, and frames are
+ * written to the file in order. Since a concatenation of frames is a
+ * valid file for every codec, the result can be read by zcat, etc.
+ *
+ * With zero threads, blocks are compressed by the calling thread.
+ */
+{
+    private:
+        struct Block
+        {
+            std::vector<char> in;       // Uncompressed data
+            std::vector<char> out;      // Compressed frame
+            bool done;                  // Compression finished
+        };
+
+        std::string filename;
+        FILE *fh;
+        IO_Codec *codec;                // Owned
+        size_t block_size;
+        size_t max_in_flight;           // Maximum number of blocks in memory
+
+        Block *current;                 // Block being filled by Write()
+        std::deque<Block *> jobs;       // Blocks waiting for a worker
+        std::deque<Block *> in_flight;  // Submitted blocks, in file order
+        std::vector<Block *> free_blocks;
+        bool writing;                   // A thread is writing in_flight.front()
+        bool quit;
+        uint64_t nb_members;            // Number of frames written
+
+        std::vector<pthread_t> threads;
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_job;       // A job is available (or quit)
+        pthread_cond_t  cond_written;   // A block was written to disk
+
+        Block * New_Block();
+        void Compress(Block *block);
+        void Submit();
+        void Write_Completed();
+        static void * Thread_Main(void *compressor);
+        void Thread_Loop();
+
+    public:
+        IO_Parallel_Compressor();
+        ~IO_Parallel_Compressor();
+        bool Open(const std::string &_filename, const bool append,
+                  IO_Codec *_codec, const int nb_threads,
+                  const size_t _block_size = IO_PARALLEL_DEFAULT_BLOCK_SIZE);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        inline uint64_t Get_Nb_Members()    { return nb_members; }
+        inline IO_Codec * Codec()           { return codec;      }
+};
+
+#endif // INC_IO_PARALLEL_COMPRESSOR_hpp
+
+// ********** End of file ***************************************
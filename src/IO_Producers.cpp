@@ -0,0 +1,210 @@
+
+#include <cstdlib>  // abort()
+#include <cstdio>   // vsnprintf()
+#include <utility>  // std::pair
+#include <algorithm> // std::sort()
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif // #ifdef _OPENMP
+
+#include <StdCout.hpp>
+
+#include "InputOutput.hpp"
+#include "IO_Producers.hpp"
+
+// va_copy() is C99/C++11; GCC and compatibles provide __va_copy() in C++98.
+#ifndef va_copy
+#define va_copy(destination, source) __va_copy(destination, source)
+#endif
+
+// **************************************************************
+bool IO_Producers::Chunk::operator<(const Chunk &other) const
+{
+    if (time   < other.time)    return true;
+    if (other.time < time)      return false;
+    if (thread != other.thread) return (thread < other.thread);
+    if (buffer != other.buffer) return (buffer < other.buffer);
+    return (offset < other.offset);
+}
+
+// **************************************************************
+IO_Producers::IO_Producers(IO *_owner, const bool _ordered)
+{
+    assert(_owner != NULL);
+
+    owner   = _owner;
+    ordered = _ordered;
+    time    = 0.0;
+
+    if (pthread_key_create(&key, NULL) != 0)
+    {
+        std_cout << "ERROR: Could not create thread key for file '" << owner->Get_Filename() << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+    pthread_mutex_init(&mutex, NULL);
+}
+
+// **************************************************************
+IO_Producers::~IO_Producers()
+{
+    for (size_t i = 0 ; i < buffers.size() ; i++)
+        delete buffers[i];
+    buffers.clear();
+
+    pthread_mutex_destroy(&mutex);
+    pthread_key_delete(key);
+}
+
+// **************************************************************
+IO_Producers::Thread_Buffer * IO_Producers::Buffer()
+/**
+ * Calling thread's buffer, created at its first write.
+ */
+{
+    Thread_Buffer *buffer = (Thread_Buffer *) pthread_getspecific(key);
+    if (buffer != NULL)
+        return buffer;
+
+    buffer = new Thread_Buffer;
+    pthread_mutex_lock(&mutex);
+#ifdef _OPENMP
+    buffer->thread = omp_get_thread_num();
+#else // #ifdef _OPENMP
+    buffer->thread = int(buffers.size());
+#endif // #ifdef _OPENMP
+    buffers.push_back(buffer);
+    pthread_mutex_unlock(&mutex);
+    pthread_setspecific(key, buffer);
+
+    return buffer;
+}
+
+// **************************************************************
+void IO_Producers::Tag(Thread_Buffer *buffer, const size_t offset)
+/**
+ * Record what was just appended at "offset" as one write.
+ */
+{
+    if (!ordered || offset == buffer->data.size())
+        return;
+
+    Chunk chunk;
+    chunk.time      = time;
+#ifdef _OPENMP
+    chunk.thread    = omp_get_thread_num();
+#else // #ifdef _OPENMP
+    chunk.thread    = buffer->thread;
+#endif // #ifdef _OPENMP
+    chunk.buffer    = -1;   // Set by Merge()
+    chunk.offset    = offset;
+    chunk.size      = buffer->data.size() - offset;
+    buffer->chunks.push_back(chunk);
+}
+
+// **************************************************************
+void IO_Producers::Append(const char *p, const size_t size)
+{
+    Thread_Buffer *buffer = Buffer();
+    const size_t offset = buffer->data.size();
+    buffer->data.insert(buffer->data.end(), p, p + size);
+    Tag(buffer, offset);
+}
+
+// **************************************************************
+size_t IO_Producers::Append_Formatted(const char *format, va_list args)
+/**
+ * printf() directly into the thread's buffer.
+ * @return  Number of characters written
+ */
+{
+    Thread_Buffer *buffer = Buffer();
+    const size_t offset = buffer->data.size();
+
+    size_t room = 256;
+    while (true)
+    {
+        buffer->data.resize(offset + room);
+        va_list args_copy;
+        va_copy(args_copy, args);
+        const int length = vsnprintf(&buffer->data[offset], room, format, args_copy);
+        va_end(args_copy);
+        if (length < 0)
+        {
+            std_cout << "Couldn't call vsnprintf! Aborting.\n" << std::flush;
+            abort();
+        }
+        if (size_t(length) < room)
+        {
+            buffer->data.resize(offset + size_t(length));
+            break;
+        }
+        room = size_t(length) + 1;
+    }
+
+    Tag(buffer, offset);
+
+    return buffer->data.size() - offset;
+}
+
+// **************************************************************
+std::vector<char> & IO_Producers::Scratch()
+/**
+ * Thread-private work space (used to assemble typed records).
+ */
+{
+    return Buffer()->scratch;
+}
+
+// **************************************************************
+void IO_Producers::Merge()
+/**
+ * Write every thread's data to the file and empty the buffers.
+ * No thread may write concurrently.
+ */
+{
+    if (ordered)
+    {
+        merge.clear();
+        for (size_t b = 0 ; b < buffers.size() ; b++)
+        {
+            for (size_t c = 0 ; c < buffers[b]->chunks.size() ; c++)
+            {
+                merge.push_back(buffers[b]->chunks[c]);
+                merge.back().buffer = int(b);
+            }
+            buffers[b]->chunks.clear();
+        }
+        // Ties on (time, thread) between buffers only happen if thread
+        // numbers are reused; they are then broken by buffer creation order.
+        std::sort(merge.begin(), merge.end());
+
+        merged.clear();
+        for (size_t i = 0 ; i < merge.size() ; i++)
+        {
+            const char *p = &buffers[merge[i].buffer]->data[merge[i].offset];
+            merged.insert(merged.end(), p, p + merge[i].size);
+        }
+        if (!merged.empty())
+            owner->Write_Serial(&merged[0], merged.size());
+    }
+    else
+    {
+        std::vector<std::pair<int, int> > order(buffers.size());
+        for (size_t b = 0 ; b < buffers.size() ; b++)
+            order[b] = std::make_pair(buffers[b]->thread, int(b));
+        std::sort(order.begin(), order.end());
+
+        for (size_t i = 0 ; i < order.size() ; i++)
+        {
+            std::vector<char> &data = buffers[order[i].second]->data;
+            if (!data.empty())
+                owner->Write_Serial(&data[0], data.size());
+        }
+    }
+
+    for (size_t b = 0 ; b < buffers.size() ; b++)
+        buffers[b]->data.clear();
+}
+
+// ********** End of file ***************************************
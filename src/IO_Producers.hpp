@@ -0,0 +1,85 @@
+#ifndef INC_IO_PRODUCERS_hpp
+#define INC_IO_PRODUCERS_hpp
+
+#include <pthread.h>
+#include <cstdarg>
+#include <vector>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+class IO;
+
+class IO_Producers
+/**
+ * Per-thread buffers used by IO's "producers" mode.
+ *
+ * Each thread appends to its own buffer, without any lock, so IO's
+ * Write() and WriteString() can be called from inside parallel regions.
+ * Buffers are merged into the file by IO::Flush() and IO::Close_File(),
+ * which must be called while no thread is writing (e.g. after the
+ * parallel region).
+ *
+ * In "ordered" mode, every write is tagged with the time given to
+ * IO::Set_Time() and with the writing thread's number, and the merge
+ * sorts writes by (time, thread), keeping each thread's order. With
+ * OpenMP (library built with "make omp"), the thread number is
+ * omp_get_thread_num() and the output is reproducible from run to run.
+ * Otherwise threads are numbered in order of their first write.
+ * Without "ordered", each thread's data is written in one piece, in
+ * thread order.
+ */
+{
+    private:
+        struct Chunk
+        {
+            double time;
+            int thread;
+            int buffer;         // Index of the Thread_Buffer
+            size_t offset;      // In the Thread_Buffer's data
+            size_t size;
+            bool operator<(const Chunk &other) const;
+        };
+        struct Thread_Buffer
+        {
+            int thread;                 // Number of the thread, at first write
+            std::vector<char> data;
+            std::vector<Chunk> chunks;  // "ordered" mode only
+            std::vector<char> scratch;  // See IO_Producers::Scratch()
+            char padding[64];           // Keep threads' hot data on separate cache lines
+        };
+
+        IO *owner;
+        bool ordered;
+        double time;                    // Set by IO::Set_Time()
+        pthread_key_t key;              // Thread's Thread_Buffer
+        pthread_mutex_t mutex;          // Protects registration only
+        std::vector<Thread_Buffer *> buffers;
+        std::vector<Chunk> merge;
+        std::vector<char> merged;
+
+        Thread_Buffer * Buffer();
+        void Tag(Thread_Buffer *buffer, const size_t offset);
+
+    public:
+        IO_Producers(IO *_owner, const bool _ordered);
+        ~IO_Producers();
+
+        void Append(const char *p, const size_t size);
+        size_t Append_Formatted(const char *format, va_list args);
+        std::vector<char> & Scratch();
+        void Merge();
+
+        inline void     Set_Time(const double _time)    { time = _time;     }
+        inline bool     Is_Ordered()                    { return ordered;   }
+        inline int      Get_Nb_Threads()                { return int(buffers.size()); }
+};
+
+#endif // INC_IO_PRODUCERS_hpp
+
+// ********** End of file ***************************************
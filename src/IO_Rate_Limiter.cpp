@@ -0,0 +1,200 @@
+
+#include <cstdlib>  // abort()
+#include <cerrno>
+#include <algorithm> // std::min(), std::max()
+
+#include <StdCout.hpp>
+
+#include "IO_Rate_Limiter.hpp"
+#include "IO_Stats.hpp"
+
+// Never deleted: writers may still be closed from atexit() functions.
+static IO_Rate_Limiter *instance = NULL;
+static pthread_once_t instance_once = PTHREAD_ONCE_INIT;
+
+// **************************************************************
+IO_Rate_Limiter::IO_Rate_Limiter()
+{
+    rate        = 0.0;
+    burst       = 0.0;
+    tokens      = 0.0;
+    last_refill = 0.0;
+    for (int i = 0 ; i < Unlimited ; i++)
+    {
+        nb_waiting[i]   = 0;
+        bytes[i]        = 0;
+        wait_time[i]    = 0.0;
+    }
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond_tokens, NULL);
+}
+
+// **************************************************************
+void IO_Rate_Limiter::Create_Instance()
+{
+    instance = new IO_Rate_Limiter;
+}
+
+// **************************************************************
+IO_Rate_Limiter & IO_Rate_Limiter::Instance()
+{
+    pthread_once(&instance_once, IO_Rate_Limiter::Create_Instance);
+    return *instance;
+}
+
+// **************************************************************
+bool IO_Rate_Limiter::Priority_From_Name(const std::string &name, Priority &priority)
+/**
+ * @return  false if "name" is not "checkpoint", "snapshot", "diagnostic" or "none"
+ */
+{
+    if (name == "checkpoint")
+        priority = Checkpoint;
+    else if (name == "snapshot")
+        priority = Snapshot;
+    else if (name == "diagnostic")
+        priority = Diagnostic;
+    else if (name == "none")
+        priority = Unlimited;
+    else
+        return false;
+    return true;
+}
+
+// **************************************************************
+const char * IO_Rate_Limiter::Priority_Name(const Priority priority)
+{
+    const char *names[] = {"checkpoint", "snapshot", "diagnostic", "none"};
+    return names[priority];
+}
+
+// **************************************************************
+void IO_Rate_Limiter::Set_Rate(const double bytes_per_second, const double burst_bytes)
+/**
+ * @param bytes_per_second  0 to stop limiting
+ * @param burst_bytes       Default: 100 ms at "bytes_per_second"
+ */
+{
+    assert(bytes_per_second >= 0.0);
+    assert(burst_bytes >= 0.0);
+
+    pthread_mutex_lock(&mutex);
+    rate        = bytes_per_second;
+    burst       = (burst_bytes > 0.0 ? burst_bytes : std::max(0.1 * rate, double(IO_RATE_LIMITER_QUANTUM)));
+    tokens      = burst;
+    last_refill = IO_Wall_Time();
+    pthread_cond_broadcast(&cond_tokens);
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Rate_Limiter::Refill(const double now)
+/**
+ * Called with the mutex held.
+ */
+{
+    tokens      = std::min(burst, tokens + (now - last_refill) * rate);
+    last_refill = now;
+}
+
+// **************************************************************
+void IO_Rate_Limiter::Acquire(const uint64_t size, const Priority priority)
+/**
+ * Take "size" bytes from the bucket, waiting until it holds enough
+ * (at most a burst) and no higher class is waiting.
+ */
+{
+    if (priority == Unlimited or size == 0)
+        return;
+
+    pthread_mutex_lock(&mutex);
+    if (rate <= 0.0)
+    {
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+
+    const double start = IO_Wall_Time();
+    nb_waiting[priority]++;
+    while (true)
+    {
+        const double now = IO_Wall_Time();
+        Refill(now);
+
+        bool is_preempted = false;
+        for (int higher = 0 ; higher < priority ; higher++)
+            is_preempted = (is_preempted or nb_waiting[higher] > 0);
+
+        const double needed = std::min(double(size), burst);
+        if (!is_preempted and tokens >= needed)
+            break;
+
+        // Until enough tokens are in, or a higher class is done.
+        const double delay = (is_preempted ? 0.01 : std::max((needed - tokens) / rate, 1.0e-4));
+        const double wake_up = now + delay;
+        timespec deadline;
+        deadline.tv_sec  = time_t(wake_up);
+        deadline.tv_nsec = long(1.0e9 * (wake_up - double(deadline.tv_sec)));
+        pthread_cond_timedwait(&cond_tokens, &mutex, &deadline);
+    }
+    nb_waiting[priority]--;
+    tokens -= double(size);
+
+    bytes[priority]     += size;
+    wait_time[priority] += IO_Wall_Time() - start;
+
+    // Lower classes may go on if this was the last waiter of its class.
+    pthread_cond_broadcast(&cond_tokens);
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+bool IO_Rate_Limiter::Is_Enabled()
+{
+    pthread_mutex_lock(&mutex);
+    const bool is_enabled = (rate > 0.0);
+    pthread_mutex_unlock(&mutex);
+    return is_enabled;
+}
+
+// **************************************************************
+uint64_t IO_Rate_Limiter::Get_Bytes(const Priority priority)
+{
+    assert(priority < Unlimited);
+
+    pthread_mutex_lock(&mutex);
+    const uint64_t drawn = bytes[priority];
+    pthread_mutex_unlock(&mutex);
+    return drawn;
+}
+
+// **************************************************************
+double IO_Rate_Limiter::Get_Wait_Time(const Priority priority)
+{
+    assert(priority < Unlimited);
+
+    pthread_mutex_lock(&mutex);
+    const double waited = wait_time[priority];
+    pthread_mutex_unlock(&mutex);
+    return waited;
+}
+
+// **************************************************************
+void IO_Rate_Limiter::Print()
+{
+    pthread_mutex_lock(&mutex);
+    std_cout << "Rate limiter: ";
+    if (rate > 0.0)
+        std_cout << rate / (1024.0*1024.0) << " MiB/s, burst " << burst / (1024.0*1024.0) << " MiB\n";
+    else
+        std_cout << "no limit\n";
+    for (int i = 0 ; i < Unlimited ; i++)
+    {
+        std_cout
+            << "    " << Priority_Name(Priority(i)) << ": "
+            << double(bytes[i]) / (1024.0*1024.0) << " MiB, waited " << wait_time[i] << " s\n";
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// ********** End of file ***************************************
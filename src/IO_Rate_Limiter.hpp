@@ -0,0 +1,81 @@
+#ifndef INC_IO_RATE_LIMITER_hpp
+#define INC_IO_RATE_LIMITER_hpp
+
+#include <pthread.h>
+#include <string>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// IO draws from the limiter once this many bytes were written (bytes)
+#define IO_RATE_LIMITER_QUANTUM (64*1024)
+
+class IO_Rate_Limiter
+/**
+ * Token bucket shared by every IO and NetCDF_Out of the process. The
+ * bucket fills at "rate" bytes per second up to "burst" bytes; writes
+ * take their size from it, waiting while it is empty, and may leave
+ * it in debt (a large write then delays the following ones).
+ *
+ * Writers belong to a priority class ("priority" mode option of IO,
+ * NetCDF_Out's Set_Priority()): a class only gets tokens while no
+ * writer of a higher class is waiting, so lower classes absorb the
+ * throttling. "Unlimited" writers are not metered at all.
+ *
+ *      IO_Rate_Limiter::Instance().Set_Rate(500.0e6 / nb_ranks_per_node);
+ *      checkpoint.Open_File("wb:priority=checkpoint");
+ *      diagnostics.Open_File("w:priority=diagnostic:async");
+ *
+ * Until Set_Rate() is called, nothing is limited. IO draws from the
+ * bucket by quanta of IO_RATE_LIMITER_QUANTUM bytes, in the thread
+ * that writes to the file (the background one in "async" mode), and
+ * counts bytes as given to the file handle (before compression).
+ */
+{
+    public:
+        enum Priority
+        {
+            Checkpoint  = 0,
+            Snapshot    = 1,
+            Diagnostic  = 2,
+            Unlimited   = 3
+        };
+
+    private:
+        double rate;                // Bytes per second, 0: no limit
+        double burst;               // Bucket size (bytes)
+        double tokens;
+        double last_refill;         // Wall time
+
+        int nb_waiting[Unlimited];
+        uint64_t bytes[Unlimited];  // Drawn, per class
+        double wait_time[Unlimited];
+
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_tokens;
+
+        IO_Rate_Limiter();
+        static void Create_Instance();
+        void Refill(const double now);
+
+    public:
+        static IO_Rate_Limiter & Instance();
+        static bool Priority_From_Name(const std::string &name, Priority &priority);
+        static const char * Priority_Name(const Priority priority);
+
+        void Set_Rate(const double bytes_per_second, const double burst_bytes = 0.0);
+        void Acquire(const uint64_t size, const Priority priority);
+
+        bool Is_Enabled();
+        uint64_t Get_Bytes(const Priority priority);
+        double Get_Wait_Time(const Priority priority);
+        void Print();
+};
+
+#endif // INC_IO_RATE_LIMITER_hpp
+
+// ********** End of file ***************************************
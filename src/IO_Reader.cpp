@@ -0,0 +1,464 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memchr(), memmove()
+#include <cerrno>
+#include <algorithm> // std::min()
+#include <fcntl.h>  // open()
+#include <unistd.h> // read(), pread(), lseek(), close()
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef COMPRESS_OUTPUT
+#include <zlib.h>
+#endif // #ifdef COMPRESS_OUTPUT
+
+#include <StdCout.hpp>
+
+#include "IO_Reader.hpp"
+
+// **************************************************************
+IO_Reader::IO_Reader()
+{
+    fd          = -1;
+    compressed  = false;
+    map         = NULL;
+    map_size    = 0;
+    stream      = NULL;
+    input_done  = false;
+    stream_done = false;
+    in_member   = false;
+    raw_deflate = false;
+    trailer_left = 0;
+    index_loaded = false;
+    pos         = NULL;
+    end         = NULL;
+    scanned     = 0;
+}
+
+// **************************************************************
+IO_Reader::IO_Reader(const std::string _filename, const size_t buffer_size)
+{
+    fd          = -1;
+    compressed  = false;
+    map         = NULL;
+    map_size    = 0;
+    stream      = NULL;
+    pos         = NULL;
+    end         = NULL;
+    Open(_filename, buffer_size);
+}
+
+// **************************************************************
+IO_Reader::~IO_Reader()
+{
+    Close();
+}
+
+// **************************************************************
+void IO_Reader::Open(const std::string _filename, const size_t buffer_size)
+/**
+ * The format is found from the file's first bytes, not its name.
+ */
+{
+    assert(fd == -1);
+    assert(buffer_size > 0);
+
+    filename    = _filename;
+    compressed  = false;
+    input_done  = false;
+    stream_done = false;
+    in_member   = false;
+    raw_deflate = false;
+    trailer_left = 0;
+    index_loaded = false;
+    pos         = NULL;
+    end         = NULL;
+    scanned     = 0;
+
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        std_cout << "ERROR: Could not open file '" << filename << "' for reading: " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    unsigned char magic[4] = {0, 0, 0, 0};
+    const ssize_t nb_magic = pread(fd, magic, sizeof(magic), 0);
+    if (nb_magic >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+        compressed = true;
+    }
+    else if (nb_magic == 4 && ((magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) ||
+                               (magic[0] == 0x04 && magic[1] == 0x22 && magic[2] == 0x4d && magic[3] == 0x18)))
+    {
+        std_cout << "ERROR: File '" << filename << "' is compressed with zstd or lz4; only gzip files can be read. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    if (compressed)
+    {
+#ifdef COMPRESS_OUTPUT
+        z_stream *z = new z_stream;
+        memset(z, 0, sizeof(z_stream));
+        // windowBits of 15+32: detect the gzip (or zlib) header.
+        if (inflateInit2(z, 15+32) != Z_OK)
+        {
+            std_cout << "ERROR: inflateInit2() failed for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        stream = (void *) z;
+        input.resize(buffer_size);
+        output.resize(buffer_size);
+        pos = end = &output[0];
+#else // #ifdef COMPRESS_OUTPUT
+        std_cout << "ERROR: File '" << filename << "' is compressed. Please compile io.git with -DCOMPRESS_OUTPUT to read it. Aborting.\n" << std::flush;
+        abort();
+#endif // #ifdef COMPRESS_OUTPUT
+    }
+    else
+    {
+        struct stat status;
+        if (fstat(fd, &status) != 0)
+        {
+            std_cout << "ERROR: Could not stat file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        map_size = size_t(status.st_size);
+        if (map_size > 0)
+        {
+            void *p = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                std_cout << "ERROR: Could not map file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+                abort();
+            }
+            map = (char *) p;
+            madvise(map, map_size, MADV_SEQUENTIAL);
+            pos = map;
+            end = map + map_size;
+        }
+    }
+}
+
+// **************************************************************
+void IO_Reader::Close()
+{
+    if (map != NULL)
+        munmap(map, map_size);
+    map         = NULL;
+    map_size    = 0;
+
+#ifdef COMPRESS_OUTPUT
+    if (stream != NULL)
+    {
+        inflateEnd((z_stream *) stream);
+        delete (z_stream *) stream;
+    }
+#endif // #ifdef COMPRESS_OUTPUT
+    stream      = NULL;
+    input.clear();
+    output.clear();
+
+    if (fd != -1)
+        close(fd);
+    fd          = -1;
+    pos         = NULL;
+    end         = NULL;
+}
+
+// **************************************************************
+bool IO_Reader::Refill()
+/**
+ * Inflate more data after the unconsumed bytes, which are first moved
+ * to the start of the window (the window doubles if they fill it).
+ * @return false if there is nothing more to read
+ */
+{
+#ifdef COMPRESS_OUTPUT
+    if (!compressed or stream_done)
+        return false;
+
+    const size_t kept = size_t(end - pos);
+    if (pos != &output[0])
+        memmove(&output[0], pos, kept);
+    if (kept == output.size())
+        output.resize(2*output.size());
+    pos = &output[0];
+    end = pos + kept;
+
+    z_stream *z = (z_stream *) stream;
+    size_t produced = 0;
+    while (produced == 0 and !stream_done)
+    {
+        if (z->avail_in == 0 and !input_done)
+        {
+            const ssize_t nb_read = read(fd, &input[0], input.size());
+            if (nb_read < 0)
+            {
+                std_cout << "ERROR: Could not read file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+                abort();
+            }
+            if (nb_read == 0)
+                input_done = true;
+            z->next_in  = (Bytef *) &input[0];
+            z->avail_in = uInt(nb_read);
+        }
+        if (z->avail_in == 0 and input_done)
+        {
+            // A file still being written may end inside a member.
+            if (in_member)
+                std_cout << "WARNING: File '" << filename << "' ends in the middle of a gzip member (truncated?).\n";
+            stream_done = true;
+            break;
+        }
+
+        if (trailer_left > 0)
+        {
+            const uInt skipped = std::min(z->avail_in, uInt(trailer_left));
+            z->next_in      += skipped;
+            z->avail_in     -= skipped;
+            trailer_left    -= int(skipped);
+            continue;
+        }
+
+        const size_t room = output.size() - size_t(end - pos);
+        z->next_out     = (Bytef *) &output[0] + (end - pos);
+        z->avail_out    = uInt(room);
+        const int result = inflate(z, Z_NO_FLUSH);
+        produced = room - z->avail_out;
+        end += produced;
+        in_member = true;
+
+        if (result == Z_STREAM_END)
+        {
+            // Next member, if any (one per Open_File("a...") or Flush())
+            if (raw_deflate)
+            {
+                // Raw deflate stops before the member's CRC and size.
+                trailer_left = 8;
+                raw_deflate = false;
+                inflateReset2(z, 15+32);
+            }
+            else
+                inflateReset(z);
+            in_member = false;
+        }
+        else if (result != Z_OK and result != Z_BUF_ERROR)
+        {
+            std_cout << "ERROR: Corrupted gzip data in file '" << filename << "' (" << (z->msg != NULL ? z->msg : "unknown error") << "). Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    return (produced > 0);
+#else // #ifdef COMPRESS_OUTPUT
+    return false;
+#endif // #ifdef COMPRESS_OUTPUT
+}
+
+// **************************************************************
+bool IO_Reader::Next_Line(IO_Span &line)
+/**
+ * Next line, without its '\n'. A last line without '\n' is returned too.
+ * @return false at end of file
+ */
+{
+    assert(fd != -1);
+
+    while (true)
+    {
+        const char *from = pos + scanned;
+        const char *newline = (from < end ? (const char *) memchr(from, '\n', size_t(end - from)) : NULL);
+        if (newline != NULL)
+        {
+            line    = IO_Span(pos, size_t(newline - pos));
+            pos     = newline + 1;
+            scanned = 0;
+            return true;
+        }
+
+        scanned = size_t(end - pos);
+        if (!Refill())
+        {
+            if (pos == end)
+                return false;
+            line    = IO_Span(pos, size_t(end - pos));
+            pos     = end;
+            scanned = 0;
+            return true;
+        }
+    }
+}
+
+// **************************************************************
+bool IO_Reader::Read(IO_Span &span, const size_t size)
+/**
+ * Next "size" bytes (fixed size binary records).
+ * @return false at end of file
+ */
+{
+    assert(fd != -1);
+
+    while (size_t(end - pos) < size)
+    {
+        if (!Refill())
+        {
+            if (pos == end)
+                return false;
+            std_cout << "ERROR: File '" << filename << "' ends in the middle of a " << size << " bytes read. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+
+    span    = IO_Span(pos, size);
+    pos    += size;
+    scanned = 0;
+    return true;
+}
+
+// **************************************************************
+void IO_Reader::Read_All(IO_Span &span)
+/**
+ * Rest of the file as one span. A gzip file is entirely inflated in
+ * memory; a plain file is not copied.
+ */
+{
+    assert(fd != -1);
+
+    while (Refill())
+        ;
+
+    span    = IO_Span(pos, size_t(end - pos));
+    pos     = end;
+    scanned = 0;
+}
+
+// **************************************************************
+void IO_Reader::Load_Index()
+{
+    if (index_loaded)
+        return;
+
+    if (!index.Load(filename + IO_GZIP_INDEX_EXTENSION))
+    {
+        std_cout << "ERROR: File '" << filename << "' has no index '" << filename << IO_GZIP_INDEX_EXTENSION << "' (not written in 'index' mode?). Aborting.\n" << std::flush;
+        abort();
+    }
+    index_loaded = true;
+}
+
+// **************************************************************
+void IO_Reader::Restart_At(const int entry)
+/**
+ * Inflate from a restart point of the index (raw deflate), or from the
+ * start of the file if entry is -1.
+ */
+{
+#ifdef COMPRESS_OUTPUT
+    z_stream *z = (z_stream *) stream;
+    const off_t offset = (entry < 0 ? 0 : off_t(index[entry].compressed_offset));
+    if (lseek(fd, offset, SEEK_SET) == off_t(-1))
+    {
+        std_cout << "ERROR: Could not seek in file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    raw_deflate     = (entry >= 0);
+    inflateReset2(z, (raw_deflate ? -15 : 15+32));
+    z->avail_in     = 0;
+    trailer_left    = 0;
+    input_done      = false;
+    stream_done     = false;
+    in_member       = raw_deflate;
+    pos = end       = &output[0];
+    scanned         = 0;
+#endif // #ifdef COMPRESS_OUTPUT
+}
+
+// **************************************************************
+bool IO_Reader::Seek_Offset(const uint64_t offset)
+/**
+ * Position at the given uncompressed byte.
+ * @return false if it is past the end of the file
+ */
+{
+    assert(fd != -1);
+
+    if (!compressed)
+    {
+        if (offset > map_size)
+            return false;
+        pos     = map + offset;
+        end     = map + map_size;
+        scanned = 0;
+        return true;
+    }
+
+    Load_Index();
+    const int entry = index.Find_Offset(offset);
+    Restart_At(entry);
+
+    uint64_t left = offset - (entry < 0 ? 0 : index[entry].uncompressed_offset);
+    while (left > 0)
+    {
+        if (pos == end and !Refill())
+            return false;
+        const size_t skipped = size_t(std::min(left, uint64_t(end - pos)));
+        pos  += skipped;
+        left -= skipped;
+    }
+    return true;
+}
+
+// **************************************************************
+bool IO_Reader::Seek_Time(const double time)
+/**
+ * Position at the restart point preceding the first write at "time"
+ * (see IO::Set_Time()). Lines read next may have been written a bit
+ * earlier, up to one interval: the caller skips them.
+ * @return false if the file has no restart points (no data)
+ */
+{
+    assert(fd != -1);
+
+    if (!compressed)
+    {
+        std_cout << "ERROR: File '" << filename << "' is not compressed: only files written in 'index' mode can be searched by time. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    Load_Index();
+    if (index.Empty())
+        return false;
+    Restart_At(index.Find_Time(time));
+    return true;
+}
+
+// **************************************************************
+bool IO_Reader::Next_Record(IO_Record_Header &header, IO_Span &data)
+/**
+ * Next typed record written by IO::Write<T>(). "data" holds the values
+ * as stored: in the record's byte order (header.order) and possibly
+ * unaligned. IO_Record_Reader converts them instead.
+ * @return false at end of file
+ */
+{
+    IO_Span raw;
+    if (!Read(raw, IO_RECORD_HEADER_SIZE))
+        return false;
+    if (!IO_Parse_Record_Header(raw.data, header))
+    {
+        std_cout << "ERROR: Invalid record header in file '" << filename << "' (not written by IO::Write<T>()?). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    const size_t size = size_t(header.count) * size_t(header.element_size);
+    if (!Read(data, size))
+    {
+        std_cout << "ERROR: Truncated record in file '" << filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+    return true;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,109 @@
+#ifndef INC_IO_READER_hpp
+#define INC_IO_READER_hpp
+
+#include <string>
+#include <vector>
+#include <cstring> // memcmp(), strlen()
+#include <cstddef> // size_t
+
+#include "IO_Records.hpp"
+#include "IO_Gzip_Index.hpp"
+
+// Initial size of the inflated window (grows to fit the longest line)
+#define IO_READER_DEFAULT_BUFFER_SIZE   (1024*1024)
+
+// **************************************************************
+struct IO_Span
+/**
+ * Read-only view of bytes owned by an IO_Reader (like C++17's
+ * std::string_view); nothing is copied.
+ */
+{
+    const char *data;
+    size_t      size;
+
+    IO_Span() : data(NULL), size(0) {}
+    IO_Span(const char *_data, const size_t _size) : data(_data), size(_size) {}
+
+    inline bool         Empty() const                   { return (size == 0);   }
+    inline char         operator[](const size_t i) const { return data[i];      }
+    inline std::string  String() const                  { return std::string(data, size); }
+    inline bool         operator==(const char *s) const { return (strlen(s) == size && memcmp(data, s, size) == 0); }
+};
+
+// **************************************************************
+class IO_Reader
+/**
+ * Sequential reader of files written by IO. Plain files are mapped in
+ * memory and lines are found in place; gzip files ("z" mode, several
+ * members included, as written by "a" mode or Flush()) are inflated in
+ * a window of IO_READER_DEFAULT_BUFFER_SIZE bytes. Either way, no
+ * memory is allocated per line or record.
+ *
+ *      IO_Reader reader("output/energies.txt.gz");
+ *      IO_Span line;
+ *      while (reader.Next_Line(line))
+ *          if (line.size > 0 && line[0] != '#')
+ *              Parse(line.data, line.size);
+ *
+ * Returned spans stay valid until the next call on a compressed file,
+ * until Close() on a plain one.
+ *
+ * Files written in "index" mode can be read from any offset or time
+ * with Seek_Offset() and Seek_Time(): inflating starts at the previous
+ * restart point found in the sidecar index, so at most one interval is
+ * inflated to get there.
+ */
+{
+    private:
+        std::string filename;
+        int fd;
+        bool compressed;
+
+        // Plain file: mapped once
+        char *map;
+        size_t map_size;
+
+        // gzip file: zlib stream (zlib.h is only included by the .cpp)
+        void *stream;
+        std::vector<char> input;    // Compressed bytes, read from the file
+        std::vector<char> output;   // Inflated bytes: the window
+        bool input_done;            // End of file reached
+        bool stream_done;           // Everything inflated
+        bool in_member;             // Inside a gzip member (truncation check)
+        bool raw_deflate;           // Inflating raw deflate from a restart point
+        int trailer_left;           // Bytes of a gzip trailer still to skip after raw deflate
+        IO_Gzip_Index index;        // Loaded by the first seek
+        bool index_loaded;
+
+        // Window of data not consumed yet
+        const char *pos;
+        const char *end;
+        size_t scanned;             // Bytes after pos known not to hold '\n'
+
+        bool Refill();
+        void Load_Index();
+        void Restart_At(const int entry);
+
+    public:
+        IO_Reader();
+        IO_Reader(const std::string _filename, const size_t buffer_size = IO_READER_DEFAULT_BUFFER_SIZE);
+        ~IO_Reader();
+        void Open(const std::string _filename, const size_t buffer_size = IO_READER_DEFAULT_BUFFER_SIZE);
+        void Close();
+
+        bool Next_Line(IO_Span &line);
+        bool Read(IO_Span &span, const size_t size);
+        void Read_All(IO_Span &span);
+        bool Next_Record(IO_Record_Header &header, IO_Span &data);
+
+        bool Seek_Offset(const uint64_t offset);
+        bool Seek_Time(const double time);
+
+        inline bool Is_Open()       { return (fd != -1);   }
+        inline bool Is_Compressed() { return compressed;    }
+};
+
+#endif // INC_IO_READER_hpp
+
+// ********** End of file ***************************************
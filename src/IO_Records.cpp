@@ -0,0 +1,172 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy()
+#include <algorithm> // std::swap()
+
+#include <StdCout.hpp>
+
+#include "IO_Records.hpp"
+
+// **************************************************************
+bool IO_Is_Host_Big_Endian()
+{
+    const uint16_t one = 1;
+    return (*((const char *) &one) == 0);
+}
+
+// **************************************************************
+void IO_Swap_Bytes(char *p, const size_t element_size, const size_t count)
+/**
+ * Reverse the bytes of "count" consecutive elements, in place.
+ */
+{
+    if (element_size <= 1)
+        return;
+
+    for (size_t i = 0 ; i < count ; i++)
+    {
+        char *element = p + i*element_size;
+        for (size_t b = 0 ; b < element_size/2 ; b++)
+            std::swap(element[b], element[element_size-1-b]);
+    }
+}
+
+// **************************************************************
+bool IO_Parse_Record_Header(const char *raw, IO_Record_Header &header)
+/**
+ * Decode the IO_RECORD_HEADER_SIZE bytes of a record header.
+ * @return false if they are not a valid header
+ */
+{
+    header.kind         = raw[0];
+    header.element_size = uint8_t(raw[1]);
+    header.order        = raw[2];
+    header.version      = uint8_t(raw[3]);
+    if (header.version != IO_RECORD_VERSION || (header.order != 'L' && header.order != 'B'))
+        return false;
+
+    memcpy(&header.count, raw + 4, sizeof(uint32_t));
+    if ((header.order == 'B') != IO_Is_Host_Big_Endian())
+        IO_Swap_Bytes((char *) &header.count, sizeof(uint32_t), 1);
+
+    return true;
+}
+
+// **************************************************************
+IO_Record_Reader::IO_Record_Reader()
+{
+    fh              = NULL;
+    data_pending    = false;
+}
+
+// **************************************************************
+IO_Record_Reader::IO_Record_Reader(const std::string _filename)
+{
+    fh              = NULL;
+    data_pending    = false;
+    Open(_filename);
+}
+
+// **************************************************************
+IO_Record_Reader::~IO_Record_Reader()
+{
+    Close();
+}
+
+// **************************************************************
+void IO_Record_Reader::Open(const std::string _filename)
+{
+    assert(fh == NULL);
+
+    filename = _filename;
+    fh = fopen(filename.c_str(), "rb");
+    if (fh == NULL)
+    {
+        std_cout << "ERROR: Could not open file '" << filename << "' for reading records. Aborting.\n" << std::flush;
+        abort();
+    }
+    data_pending = false;
+}
+
+// **************************************************************
+void IO_Record_Reader::Close()
+{
+    if (fh != NULL)
+        fclose(fh);
+    fh = NULL;
+}
+
+// **************************************************************
+bool IO_Record_Reader::Next(IO_Record_Header &_header)
+/**
+ * Read the next record's header. Data not consumed by Read() is skipped.
+ * @return false at end of file
+ */
+{
+    assert(fh != NULL);
+
+    if (data_pending)
+        Skip();
+
+    char raw[IO_RECORD_HEADER_SIZE];
+    const size_t nb_read = fread(raw, 1, IO_RECORD_HEADER_SIZE, fh);
+    if (nb_read == 0)
+        return false;
+    if (nb_read != IO_RECORD_HEADER_SIZE)
+    {
+        std_cout << "ERROR: Truncated record header in file '" << filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    if (!IO_Parse_Record_Header(raw, header))
+    {
+        std_cout << "ERROR: Invalid record header in file '" << filename << "' (not written by IO::Write<T>()?). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    data_pending = true;
+    _header = header;
+
+    return true;
+}
+
+// **************************************************************
+void IO_Record_Reader::Skip()
+{
+    assert(fh != NULL);
+    if (!data_pending)
+        return;
+
+    fseek(fh, long(header.count) * long(header.element_size), SEEK_CUR);
+    data_pending = false;
+}
+
+// **************************************************************
+void IO_Record_Reader::Read_Data(char *p, const char kind, const size_t element_size)
+{
+    assert(fh != NULL);
+    assert(data_pending);
+
+    if (kind != header.kind || element_size != header.element_size)
+    {
+        std_cout
+            << "ERROR: Record in file '" << filename << "' contains '" << header.kind << "' values of "
+            << int(header.element_size) << " bytes, but '" << kind << "' values of "
+            << element_size << " bytes were requested. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    const size_t nb_bytes = size_t(header.count) * element_size;
+    if (nb_bytes > 0 && fread(p, 1, nb_bytes, fh) != nb_bytes)
+    {
+        std_cout << "ERROR: Truncated record in file '" << filename << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    if ((header.order == 'B') != IO_Is_Host_Big_Endian())
+        IO_Swap_Bytes(p, element_size, header.count);
+
+    data_pending = false;
+}
+
+// ********** End of file ***************************************
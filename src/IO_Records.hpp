@@ -0,0 +1,119 @@
+#ifndef INC_IO_RECORDS_hpp
+#define INC_IO_RECORDS_hpp
+
+#include <cstdio>
+#include <cstddef> // size_t, ptrdiff_t
+#include <string>
+#include <vector>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// Byte order of typed binary records (see IO::Write<T>())
+enum IO_Endianness
+{
+    IO_Native_Endian = 0,
+    IO_Little_Endian = 1,
+    IO_Big_Endian    = 2
+};
+
+// **************************************************************
+// Kind of value stored in a record: signed ('i') or unsigned ('u')
+// integer, floating point ('f') or character ('c'). Together with the
+// element size, this describes the type portably.
+// Types without a specialization can't be written as typed records.
+template <class T> struct IO_Type_Kind;
+template <> struct IO_Type_Kind<char>           { static const char value = 'c'; };
+template <> struct IO_Type_Kind<signed char>    { static const char value = 'i'; };
+template <> struct IO_Type_Kind<unsigned char>  { static const char value = 'u'; };
+template <> struct IO_Type_Kind<short>          { static const char value = 'i'; };
+template <> struct IO_Type_Kind<unsigned short> { static const char value = 'u'; };
+template <> struct IO_Type_Kind<int>            { static const char value = 'i'; };
+template <> struct IO_Type_Kind<unsigned int>   { static const char value = 'u'; };
+template <> struct IO_Type_Kind<long>           { static const char value = 'i'; };
+template <> struct IO_Type_Kind<unsigned long>  { static const char value = 'u'; };
+template <> struct IO_Type_Kind<float>          { static const char value = 'f'; };
+template <> struct IO_Type_Kind<double>         { static const char value = 'f'; };
+
+// **************************************************************
+// Record header, 8 bytes on disk:
+//      [0]   kind ('i', 'u', 'f' or 'c')
+//      [1]   element size (bytes)
+//      [2]   byte order of the data and count ('L' or 'B')
+//      [3]   header version (1)
+//      [4-7] number of elements (uint32, in the record's byte order)
+#define IO_RECORD_HEADER_SIZE   8
+#define IO_RECORD_VERSION       1
+#define IO_RECORD_MAX_COUNT     0xFFFFFFFFul
+
+struct IO_Record_Header
+{
+    char        kind;
+    uint8_t     element_size;
+    char        order;
+    uint8_t     version;
+    uint32_t    count;
+};
+
+// **************************************************************
+// View of every "stride" bytes, e.g. one member of an array of structs:
+//      IO_Strided<double>(&particles[0].x, N, sizeof(Particle))
+template <class T>
+struct IO_Strided
+{
+    const T    *first;
+    size_t      count;
+    ptrdiff_t   stride;     // In bytes
+    IO_Strided(const T *_first, const size_t _count, const ptrdiff_t _stride)
+        : first(_first), count(_count), stride(_stride) {}
+};
+
+bool IO_Is_Host_Big_Endian();
+void IO_Swap_Bytes(char *p, const size_t element_size, const size_t count);
+bool IO_Parse_Record_Header(const char *raw, IO_Record_Header &header);
+
+// **************************************************************
+class IO_Record_Reader
+/**
+ * Read back typed records written by IO::Write<T>(), on any host:
+ * values are converted to the host's byte order.
+ *
+ *      IO_Record_Reader reader("output/particles.bin");
+ *      IO_Record_Header header;
+ *      std::vector<double> x;
+ *      while (reader.Next(header))
+ *          reader.Read(x);
+ */
+{
+    private:
+        std::string filename;
+        FILE *fh;
+        IO_Record_Header header;
+        bool data_pending;      // Current record's data not yet consumed
+
+        void Read_Data(char *p, const char kind, const size_t element_size);
+
+    public:
+        IO_Record_Reader();
+        IO_Record_Reader(const std::string _filename);
+        ~IO_Record_Reader();
+        void Open(const std::string _filename);
+        void Close();
+        bool Next(IO_Record_Header &_header);
+        void Skip();
+
+        template <class T>
+        void Read(std::vector<T> &values)
+        {
+            values.resize(header.count);
+            Read_Data((values.empty() ? NULL : (char *) &values[0]), IO_Type_Kind<T>::value, sizeof(T));
+        }
+};
+
+#endif // INC_IO_RECORDS_hpp
+
+// ********** End of file ***************************************
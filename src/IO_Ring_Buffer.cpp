@@ -0,0 +1,264 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy(), strerror()
+#include <cstdio>   // snprintf()
+#include <cerrno>
+#include <algorithm> // std::min(), std::max()
+#include <fcntl.h>  // open()
+#include <unistd.h> // write(), close()
+
+#include <StdCout.hpp>
+
+#include "IO_Ring_Buffer.hpp"
+
+// **************************************************************
+static bool Write_All(const int fd, const char *p, size_t size)
+/**
+ * write() until done. Async-signal-safe.
+ */
+{
+    while (size > 0)
+    {
+        const ssize_t written = write(fd, p, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        p    += written;
+        size -= size_t(written);
+    }
+    return true;
+}
+
+// **************************************************************
+IO_Ring_Buffer::IO_Ring_Buffer()
+{
+    append      = false;
+    text        = true;
+    nb_dumps    = 0;
+    capacity    = 0;
+    first       = 0;
+    nb_records  = 0;
+    max_records = 0;
+    period      = 0.0;
+    time        = 0.0;
+    head        = 0;
+    tail        = 0;
+    nb_dropped  = 0;
+}
+
+// **************************************************************
+IO_Ring_Buffer::~IO_Ring_Buffer()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Ring_Buffer::Open(const std::string &_filename, const bool _append, const bool _text,
+                          const size_t _max_records, const double _period,
+                          const size_t _capacity)
+/**
+ * Nothing is written to the file until the first dump.
+ */
+{
+    assert(_capacity > 0);
+    assert(_period >= 0.0);
+
+    filename    = _filename;
+    append      = _append;
+    text        = _text;
+    nb_dumps    = 0;
+    capacity    = _capacity;
+    max_records = _max_records;
+    period      = _period;
+    time        = 0.0;
+    first       = 0;
+    nb_records  = 0;
+    head        = 0;
+    tail        = 0;
+    nb_dropped  = 0;
+
+    buffer.resize(capacity);
+    // Without a record limit, assume records of 32 bytes on average.
+    records.resize(max_records > 0 ? max_records : std::max(size_t(1024), capacity / 32));
+
+    IO_Emergency_Register(this);
+    return true;
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Evict_Oldest()
+{
+    assert(nb_records > 0);
+
+    head  = records[first].start + records[first].size;
+    first = (first + 1) % records.size();
+    nb_records--;
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Write(const char *p, const size_t size)
+{
+    if (size > capacity)
+    {
+        nb_dropped++;
+        return;
+    }
+
+    // Make room: too old first, then too many or too large.
+    if (period > 0.0)
+    {
+        while (nb_records > 0 && records[first].time < time - period)
+            Evict_Oldest();
+    }
+    while (nb_records > 0 && (nb_records == records.size() || tail + size - head > capacity))
+        Evict_Oldest();
+
+    const size_t position   = size_t(tail % capacity);
+    const size_t first_part = std::min(size, capacity - position);
+    memcpy(&buffer[position], p, first_part);
+    if (first_part < size)
+        memcpy(&buffer[0], p + first_part, size - first_part);
+
+    Record &record  = records[(first + nb_records) % records.size()];
+    record.start    = tail;
+    record.size     = size;
+    record.time     = time;
+    nb_records++;
+    tail += size;
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Flush()
+/**
+ * Nothing to do: only dumps write to the file.
+ */
+{
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Close()
+/**
+ * The content is discarded: dump it first if it is needed.
+ */
+{
+    if (buffer.empty())
+        return;
+
+    IO_Emergency_Unregister(this);
+    std::vector<char>().swap(buffer);
+    std::vector<Record>().swap(records);
+    nb_records = 0;
+}
+
+// **************************************************************
+int IO_Ring_Buffer::Open_For_Dump()
+/**
+ * The first dump replaces the file, unless opened with "a".
+ * Async-signal-safe.
+ */
+{
+    const int flags = O_WRONLY | O_CREAT | O_APPEND | ((nb_dumps == 0 && !append) ? O_TRUNC : 0);
+    nb_dumps++;
+    return open(filename.c_str(), flags, 0644);
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Write_Content(const int fd)
+/**
+ * Async-signal-safe.
+ */
+{
+    if (nb_records == 0)
+        return;
+
+    const size_t size       = size_t(tail - head);
+    const size_t position   = size_t(head % capacity);
+    const size_t first_part = std::min(size, capacity - position);
+    Write_All(fd, &buffer[position], first_part);
+    Write_All(fd, &buffer[0], size - first_part);
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Dump(const std::string &reason)
+/**
+ * Append the records kept to the file, then forget them.
+ */
+{
+    if (buffer.empty())
+        return;
+
+    const int fd = Open_For_Dump();
+    if (fd == -1)
+    {
+        std_cout << "ERROR: Could not open file '" << filename << "' to dump the flight recorder: " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    if (text)
+    {
+        char header[512];
+        int length;
+        if (nb_records == 0)
+            length = snprintf(header, sizeof(header), "# Flight recorder dump (%s): no records\n", reason.c_str());
+        else
+            length = snprintf(header, sizeof(header), "# Flight recorder dump (%s): %lu records, time %.17g to %.17g\n",
+                              reason.c_str(), (unsigned long) nb_records,
+                              records[first].time, records[(first + nb_records - 1) % records.size()].time);
+        Write_All(fd, header, std::min(size_t(length), sizeof(header) - 1));
+    }
+    Write_Content(fd);
+    close(fd);
+
+    head        = tail;
+    first       = 0;
+    nb_records  = 0;
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Dump_From_Signal(const int signal_number)
+/**
+ * Dump() with system calls only: no allocation, no lock, no stdio.
+ * The ring is left as is.
+ */
+{
+    if (buffer.empty())
+        return;
+
+    const int fd = Open_For_Dump();
+    if (fd == -1)
+        return;
+
+    if (text)
+    {
+        char header[64] = "# Flight recorder dump (signal ";
+        size_t length = strlen(header);
+        char digits[16];
+        int nb_digits = 0;
+        int n = signal_number;
+        do
+        {
+            digits[nb_digits++] = char('0' + n % 10);
+            n /= 10;
+        } while (n > 0 && nb_digits < 15);
+        while (nb_digits > 0)
+            header[length++] = digits[--nb_digits];
+        header[length++] = ')';
+        header[length++] = '\n';
+        Write_All(fd, header, length);
+    }
+    Write_Content(fd);
+    close(fd);
+}
+
+// **************************************************************
+void IO_Ring_Buffer::Emergency_Flush(const int signal_number, const bool)
+/**
+ * What was not dumped is lost at a normal exit, as with Close().
+ */
+{
+    if (signal_number != 0)
+        Dump_From_Signal(signal_number);
+}
+
+// ********** End of file ***************************************
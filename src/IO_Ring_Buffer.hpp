@@ -0,0 +1,87 @@
+#ifndef INC_IO_RING_BUFFER_hpp
+#define INC_IO_RING_BUFFER_hpp
+
+#include <string>
+#include <vector>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+#include "IO_Emergency.hpp"
+
+// Default memory kept by a flight recorder (bytes)
+#define IO_RING_DEFAULT_BYTES (4*1024*1024)
+
+class IO_Ring_Buffer : public IO_Sink, public IO_Emergency_Client
+/**
+ * Flight recorder ("ring" mode options): writes are kept in memory,
+ * oldest first out, and only reach the file when dumped.
+ *
+ * The ring keeps at most "max_records" writes (0: no limit), those
+ * written less than "period" ago in simulation time (IO::Set_Time(),
+ * 0: no limit), and at most "capacity" bytes. Appending is a copy;
+ * nothing is allocated after Open().
+ *
+ * Dump() appends the content to the file (created by the first dump)
+ * and empties the ring. Rings are also dumped, from the signal handler
+ * and with system calls only, when the process dies from a signal (see
+ * IO_Emergency_Enable()); not at exit().
+ */
+{
+    private:
+        struct Record
+        {
+            uint64_t start;             // Offset in the stream of all writes
+            size_t size;
+            double time;
+        };
+
+        std::string filename;
+        bool append;                    // Dumps append to an existing file
+        bool text;                      // Dumps start with a '#' comment line
+        int nb_dumps;
+
+        std::vector<char> buffer;       // Byte at stream offset x is buffer[x % capacity]
+        size_t capacity;
+        std::vector<Record> records;    // Circular, records[(first + i) % records.size()]
+        size_t first;
+        size_t nb_records;
+        size_t max_records;
+        double period;
+        double time;
+        uint64_t head;                  // Stream offset of the oldest byte kept
+        uint64_t tail;                  // Stream offset of the next byte
+        uint64_t nb_dropped;            // Writes larger than the ring
+
+        void Evict_Oldest();
+        int Open_For_Dump();
+        void Write_Content(const int fd);
+
+    public:
+        IO_Ring_Buffer();
+        ~IO_Ring_Buffer();
+        bool Open(const std::string &_filename, const bool _append, const bool _text,
+                  const size_t _max_records, const double _period,
+                  const size_t _capacity = IO_RING_DEFAULT_BYTES);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+        void Dump(const std::string &reason);
+        void Dump_From_Signal(const int signal_number);
+
+        void Emergency_Flush(const int signal_number, const bool is_fatal);
+        inline bool Is_Async_Signal_Safe()          { return true;      }
+
+        inline void Set_Time(const double _time)    { time = _time;     }
+        inline size_t Get_Nb_Records()              { return nb_records; }
+        inline uint64_t Get_Nb_Dropped()            { return nb_dropped; }
+};
+
+#endif // INC_IO_RING_BUFFER_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,225 @@
+
+#include <cmath>    // std::floor()
+#include <algorithm> // std::push_heap(), std::pop_heap(), std::find()
+
+#include <StdCout.hpp>
+
+#include "InputOutput.hpp"
+#include "IO_Scheduler.hpp"
+
+// **************************************************************
+IO_Scheduler::IO_Scheduler()
+{
+    nb_streams  = 0;
+    nb_calls    = 0;
+}
+
+// **************************************************************
+IO_Scheduler::~IO_Scheduler()
+{
+    for (size_t i = 0 ; i < streams.size() ; i++)
+    {
+        if (streams[i].io != NULL)
+        {
+            streams[i].io->scheduler       = NULL;
+            streams[i].io->scheduler_index = -1;
+        }
+    }
+}
+
+// **************************************************************
+void IO_Scheduler::Add(IO *io)
+{
+    assert(io != NULL);
+    assert(io->scheduler == NULL);
+
+    int index;
+    if (!free_slots.empty())
+    {
+        index = free_slots.back();
+        free_slots.pop_back();
+    }
+    else
+    {
+        index = int(streams.size());
+        streams.push_back(Stream());
+        streams[index].version = 0;
+    }
+
+    Stream &stream  = streams[index];
+    stream.io       = io;
+    stream.pending  = false;
+    stream.always   = false;
+    stream.checked  = nb_calls - 1;
+
+    io->scheduler       = this;
+    io->scheduler_index = index;
+    nb_streams++;
+
+    Schedule(index);
+}
+
+// **************************************************************
+void IO_Scheduler::Remove(IO *io)
+{
+    assert(io != NULL);
+    assert(io->scheduler == this);
+
+    const int index = io->scheduler_index;
+    Stream &stream = streams[index];
+
+    if (stream.always)
+        always.erase(std::find(always.begin(), always.end(), index));
+    if (stream.pending)
+        pending.erase(std::find(pending.begin(), pending.end(), index));
+
+    stream.io       = NULL;
+    stream.version++;               // Its heap entries are now stale
+    stream.pending  = false;
+    stream.always   = false;
+    free_slots.push_back(index);
+
+    io->scheduler       = NULL;
+    io->scheduler_index = -1;
+    nb_streams--;
+}
+
+// **************************************************************
+void IO_Scheduler::Notify(IO *io)
+/**
+ * Called by IO when its state changes outside of Is_Output_Permitted():
+ * the stream is checked and rescheduled at the next call to Due().
+ */
+{
+    assert(io->scheduler == this);
+
+    Stream &stream = streams[io->scheduler_index];
+    if (!stream.pending)
+    {
+        stream.pending = true;
+        pending.push_back(io->scheduler_index);
+    }
+}
+
+// **************************************************************
+void IO_Scheduler::Schedule(const int index)
+/**
+ * (Re)compute when a stream must next be checked.
+ */
+{
+    Stream &stream = streams[index];
+    stream.version++;
+    if (stream.always)
+    {
+        always.erase(std::find(always.begin(), always.end(), index));
+        stream.always = false;
+    }
+
+    IO *io = stream.io;
+    if (!io->Is_Enable())
+        return;
+
+    const double period = io->Get_Period();
+
+    // Period of -2: output only when forced (see Notify())
+    if (-2.001 < period && period < -1.999)
+        return;
+
+    // Period of -1 (or any other non-positive period): check every call
+    if (period < 0.0)
+    {
+        stream.always = true;
+        always.push_back(index);
+        return;
+    }
+
+    // First multiple of the period after the last save (which is not a
+    // multiple if the period changed). Is_Output_Permitted() has the
+    // final word, so err on the early side.
+    const double last_saved_time = io->Get_Last_Saved_Time();
+    double nb_periods = std::floor(last_saved_time / period) + 1.0;
+    while (nb_periods * period <= last_saved_time)
+        nb_periods += 1.0;
+    while ((nb_periods - 1.0) * period > last_saved_time)
+        nb_periods -= 1.0;
+    Entry entry;
+    entry.due       = nb_periods * period * (1.0 - 1.0e-12);
+    entry.stream    = index;
+    entry.version   = stream.version;
+    heap.push_back(entry);
+    std::push_heap(heap.begin(), heap.end());
+}
+
+// **************************************************************
+void IO_Scheduler::Check(const int index, const double time)
+{
+    Stream &stream = streams[index];
+    if (stream.checked == nb_calls)
+        return;
+    stream.checked = nb_calls;
+
+    if (stream.io->Is_Output_Permitted(time))
+        due.push_back(stream.io);
+}
+
+// **************************************************************
+const std::vector<IO *> & IO_Scheduler::Due(const double time)
+/**
+ * Return the streams which must output at "time". As with
+ * Is_Output_Permitted(), call it once per time step.
+ */
+{
+    nb_calls++;
+    due.clear();
+
+    // Initial save: Is_Output_Permitted() accepts every stream.
+    if (time < 1.0e-36)
+    {
+        for (size_t i = 0 ; i < pending.size() ; i++)
+        {
+            streams[pending[i]].pending = false;
+            Schedule(pending[i]);
+        }
+        pending.clear();
+        for (size_t i = 0 ; i < streams.size() ; i++)
+        {
+            if (streams[i].io != NULL)
+                Check(int(i), time);
+        }
+        return due;
+    }
+
+    // Forced, disabled or modified streams
+    for (size_t i = 0 ; i < pending.size() ; i++)
+    {
+        const int index = pending[i];
+        streams[index].pending = false;
+        Check(index, time);
+        Schedule(index);
+    }
+    pending.clear();
+
+    for (size_t i = 0 ; i < always.size() ; i++)
+        Check(always[i], time);
+
+    reschedule.clear();
+    while (!heap.empty() && heap.front().due <= time)
+    {
+        std::pop_heap(heap.begin(), heap.end());
+        const Entry entry = heap.back();
+        heap.pop_back();
+
+        const Stream &stream = streams[entry.stream];
+        if (stream.io == NULL || stream.version != entry.version)
+            continue;
+
+        Check(entry.stream, time);
+        reschedule.push_back(entry.stream);
+    }
+    for (size_t i = 0 ; i < reschedule.size() ; i++)
+        Schedule(reschedule[i]);
+
+    return due;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,81 @@
+#ifndef INC_IO_SCHEDULER_hpp
+#define INC_IO_SCHEDULER_hpp
+
+#include <vector>
+
+class IO;
+
+class IO_Scheduler
+/**
+ * Find which of many registered IO objects must output at a given time,
+ * without calling Is_Output_Permitted() on each of them every step.
+ *
+ * Periodic streams are kept in a min-heap ordered by their next due
+ * time; only streams at the top of the heap are checked, each in
+ * O(log n). The final decision is always Is_Output_Permitted()'s,
+ * so its semantics are kept exactly:
+ *      - Period -1: always checked (kept in a separate list).
+ *      - Period -2: only output when forced.
+ *      - Force_At_Next_Iteration(), Disable_At_Next_Iteration(),
+ *        Set_Period(), Enable() and Disable() notify the scheduler so
+ *        the stream is checked at the next call to Due().
+ *      - At time 0, every stream is checked.
+ *
+ *      IO_Scheduler scheduler;
+ *      scheduler.Add(&energies);
+ *      scheduler.Add(&positions);
+ *      for (time = 0.0 ; time < tmax ; time += dt)
+ *      {
+ *          const std::vector<IO *> &due = scheduler.Due(time);
+ *          for (size_t i = 0 ; i < due.size() ; i++)
+ *              Save(due[i]);
+ *      }
+ *
+ * An IO object can be registered in a single scheduler; it is removed
+ * automatically when destroyed.
+ */
+{
+    private:
+        struct Stream
+        {
+            IO *io;             // NULL if the slot is free
+            unsigned version;   // Heap entries of older versions are stale
+            bool pending;       // Check at next Due()
+            bool always;        // In the "always" list
+            unsigned checked;   // Call to Due() which last checked it
+        };
+        struct Entry
+        {
+            double due;
+            int stream;
+            unsigned version;
+            bool operator<(const Entry &other) const { return due > other.due; } // Min-heap
+        };
+
+        std::vector<Stream> streams;
+        std::vector<int> free_slots;
+        std::vector<Entry> heap;
+        std::vector<int> always;        // Streams checked at every call
+        std::vector<int> pending;       // Streams notified since last call
+        std::vector<int> reschedule;
+        std::vector<IO *> due;
+        int nb_streams;
+        unsigned nb_calls;
+
+        void Schedule(const int index);
+        void Check(const int index, const double time);
+
+    public:
+        IO_Scheduler();
+        ~IO_Scheduler();
+        void Add(IO *io);
+        void Remove(IO *io);
+        void Notify(IO *io);
+        const std::vector<IO *> & Due(const double time);
+
+        inline int Get_Nb_Streams()     { return nb_streams; }
+};
+
+#endif // INC_IO_SCHEDULER_hpp
+
+// ********** End of file ***************************************
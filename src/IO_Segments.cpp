@@ -0,0 +1,568 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // strerror()
+#include <cerrno>
+#include <cmath>    // std::floor()
+#include <fstream>
+#include <fcntl.h>  // open()
+#include <unistd.h> // read(), close(), unlink()
+#include <sys/stat.h>
+
+#include <StdCout.hpp>
+
+#include "IO_Segments.hpp"
+#include "IO_Parallel_Compressor.hpp"
+#include "IO_Text_Parser.hpp"
+
+// **************************************************************
+static bool File_Exists(const std::string &path)
+{
+    struct stat status;
+    return (stat(path.c_str(), &status) == 0);
+}
+
+// **************************************************************
+static bool Has_Suffix(const std::string &s, const std::string &suffix)
+{
+    return (s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+// **************************************************************
+std::string IO_Segment_Filename(const std::string &filename, const int index)
+/**
+ * Number inserted before the extension: "output/energies.txt" gives
+ * "output/energies.000003.txt" for index 3.
+ */
+{
+    char number[32];
+    sprintf(number, ".%06d", index);
+
+    const size_t slash      = filename.rfind('/');
+    const size_t basename   = (slash == std::string::npos ? 0 : slash+1);
+    const size_t dot        = filename.rfind('.');
+    if (dot == std::string::npos || dot <= basename)
+        return filename + number;
+    return filename.substr(0, dot) + number + filename.substr(dot);
+}
+
+// **************************************************************
+bool IO_Load_Manifest(const std::string &manifest_filename, std::vector<IO_Segment> &segments)
+/**
+ * @return false if there is no manifest
+ */
+{
+    segments.clear();
+
+    struct stat status;
+    if (stat(manifest_filename.c_str(), &status) != 0)
+        return false;
+    if (status.st_size == 0)
+        return true;
+
+    IO_Reader reader(manifest_filename);
+    IO_Span line;
+    while (reader.Next_Line(line))
+    {
+        if (line.Empty() || line[0] == '#')
+            continue;
+
+        // "bytes first_time last_time filename": the file name may hold spaces.
+        const char *fields[4];
+        const char *p   = line.data;
+        const char *end = line.data + line.size;
+        int nb_fields = 0;
+        while (nb_fields < 4 && p < end)
+        {
+            fields[nb_fields++] = p;
+            if (nb_fields < 4)
+            {
+                p = (const char *) memchr(p, ' ', size_t(end - p));
+                if (p == NULL)
+                    break;
+                p++;
+            }
+        }
+        if (nb_fields != 4 || fields[3] >= end)
+        {
+            std_cout << "ERROR: Invalid line in manifest '" << manifest_filename << "': '" << line.String() << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+
+        IO_Segment segment;
+        segment.bytes       = 0;
+        for (const char *digit = fields[0] ; *digit >= '0' && *digit <= '9' ; digit++)
+            segment.bytes   = 10*segment.bytes + uint64_t(*digit - '0');
+        segment.first_time  = IO_Parse_Double(fields[1], fields[2] - 1);
+        segment.last_time   = IO_Parse_Double(fields[2], fields[3] - 1);
+        segment.filename    = std::string(fields[3], size_t(end - fields[3]));
+        segments.push_back(segment);
+    }
+
+    return true;
+}
+
+// **************************************************************
+IO_Rotating_Writer::IO_Rotating_Writer()
+{
+    max_bytes       = 0;
+    period          = 0.0;
+    codec           = NULL;
+    fh              = NULL;
+    segment_bytes   = 0;
+    time            = 0.0;
+    last_time       = 0.0;
+    is_open         = false;
+    quit            = false;
+    has_thread      = false;
+    first_new_segment = 0;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond_job, NULL);
+}
+
+// **************************************************************
+IO_Rotating_Writer::~IO_Rotating_Writer()
+{
+    Close();
+
+    pthread_cond_destroy(&cond_job);
+    pthread_mutex_destroy(&mutex);
+}
+
+// **************************************************************
+bool IO_Rotating_Writer::Open(const std::string &_filename, const bool append,
+                              const uint64_t _max_bytes, const double _period, IO_Codec *_codec)
+/**
+ * Takes ownership of the codec, even on failure. When appending, the
+ * numbering goes on after the manifest's segments, and those left
+ * uncompressed (e.g. by a crash) are compressed.
+ */
+{
+    assert(!is_open);
+    assert(_period >= 0.0);
+
+    if (codec != NULL)
+        delete codec;
+    codec               = _codec;
+    filename            = _filename;
+    manifest_filename   = filename + IO_SEGMENTS_MANIFEST_EXTENSION;
+    max_bytes           = _max_bytes;
+    period              = _period;
+    segment_bytes       = 0;
+    time                = 0.0;
+    last_time           = 0.0;
+    quit                = false;
+    jobs.clear();
+    segments.clear();
+
+    if (append)
+        IO_Load_Manifest(manifest_filename, segments);
+    first_new_segment = segments.size();
+
+    if (codec != NULL)
+    {
+        for (size_t i = 0 ; i < segments.size() ; i++)
+        {
+            struct stat status;
+            if (!Has_Suffix(segments[i].filename, codec->Extension()) && stat(segments[i].filename.c_str(), &status) == 0)
+            {
+                segments[i].bytes = uint64_t(status.st_size);
+                jobs.push_back(i);
+            }
+        }
+    }
+
+    if (!Write_Manifest())
+        return false;
+
+    fh_buffer.resize(1024*1024);
+
+    if (codec != NULL)
+    {
+        if (pthread_create(&thread, NULL, IO_Rotating_Writer::Thread_Main, (void *) this) != 0)
+        {
+            std_cout << "ERROR: Could not create compression thread for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        has_thread = true;
+    }
+
+    is_open = true;
+    return true;
+}
+
+// **************************************************************
+bool IO_Rotating_Writer::Write_Manifest()
+/**
+ * Written to a temporary file then renamed, so readers always see a
+ * complete manifest. The mutex must be held (or the thread not started).
+ * @return false if the manifest could not be written
+ */
+{
+    const std::string temporary = manifest_filename + ".tmp";
+    std::ofstream manifest(temporary.c_str());
+    if (!manifest.is_open())
+        return false;
+
+    manifest.precision(17);
+    manifest << "# Segments of '" << filename << "': bytes first_time last_time filename\n";
+    for (size_t i = 0 ; i < segments.size() ; i++)
+        manifest << segments[i].bytes << ' ' << segments[i].first_time << ' ' << segments[i].last_time << ' ' << segments[i].filename << '\n';
+    manifest.close();
+
+    if (manifest.fail() || rename(temporary.c_str(), manifest_filename.c_str()) != 0)
+    {
+        std_cout << "ERROR: Could not write manifest '" << manifest_filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    return true;
+}
+
+// **************************************************************
+bool IO_Rotating_Writer::Must_Rotate(const size_t size)
+{
+    if (segment_bytes == 0)
+        return false;
+    if (max_bytes > 0 && segment_bytes + size > max_bytes)
+        return true;
+    // Index of the period each time falls in
+    if (period > 0.0 && int64_t(std::floor(time / period)) != int64_t(std::floor(segments.back().first_time / period)))
+        return true;
+    return false;
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Open_Segment()
+{
+    const std::string name = IO_Segment_Filename(filename, int(segments.size()));
+    fh = fopen(name.c_str(), "wb");
+    if (fh == NULL)
+    {
+        std_cout << "ERROR: Could not open segment '" << name << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    setvbuf(fh, &fh_buffer[0], _IOFBF, fh_buffer.size());
+    segment_bytes = 0;
+
+    IO_Segment segment;
+    segment.filename    = name;
+    segment.bytes       = 0;
+    segment.first_time  = time;
+    segment.last_time   = time;
+
+    pthread_mutex_lock(&mutex);
+    segments.push_back(segment);
+    Write_Manifest();
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Close_Segment()
+/**
+ * Close the live segment and queue it for compression.
+ */
+{
+    if (fclose(fh) != 0)
+    {
+        std_cout << "ERROR: Could not close segment '" << segments.back().filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    fh = NULL;
+
+    pthread_mutex_lock(&mutex);
+    segments.back().bytes       = segment_bytes;
+    segments.back().last_time   = last_time;
+    if (codec != NULL)
+    {
+        jobs.push_back(segments.size()-1);
+        pthread_cond_signal(&cond_job);
+    }
+    Write_Manifest();
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Write(const char *p, const size_t size)
+{
+    assert(is_open);
+
+    if (fh == NULL)
+    {
+        Open_Segment();
+    }
+    else if (Must_Rotate(size))
+    {
+        Close_Segment();
+        Open_Segment();
+    }
+
+    if (size > 0 && fwrite(p, 1, size, fh) != size)
+    {
+        std_cout << "ERROR: Could not write to segment '" << segments.back().filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    segment_bytes += size;
+    last_time = time;
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Flush()
+{
+    if (fh != NULL)
+        fflush(fh);
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Close()
+/**
+ * Waits until every segment is compressed.
+ */
+{
+    if (!is_open)
+        return;
+
+    if (fh != NULL)
+        Close_Segment();
+
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&cond_job);
+    pthread_mutex_unlock(&mutex);
+
+    if (has_thread)
+        pthread_join(thread, NULL);
+    has_thread = false;
+
+    if (codec != NULL)
+        delete codec;
+    codec = NULL;
+    fh_buffer.clear();
+    is_open = false;
+}
+
+// **************************************************************
+int64_t IO_Rotating_Writer::Get_Physical_Bytes()
+/**
+ * Size of the segments started since Open(), compressed if Close()
+ * was called. The base name itself is never written.
+ */
+{
+    int64_t bytes = 0;
+    pthread_mutex_lock(&mutex);
+    for (size_t i = first_new_segment ; i < segments.size() ; i++)
+    {
+        struct stat status;
+        if (stat(segments[i].filename.c_str(), &status) == 0)
+            bytes += int64_t(status.st_size);
+    }
+    pthread_mutex_unlock(&mutex);
+    return bytes;
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Compress_Segment(const size_t index)
+/**
+ * Compress a closed segment into "name.gz" (or the codec's extension),
+ * then list it in the manifest and remove the uncompressed file.
+ */
+{
+    pthread_mutex_lock(&mutex);
+    const std::string source = segments[index].filename;
+    pthread_mutex_unlock(&mutex);
+
+    const std::string target    = source + codec->Extension();
+    const std::string temporary = target + ".tmp";
+
+    const int in = open(source.c_str(), O_RDONLY);
+    if (in == -1)
+    {
+        std_cout << "WARNING: Segment '" << source << "' disappeared before it could be compressed: " << strerror(errno) << ".\n";
+        return;
+    }
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if (out == NULL)
+    {
+        std_cout << "ERROR: Could not open '" << temporary << "' for writing: " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Independent frames of one block each, like IO_Parallel_Compressor
+    std::vector<char> block(IO_PARALLEL_DEFAULT_BLOCK_SIZE);
+    std::vector<char> frame;
+    bool is_first = true;
+    while (true)
+    {
+        size_t filled = 0;
+        while (filled < block.size())
+        {
+            const ssize_t nb_read = read(in, &block[filled], block.size() - filled);
+            if (nb_read < 0 && errno == EINTR)
+                continue;
+            if (nb_read < 0)
+            {
+                std_cout << "ERROR: Could not read segment '" << source << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+                abort();
+            }
+            if (nb_read == 0)
+                break;
+            filled += size_t(nb_read);
+        }
+
+        // An empty segment still gives a valid (empty) compressed file.
+        if (filled == 0 && !is_first)
+            break;
+        codec->Compress((filled == 0 ? NULL : &block[0]), filled, frame);
+        if (!frame.empty() && fwrite(&frame[0], 1, frame.size(), out) != frame.size())
+        {
+            std_cout << "ERROR: Could not write to '" << temporary << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        is_first = false;
+        if (filled < block.size())
+            break;
+    }
+    close(in);
+
+    if (fclose(out) != 0 || rename(temporary.c_str(), target.c_str()) != 0)
+    {
+        std_cout << "ERROR: Could not write '" << target << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    pthread_mutex_lock(&mutex);
+    segments[index].filename = target;
+    Write_Manifest();
+    pthread_mutex_unlock(&mutex);
+
+    unlink(source.c_str());
+}
+
+// **************************************************************
+void * IO_Rotating_Writer::Thread_Main(void *writer)
+{
+    ((IO_Rotating_Writer *) writer)->Thread_Loop();
+    return NULL;
+}
+
+// **************************************************************
+void IO_Rotating_Writer::Thread_Loop()
+{
+    pthread_mutex_lock(&mutex);
+    while (true)
+    {
+        while (jobs.empty() && !quit)
+            pthread_cond_wait(&cond_job, &mutex);
+
+        if (jobs.empty())
+            break;
+
+        const size_t index = jobs.front();
+        jobs.pop_front();
+        pthread_mutex_unlock(&mutex);
+
+        Compress_Segment(index);
+
+        pthread_mutex_lock(&mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+// **************************************************************
+IO_Segments_Reader::IO_Segments_Reader()
+{
+    next = 0;
+}
+
+// **************************************************************
+IO_Segments_Reader::IO_Segments_Reader(const std::string _filename)
+{
+    next = 0;
+    Open(_filename);
+}
+
+// **************************************************************
+void IO_Segments_Reader::Open(const std::string _filename)
+/**
+ * @param _filename     Name given to IO (the manifest is _filename.manifest)
+ */
+{
+    filename = _filename;
+    next     = 0;
+    if (!IO_Load_Manifest(filename + IO_SEGMENTS_MANIFEST_EXTENSION, segments))
+    {
+        std_cout << "ERROR: Manifest '" << filename << IO_SEGMENTS_MANIFEST_EXTENSION << "' not found (not written with 'rotate'?). Aborting.\n" << std::flush;
+        abort();
+    }
+}
+
+// **************************************************************
+void IO_Segments_Reader::Close()
+{
+    reader.Close();
+    segments.clear();
+    next = 0;
+}
+
+// **************************************************************
+bool IO_Segments_Reader::Next_Segment()
+/**
+ * @return false after the last segment
+ */
+{
+    reader.Close();
+    if (next >= segments.size())
+        return false;
+
+    const std::string listed = segments[next++].filename;
+    const char *extensions[] = {"", ".gz", ".zst", ".lz4"};
+    for (size_t i = 0 ; i < sizeof(extensions)/sizeof(extensions[0]) ; i++)
+    {
+        if (File_Exists(listed + extensions[i]))
+        {
+            reader.Open(listed + extensions[i]);
+            return true;
+        }
+    }
+
+    std_cout << "ERROR: Segment '" << listed << "' of file '" << filename << "' not found. Aborting.\n" << std::flush;
+    abort();
+    return false;
+}
+
+// **************************************************************
+bool IO_Segments_Reader::Next_Line(IO_Span &line)
+{
+    while (true)
+    {
+        if (reader.Is_Open() && reader.Next_Line(line))
+            return true;
+        if (!Next_Segment())
+            return false;
+    }
+}
+
+// **************************************************************
+bool IO_Segments_Reader::Read(IO_Span &span, const size_t size)
+{
+    while (true)
+    {
+        if (reader.Is_Open() && reader.Read(span, size))
+            return true;
+        if (!Next_Segment())
+            return false;
+    }
+}
+
+// **************************************************************
+bool IO_Segments_Reader::Next_Record(IO_Record_Header &header, IO_Span &data)
+{
+    while (true)
+    {
+        if (reader.Is_Open() && reader.Next_Record(header, data))
+            return true;
+        if (!Next_Segment())
+            return false;
+    }
+}
+
+// ********** End of file ***************************************
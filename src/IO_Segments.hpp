@@ -0,0 +1,143 @@
+#ifndef INC_IO_SEGMENTS_hpp
+#define INC_IO_SEGMENTS_hpp
+
+#include <pthread.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+#include "IO_Codec.hpp"
+#include "IO_Reader.hpp"
+
+// The segments of "energies.txt" ("energies.000000.txt", ...) are listed in "energies.txt.manifest"
+#define IO_SEGMENTS_MANIFEST_EXTENSION  ".manifest"
+
+// **************************************************************
+struct IO_Segment
+/**
+ * One line of a manifest: "bytes first_time last_time filename".
+ * Bytes and last_time of the live segment are only known once it is
+ * closed.
+ */
+{
+    std::string filename;
+    uint64_t    bytes;          // Uncompressed
+    double      first_time;     // IO::Set_Time() of its first and last writes
+    double      last_time;
+};
+
+std::string IO_Segment_Filename(const std::string &filename, const int index);
+bool IO_Load_Manifest(const std::string &manifest_filename, std::vector<IO_Segment> &segments);
+
+// **************************************************************
+class IO_Rotating_Writer : public IO_Sink
+/**
+ * Segmented output ("rotate" and "rotate_time" mode options).
+ *
+ * Writes go uncompressed to the live segment. Before a write that
+ * would take it past "max_bytes", or whose time (IO::Set_Time()) is in
+ * a later multiple of "period", the segment is closed and the next one
+ * started, so records are never split. Closed segments are compressed
+ * by a background thread, in blocks of IO_PARALLEL_DEFAULT_BLOCK_SIZE
+ * bytes (concatenated frames, readable by zcat & co), and replaced by
+ * the compressed file. The manifest is rewritten (atomically) every
+ * time a segment is started or compressed.
+ *
+ * Close() compresses the last segment too, and waits for the thread.
+ */
+{
+    private:
+        std::string filename;           // Base name, numbered by IO_Segment_Filename()
+        std::string manifest_filename;
+        uint64_t max_bytes;             // 0: no size rotation
+        double period;                  // 0: no time rotation
+        IO_Codec *codec;                // Owned. NULL: segments stay uncompressed
+
+        FILE *fh;                       // Live segment
+        std::vector<char> fh_buffer;
+        uint64_t segment_bytes;
+        double time;
+        double last_time;               // Of the last write
+        bool is_open;
+
+        // Shared with the compression thread
+        std::vector<IO_Segment> segments;
+        size_t first_new_segment;       // Segments before it were appended to
+        std::deque<size_t> jobs;        // Segments to compress
+        bool quit;
+        pthread_t thread;
+        bool has_thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t  cond_job;
+
+        bool Must_Rotate(const size_t size);
+        void Open_Segment();
+        void Close_Segment();
+        bool Write_Manifest();
+        void Compress_Segment(const size_t index);
+        static void * Thread_Main(void *writer);
+        void Thread_Loop();
+
+    public:
+        IO_Rotating_Writer();
+        ~IO_Rotating_Writer();
+        bool Open(const std::string &_filename, const bool append,
+                  const uint64_t _max_bytes, const double _period, IO_Codec *_codec);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        inline void Set_Time(const double _time)    { time = _time; }
+        int64_t Get_Physical_Bytes();
+        inline size_t Get_Nb_Segments()             { return segments.size(); }
+};
+
+// **************************************************************
+class IO_Segments_Reader
+/**
+ * Reads the segments listed in a manifest back as one stream (plain or
+ * compressed, see IO_Reader). Segments end at write boundaries, so
+ * lines and records never span two of them.
+ *
+ *      IO_Segments_Reader reader("output/energies.txt");
+ *      IO_Span line;
+ *      while (reader.Next_Line(line))
+ *          Parse(line.data, line.size);
+ *
+ * The manifest is read once, at Open(). A segment compressed since
+ * then is found under its new name.
+ */
+{
+    private:
+        std::string filename;
+        std::vector<IO_Segment> segments;
+        size_t next;                    // Next segment to open
+        IO_Reader reader;
+
+        bool Next_Segment();
+
+    public:
+        IO_Segments_Reader();
+        IO_Segments_Reader(const std::string _filename);
+        void Open(const std::string _filename);
+        void Close();
+
+        bool Next_Line(IO_Span &line);
+        bool Read(IO_Span &span, const size_t size);
+        bool Next_Record(IO_Record_Header &header, IO_Span &data);
+
+        inline const std::vector<IO_Segment> & Get_Segments() { return segments; }
+};
+
+#endif // INC_IO_SEGMENTS_hpp
+
+// ********** End of file ***************************************
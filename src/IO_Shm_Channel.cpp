@@ -0,0 +1,558 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // memcpy(), strerror()
+#include <cerrno>
+#include <sstream>
+#include <fcntl.h>  // O_* constants
+#include <unistd.h> // ftruncate(), close(), getpid()
+#include <signal.h> // kill()
+#include <sys/mman.h> // shm_open(), shm_unlink(), mmap()
+#include <sys/stat.h> // fstat()
+#include <time.h>   // nanosleep()
+
+#include <StdCout.hpp>
+
+#include "IO_Shm_Channel.hpp"
+#include "IO_Stats.hpp"
+
+// Written last, once the segment is ready to be read
+#define IO_SHM_CHANNEL_MAGIC 0x494F53484DUL
+
+struct IO_Shm_Header
+/**
+ * Start of the segment, followed by the variables' description (one
+ * text line each) and by the ring of snapshots at "data_offset".
+ * Counters only grow: slot of snapshot n is n % nb_slots.
+ */
+{
+    uint64_t magic;
+    uint64_t nb_slots;
+    uint64_t slot_size;                 // Bytes, a snapshot padded
+    uint64_t metadata_size;             // Bytes
+    uint64_t data_offset;               // Bytes from the start of the segment
+    volatile uint64_t nb_published;     // Written by the writer only
+    volatile uint64_t nb_consumed;      // Written by the reader only
+    volatile uint64_t nb_dropped;
+    volatile int32_t is_closed;
+    volatile int32_t reader_pid;        // 0: no reader attached
+    int32_t writer_pid;
+    int32_t policy;
+};
+
+// **************************************************************
+static void Back_Off(double &delay)
+/**
+ * Sleep "delay" seconds, doubling it for the next time (up to 10 ms).
+ */
+{
+    timespec duration;
+    duration.tv_sec  = 0;
+    duration.tv_nsec = long(1.0e9 * delay);
+    nanosleep(&duration, NULL);
+    delay = (2.0 * delay < 0.01 ? 2.0 * delay : 0.01);
+}
+
+// **************************************************************
+static bool Is_Alive(const int32_t pid)
+{
+    return (pid != 0 && (kill(pid_t(pid), 0) == 0 || errno == EPERM));
+}
+
+// **************************************************************
+static int32_t Live_Writer(const std::string &name)
+/**
+ * @return  the process still writing to the segment "name", or 0
+ */
+{
+    int32_t writer = 0;
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+    struct stat segment_stat;
+    if (fd != -1 && fstat(fd, &segment_stat) == 0 && size_t(segment_stat.st_size) >= sizeof(IO_Shm_Header))
+    {
+        void *segment = mmap(NULL, sizeof(IO_Shm_Header), PROT_READ, MAP_SHARED, fd, 0);
+        if (segment != MAP_FAILED)
+        {
+            const IO_Shm_Header *existing = (const IO_Shm_Header *) segment;
+            if (existing->magic == IO_SHM_CHANNEL_MAGIC && existing->is_closed == 0 && Is_Alive(existing->writer_pid))
+                writer = existing->writer_pid;
+            munmap(segment, sizeof(IO_Shm_Header));
+        }
+    }
+    if (fd != -1)
+        close(fd);
+    return writer;
+}
+
+// **************************************************************
+static size_t Align(const size_t size, const size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// **************************************************************
+IO_Shm_Channel::IO_Shm_Channel(const std::string _name, const uint64_t _nb_slots, const Policy _policy)
+{
+    name            = _name;
+    nb_slots        = _nb_slots;
+    policy          = _policy;
+    snapshot_size   = 0;
+    header          = NULL;
+    segment_size    = 0;
+    nb_published    = 0;
+    nb_dropped      = 0;
+    wait_time       = 0.0;
+    is_publishing   = false;
+
+    if (name != "" && name[0] != '/')
+        name = "/" + name;
+    assert(nb_slots > 0);
+}
+
+// **************************************************************
+IO_Shm_Channel::IO_Shm_Channel(const IO_Shm_Channel &other)
+{
+    header          = NULL;
+    is_publishing   = false;
+    *this           = other;
+}
+
+// **************************************************************
+IO_Shm_Channel & IO_Shm_Channel::operator=(const IO_Shm_Channel &other)
+/**
+ * Copy the policy and statistics, not the variables nor the segment.
+ * The segment of the channel replaced is removed.
+ */
+{
+    if (this == &other)
+        return *this;
+
+    Remove();
+
+    name            = other.name;
+    nb_slots        = other.nb_slots;
+    policy          = other.policy;
+    snapshot_size   = 0;
+    segment_size    = 0;
+    variables.clear();
+    pointers.clear();
+    nb_published    = other.nb_published;
+    nb_dropped      = other.nb_dropped;
+    wait_time       = other.wait_time;
+
+    return *this;
+}
+
+// **************************************************************
+IO_Shm_Channel::~IO_Shm_Channel()
+{
+    Remove();
+}
+
+// **************************************************************
+void IO_Shm_Channel::Add_Variable(const std::string &variable_name, const std::string &type, const size_t element_size,
+                                  const std::vector<std::string> &dim_names, const std::vector<size_t> &dim_sizes,
+                                  const std::string &units, const void *const pointer)
+/**
+ * Register an array to copy at each Publish(), before the first one
+ * (after Close(): before the first one since).
+ */
+{
+    assert(Is_Enabled());
+    assert(pointer != NULL);
+    assert(dim_names.size() == dim_sizes.size());
+
+    if (is_publishing)
+    {
+        std_cout << "ERROR: Variable '" << variable_name << "' added to shared-memory channel '" << name << "' after its first snapshot. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    if (variables.empty())
+        snapshot_size = 0;
+
+    IO_Shm_Variable variable;
+    variable.name           = variable_name;
+    variable.type           = type;
+    variable.units          = units;
+    variable.element_size   = element_size;
+    variable.dim_names      = dim_names;
+    variable.dim_sizes      = dim_sizes;
+    variable.size           = element_size;
+    for (size_t i = 0 ; i < dim_sizes.size() ; i++)
+        variable.size *= dim_sizes[i];
+    // Aligned, so that the reader can cast its copy.
+    variable.offset         = Align(snapshot_size, 8);
+    snapshot_size           = variable.offset + variable.size;
+
+    variables.push_back(variable);
+    pointers.push_back(pointer);
+}
+
+// **************************************************************
+std::string IO_Shm_Channel::Describe()
+/**
+ * @return  the variables' description stored in the segment
+ */
+{
+    std::ostringstream metadata;
+    for (size_t i = 0 ; i < variables.size() ; i++)
+    {
+        const IO_Shm_Variable &variable = variables[i];
+        metadata
+            << variable.name << "\t" << variable.type << "\t" << variable.units << "\t"
+            << variable.element_size << "\t" << variable.offset << "\t" << variable.size << "\t"
+            << variable.dim_names.size();
+        for (size_t d = 0 ; d < variable.dim_names.size() ; d++)
+            metadata << "\t" << variable.dim_names[d] << "\t" << variable.dim_sizes[d];
+        metadata << "\n";
+    }
+    return metadata.str();
+}
+
+// **************************************************************
+void IO_Shm_Channel::Create()
+/**
+ * A segment left by a dead writer of the same name is replaced; one
+ * whose writer is still running is an error.
+ */
+{
+    const int32_t writer = Live_Writer(name);
+    if (writer != 0)
+    {
+        std_cout << "ERROR: Shared-memory channel '" << name << "' is already written by process " << writer << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    const std::string description = Describe();
+
+    const uint64_t slot_size   = Align(snapshot_size > 0 ? snapshot_size : 1, 64);
+    const uint64_t data_offset = Align(sizeof(IO_Shm_Header) + description.size(), 64);
+    segment_size = size_t(data_offset + nb_slots * slot_size);
+
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 || ftruncate(fd, off_t(segment_size)) != 0)
+    {
+        std_cout << "ERROR: Could not create shared-memory channel '" << name << "' (" << segment_size << " bytes): " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    void *segment = mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
+    {
+        std_cout << "ERROR: Could not map shared-memory channel '" << name << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+
+    header = (IO_Shm_Header *) segment;
+    header->nb_slots        = nb_slots;
+    header->slot_size       = slot_size;
+    header->metadata_size   = description.size();
+    header->data_offset     = data_offset;
+    header->nb_published    = 0;
+    header->nb_consumed     = 0;
+    header->nb_dropped      = 0;
+    header->is_closed       = 0;
+    header->reader_pid      = 0;
+    header->writer_pid      = int32_t(getpid());
+    header->policy          = int32_t(policy);
+    memcpy(((char *) segment) + sizeof(IO_Shm_Header), description.data(), description.size());
+
+    __sync_synchronize();
+    header->magic = IO_SHM_CHANNEL_MAGIC;
+}
+
+// **************************************************************
+bool IO_Shm_Channel::Publish()
+/**
+ * Copy the variables into the next slot.
+ * @return  false if the snapshot was dropped
+ */
+{
+    assert(Is_Enabled());
+
+    if (header == NULL)
+    {
+        Create();
+    }
+    else if (!is_publishing)
+    {
+        // Variables added again after Close(): the reader knows the old ones.
+        const std::string description = Describe();
+        if (description.size() != header->metadata_size ||
+            memcmp(((char *) header) + sizeof(IO_Shm_Header), description.data(), description.size()) != 0)
+        {
+            std_cout << "ERROR: Variables of shared-memory channel '" << name << "' changed since its first snapshot. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+    is_publishing = true;
+
+    const uint64_t published = header->nb_published;
+    double delay = 5.0e-5;
+    double start = 0.0;
+    bool waiting = false;
+    while (published - header->nb_consumed >= nb_slots)
+    {
+        if (policy == Drop || !Is_Alive(header->reader_pid))
+        {
+            nb_dropped++;
+            header->nb_dropped = nb_dropped;
+            if (waiting)
+                wait_time += IO_Wall_Time() - start;
+            return false;
+        }
+        if (!waiting)
+        {
+            start   = IO_Wall_Time();
+            waiting = true;
+        }
+        Back_Off(delay);
+    }
+    if (waiting)
+        wait_time += IO_Wall_Time() - start;
+
+    // The slot was freed by the reader: don't write before seeing it so.
+    __sync_synchronize();
+    char *slot = ((char *) header) + header->data_offset + (published % nb_slots) * header->slot_size;
+    for (size_t i = 0 ; i < variables.size() ; i++)
+        memcpy(slot + variables[i].offset, pointers[i], variables[i].size);
+
+    __sync_synchronize();
+    header->nb_published = published + 1;
+    nb_published++;
+
+    return true;
+}
+
+// **************************************************************
+void IO_Shm_Channel::Close()
+/**
+ * Variables have to be added again before publishing anew. The segment
+ * is kept: the reader waits for the next snapshot.
+ */
+{
+    variables.clear();
+    pointers.clear();
+    is_publishing = false;
+}
+
+// **************************************************************
+void IO_Shm_Channel::Remove()
+/**
+ * Close and remove the segment: the reader's Next() returns false once
+ * it got the snapshots left in the ring.
+ */
+{
+    if (header != NULL)
+    {
+        __sync_synchronize();
+        header->is_closed = 1;
+        munmap((void *) header, segment_size);
+        shm_unlink(name.c_str());
+        header = NULL;
+    }
+    Close();
+}
+
+// **************************************************************
+void IO_Shm_Channel::Print()
+{
+    std_cout
+        << "Shared-memory channel '" << name << "':\n"
+        << "    slots:           " << nb_slots << " of " << snapshot_size << " bytes (" << (policy == Drop ? "drop" : "block") << " when full)\n"
+        << "    published:       " << nb_published << "\n"
+        << "    dropped:         " << nb_dropped << "\n"
+        << "    reader wait:     " << wait_time << " s\n";
+}
+
+// **************************************************************
+IO_Shm_Channel_Reader::IO_Shm_Channel_Reader()
+{
+    header          = NULL;
+    segment_size    = 0;
+    sequence        = 0;
+}
+
+// **************************************************************
+IO_Shm_Channel_Reader::IO_Shm_Channel_Reader(const std::string &_name, const double timeout)
+{
+    header          = NULL;
+    segment_size    = 0;
+    sequence        = 0;
+
+    if (!Open(_name, timeout))
+    {
+        std_cout << "ERROR: Shared-memory channel '" << _name << "' was not published within " << timeout << " s. Aborting.\n" << std::flush;
+        abort();
+    }
+}
+
+// **************************************************************
+IO_Shm_Channel_Reader::~IO_Shm_Channel_Reader()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Shm_Channel_Reader::Open(const std::string &_name, const double timeout)
+/**
+ * Wait for the writer's first snapshot (negative "timeout": forever).
+ * @return  false on timeout
+ */
+{
+    Close();
+
+    name = (_name != "" && _name[0] != '/' ? "/" + _name : _name);
+
+    const double start = IO_Wall_Time();
+    double delay = 5.0e-5;
+    while (header == NULL)
+    {
+        const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        struct stat segment_stat;
+        if (fd != -1 && fstat(fd, &segment_stat) == 0 && size_t(segment_stat.st_size) >= sizeof(IO_Shm_Header))
+        {
+            void *segment = mmap(NULL, size_t(segment_stat.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (segment != MAP_FAILED)
+            {
+                IO_Shm_Header *candidate = (IO_Shm_Header *) segment;
+                if (candidate->magic == IO_SHM_CHANNEL_MAGIC && candidate->is_closed == 0 && Is_Alive(candidate->writer_pid))
+                {
+                    header       = candidate;
+                    segment_size = size_t(segment_stat.st_size);
+                }
+                else
+                {
+                    munmap(segment, size_t(segment_stat.st_size));
+                }
+            }
+        }
+        if (fd != -1)
+            close(fd);
+
+        if (header != NULL)
+            break;
+        if (timeout >= 0.0 && IO_Wall_Time() - start > timeout)
+            return false;
+        Back_Off(delay);
+    }
+    __sync_synchronize();
+
+    // One reader at a time; a dead one is replaced.
+    const int32_t me = int32_t(getpid());
+    int32_t previous = header->reader_pid;
+    while (!__sync_bool_compare_and_swap(&header->reader_pid, previous, me))
+        previous = header->reader_pid;
+    if (previous != 0 && previous != me && Is_Alive(previous))
+    {
+        std_cout << "ERROR: Shared-memory channel '" << name << "' already has a reader (pid " << previous << "). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    std::istringstream metadata(std::string(((char *) header) + sizeof(IO_Shm_Header), size_t(header->metadata_size)));
+    std::string line;
+    while (std::getline(metadata, line))
+    {
+        std::istringstream fields(line);
+        IO_Shm_Variable variable;
+        std::string field;
+        size_t nb_dims = 0;
+        std::getline(fields, variable.name, '\t');
+        std::getline(fields, variable.type, '\t');
+        std::getline(fields, variable.units, '\t');
+        std::getline(fields, field, '\t');  std::istringstream(field) >> variable.element_size;
+        std::getline(fields, field, '\t');  std::istringstream(field) >> variable.offset;
+        std::getline(fields, field, '\t');  std::istringstream(field) >> variable.size;
+        std::getline(fields, field, '\t');  std::istringstream(field) >> nb_dims;
+        for (size_t d = 0 ; d < nb_dims ; d++)
+        {
+            size_t dim_size = 0;
+            std::getline(fields, field, '\t');
+            variable.dim_names.push_back(field);
+            std::getline(fields, field, '\t');  std::istringstream(field) >> dim_size;
+            variable.dim_sizes.push_back(dim_size);
+        }
+        variables.push_back(variable);
+    }
+    snapshot.resize(size_t(header->slot_size));
+
+    return true;
+}
+
+// **************************************************************
+bool IO_Shm_Channel_Reader::Next(const double timeout)
+{
+    assert(header != NULL);
+
+    const double start = IO_Wall_Time();
+    double delay = 5.0e-5;
+    while (true)
+    {
+        const uint64_t consumed = header->nb_consumed;
+        if (header->nb_published > consumed)
+        {
+            __sync_synchronize();
+            const char *slot = ((char *) header) + header->data_offset + (consumed % header->nb_slots) * header->slot_size;
+            memcpy(&snapshot[0], slot, snapshot.size());
+            __sync_synchronize();
+            header->nb_consumed = consumed + 1;
+            sequence = consumed + 1;
+            return true;
+        }
+
+        // Closed (or dead) writer: done once the ring is drained.
+        if (header->is_closed != 0 || !Is_Alive(header->writer_pid))
+        {
+            __sync_synchronize();
+            if (header->nb_published > consumed)
+                continue;
+            return false;
+        }
+        if (timeout >= 0.0 && IO_Wall_Time() - start > timeout)
+            return false;
+        Back_Off(delay);
+    }
+}
+
+// **************************************************************
+void IO_Shm_Channel_Reader::Close()
+{
+    if (header == NULL)
+        return;
+
+    __sync_bool_compare_and_swap(&header->reader_pid, int32_t(getpid()), int32_t(0));
+    munmap((void *) header, segment_size);
+    header = NULL;
+    variables.clear();
+    sequence = 0;
+}
+
+// **************************************************************
+uint64_t IO_Shm_Channel_Reader::Get_Nb_Dropped()
+/**
+ * Snapshots the writer dropped so far because the ring was full.
+ */
+{
+    return (header == NULL ? 0 : header->nb_dropped);
+}
+
+// **************************************************************
+const void * IO_Shm_Channel_Reader::Get_Data(const std::string &variable_name)
+/**
+ * @return  Variable "variable_name" of the snapshot read by Next()
+ */
+{
+    assert(sequence > 0);
+
+    for (size_t i = 0 ; i < variables.size() ; i++)
+    {
+        if (variables[i].name == variable_name)
+            return &snapshot[variables[i].offset];
+    }
+    std_cout << "ERROR: No variable '" << variable_name << "' in shared-memory channel '" << name << "'. Aborting.\n" << std::flush;
+    abort();
+    return NULL;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,162 @@
+#ifndef INC_IO_SHM_CHANNEL_hpp
+#define INC_IO_SHM_CHANNEL_hpp
+
+#include <string>
+#include <vector>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// Default number of snapshots the segment holds
+#define IO_SHM_CHANNEL_DEFAULT_NB_SLOTS 4
+
+struct IO_Shm_Header;
+
+struct IO_Shm_Variable
+/**
+ * A variable of the snapshots, as described in the segment.
+ */
+{
+    std::string name;
+    std::string type;                       // netcdf_types_string[] name
+    std::string units;
+    size_t element_size;                    // Bytes
+    std::vector<std::string> dim_names;
+    std::vector<size_t> dim_sizes;
+    size_t offset;                          // In a snapshot (bytes)
+    size_t size;                            // Bytes
+};
+
+class IO_Shm_Channel
+/**
+ * Snapshots published into a POSIX shared-memory segment ("/dev/shm"),
+ * for a co-located analysis process reading them with
+ * IO_Shm_Channel_Reader, without going through a file system. This is
+ * NetCDF_Out's alternative sink (Set_Channel()), but any set of arrays
+ * can be published:
+ *
+ *      IO_Shm_Channel channel("/simulation", 8, IO_Shm_Channel::Block);
+ *      channel.Add_Variable("density", "double", sizeof(double), dim_names, dim_sizes, "kg/m^3", density);
+ *      for (...)
+ *          channel.Publish();
+ *      channel.Remove();
+ *
+ * The segment is a ring of "nb_slots" snapshots, created at the first
+ * Publish() once the variables are known, so memory is bounded to
+ * "nb_slots" times the snapshot size. Publish() copies the variables
+ * into the next free slot. When the reader is "nb_slots" snapshots
+ * behind, the policy decides:
+ *
+ *      Drop    The new snapshot is dropped (counted); the simulation
+ *              never waits (default).
+ *      Block   Publish() waits for the reader to free a slot, as long
+ *              as a reader is attached and alive.
+ *
+ * There is one writer and one reader per channel. Close() only ends a
+ * set of variables: the segment stays, so a NetCDF_Out opened and
+ * closed for every snapshot keeps feeding the same reader. Variables
+ * are added again after Close(), with the same layout. Remove() (or
+ * the destructor) removes the name; an attached reader still gets the
+ * snapshots left in the ring.
+ */
+{
+    public:
+        enum Policy
+        {
+            Drop    = 0,
+            Block   = 1
+        };
+
+    private:
+        std::string name;                   // Empty: disabled
+        uint64_t nb_slots;
+        Policy policy;
+
+        std::vector<IO_Shm_Variable> variables;
+        std::vector<const void *> pointers;
+        size_t snapshot_size;
+
+        IO_Shm_Header *header;              // Mapped segment
+        size_t segment_size;
+
+        uint64_t nb_published;
+        uint64_t nb_dropped;
+        double wait_time;                   // Seconds blocked on the reader
+        bool is_publishing;                 // Variables can't change until Close()
+
+        std::string Describe();
+        void Create();
+
+    public:
+        IO_Shm_Channel(const std::string _name = "", const uint64_t _nb_slots = IO_SHM_CHANNEL_DEFAULT_NB_SLOTS, const Policy _policy = Drop);
+        IO_Shm_Channel(const IO_Shm_Channel &other);
+        IO_Shm_Channel & operator=(const IO_Shm_Channel &other);
+        ~IO_Shm_Channel();
+
+        void Add_Variable(const std::string &variable_name, const std::string &type, const size_t element_size,
+                          const std::vector<std::string> &dim_names, const std::vector<size_t> &dim_sizes,
+                          const std::string &units, const void *const pointer);
+        bool Publish();
+        void Close();
+        void Remove();
+
+        inline bool         Is_Enabled()        { return (name != "");  }
+        inline std::string  Get_Name()          { return name;          }
+        inline uint64_t     Get_Nb_Published()  { return nb_published;  }
+        inline uint64_t     Get_Nb_Dropped()    { return nb_dropped;    }
+        inline double       Get_Wait_Time()     { return wait_time;     }
+        void Print();
+};
+
+class IO_Shm_Channel_Reader
+/**
+ * Consumer of an IO_Shm_Channel, in another process (or thread):
+ *
+ *      IO_Shm_Channel_Reader reader("/simulation");
+ *      while (reader.Next())
+ *      {
+ *          const double *density = reader.Get<double>("density");
+ *          ...
+ *      }
+ *
+ * Next() copies the oldest snapshot out of the ring, freeing its slot
+ * at once; the data stays valid until the following Next(). It returns
+ * false once the writer removed the channel and every snapshot was read,
+ * or when "timeout" seconds passed without a new one (negative: wait
+ * forever).
+ */
+{
+    private:
+        std::string name;
+        IO_Shm_Header *header;
+        size_t segment_size;
+        std::vector<IO_Shm_Variable> variables;
+        std::vector<char> snapshot;
+        uint64_t sequence;                  // Of the snapshot held, counting from 1
+
+    public:
+        IO_Shm_Channel_Reader();
+        IO_Shm_Channel_Reader(const std::string &_name, const double timeout = -1.0);
+        ~IO_Shm_Channel_Reader();
+
+        bool Open(const std::string &_name, const double timeout = -1.0);
+        bool Next(const double timeout = -1.0);
+        void Close();
+
+        inline size_t                   Get_Nb_Variables()          { return variables.size();  }
+        inline const IO_Shm_Variable &  Get_Variable(const size_t i) { return variables[i];     }
+        inline uint64_t                 Get_Sequence()              { return sequence;          }
+        uint64_t Get_Nb_Dropped();
+        const void * Get_Data(const std::string &variable_name);
+        template <class T>
+        inline const T * Get(const std::string &variable_name) { return (const T *) Get_Data(variable_name); }
+};
+
+#endif // INC_IO_SHM_CHANNEL_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,40 @@
+#ifndef INC_IO_SINK_hpp
+#define INC_IO_SINK_hpp
+
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// IO_Sink::Get_Physical_Bytes(): what the sink stored is the growth of
+// the file it was opened on, or it stores nothing (live output).
+#define IO_SINK_FILE_BYTES  (-1)
+#define IO_SINK_NOT_STORED  (-2)
+
+class IO_Sink
+/**
+ * Alternate output backend of IO. When IO::Open_File() selects one
+ * through its mode options, Write(), Flush() and Close_File() are
+ * forwarded to it instead of the fstream, FILE* or gzFile handles.
+ * Set_Time() forwards IO::Set_Time(), for backends that use it.
+ * Get_Physical_Bytes() is asked once closed, for IO_Stats.
+ * Get_Nb_Subscribers() counts the readers of live backends.
+ */
+{
+    public:
+        virtual ~IO_Sink() {}
+        virtual void Write(const char *p, const size_t size) = 0;
+        virtual void Flush() = 0;
+        virtual void Close() = 0;
+        virtual void Set_Time(const double) {}
+        virtual int64_t Get_Physical_Bytes() { return IO_SINK_FILE_BYTES; }
+        virtual size_t Get_Nb_Subscribers() { return 0; }
+};
+
+#endif // INC_IO_SINK_hpp
+
+// ********** End of file ***************************************
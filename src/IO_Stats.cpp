@@ -0,0 +1,382 @@
+
+#include <cstring>  // memset()
+#include <pthread.h>
+#include <sys/stat.h> // stat()
+
+#include <StdCout.hpp>
+
+#include "IO_Stats.hpp"
+
+// **************************************************************
+static double Monotonic_Time()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return double(now.tv_sec) + 1.0e-9*double(now.tv_nsec);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// The time stamp counter's rate is measured against clock_gettime()
+// over the run, from this reference taken at program start.
+struct IO_Clock_Reference
+{
+    uint64_t ticks;
+    double time;
+    IO_Clock_Reference() : ticks(IO_Clock_Ticks()), time(Monotonic_Time()) {}
+};
+static IO_Clock_Reference clock_reference;
+static double seconds_per_tick = 0.0;
+static volatile bool is_calibrated = false;
+static pthread_once_t calibration = PTHREAD_ONCE_INIT;
+
+// **************************************************************
+static void Calibrate_Clock()
+/**
+ * Over at least 20 ms (waiting only if called that early). Run once,
+ * through pthread_once(), whichever thread converts ticks first.
+ */
+{
+    double time;
+    do
+    {
+        time = Monotonic_Time();
+    } while (time - clock_reference.time < 0.02);
+    seconds_per_tick = (time - clock_reference.time) / double(IO_Clock_Ticks() - clock_reference.ticks);
+    __sync_synchronize();
+    is_calibrated = true;
+}
+#endif
+
+// **************************************************************
+double IO_Clock_Ticks_To_Seconds(const uint64_t ticks)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (!is_calibrated)
+        pthread_once(&calibration, Calibrate_Clock);
+    return seconds_per_tick * double(ticks);
+#else
+    return 1.0e-9 * double(ticks);
+#endif
+}
+
+// **************************************************************
+static void Atomic_Max(uint64_t *target, const uint64_t value)
+{
+    uint64_t current = *target;
+    while (value > current)
+    {
+        const uint64_t previous = __sync_val_compare_and_swap(target, current, value);
+        if (previous == current)
+            break;
+        current = previous;
+    }
+}
+
+// **************************************************************
+static void Atomic_Min(uint64_t *target, const uint64_t value)
+{
+    uint64_t current = *target;
+    while (value < current)
+    {
+        const uint64_t previous = __sync_val_compare_and_swap(target, current, value);
+        if (previous == current)
+            break;
+        current = previous;
+    }
+}
+
+// **************************************************************
+static uint64_t File_Size(const std::string &path)
+{
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return 0;
+    return uint64_t(status.st_size);
+}
+
+// **************************************************************
+static bool Is_Special_File(const std::string &path)
+/**
+ * Named pipes, sockets and devices: what goes through is not stored.
+ */
+{
+    struct stat status;
+    return (stat(path.c_str(), &status) == 0 && !S_ISREG(status.st_mode));
+}
+
+// **************************************************************
+IO_Histogram::IO_Histogram()
+{
+    Reset();
+}
+
+// **************************************************************
+void IO_Histogram::Reset()
+{
+    memset(counts, 0, sizeof(counts));
+    nb_values   = 0;
+    total       = 0;
+    min         = ~uint64_t(0);
+    max         = 0;
+}
+
+// **************************************************************
+int IO_Histogram::Bucket(const uint64_t value)
+/**
+ * Values below 2*IO_HISTOGRAM_SUB_BUCKETS have their own bucket. Above,
+ * a value's 5 most significant bits (the leading one and 4 more) select
+ * one of 16 buckets of its power of two.
+ */
+{
+    if (value < uint64_t(2*IO_HISTOGRAM_SUB_BUCKETS))
+        return int(value);
+
+    const uint64_t clamped = (value >> IO_HISTOGRAM_MAX_BITS) ? ((uint64_t(1) << IO_HISTOGRAM_MAX_BITS) - 1) : value;
+    const int msb   = 63 - __builtin_clzll(clamped);
+    const int shift = msb - 4;
+    return IO_HISTOGRAM_SUB_BUCKETS*shift + int(clamped >> shift);
+}
+
+// **************************************************************
+uint64_t IO_Histogram::Bucket_Upper_Bound(const int bucket)
+{
+    if (bucket < 2*IO_HISTOGRAM_SUB_BUCKETS)
+        return uint64_t(bucket);
+
+    const int shift     = bucket / IO_HISTOGRAM_SUB_BUCKETS - 1;
+    const uint64_t top  = uint64_t(bucket % IO_HISTOGRAM_SUB_BUCKETS + IO_HISTOGRAM_SUB_BUCKETS);
+    return ((top + 1) << shift) - 1;
+}
+
+// **************************************************************
+void IO_Histogram::Record(const uint64_t ticks)
+{
+    counts[Bucket(ticks)]++;
+    nb_values++;
+    total += ticks;
+    if (ticks < min)
+        min = ticks;
+    if (ticks > max)
+        max = ticks;
+}
+
+// **************************************************************
+void IO_Histogram::Record_Shared(const uint64_t ticks)
+/**
+ * Record() for concurrent callers.
+ */
+{
+    __sync_fetch_and_add(&counts[Bucket(ticks)], uint64_t(1));
+    __sync_fetch_and_add(&nb_values, uint64_t(1));
+    __sync_fetch_and_add(&total, ticks);
+    Atomic_Min(&min, ticks);
+    Atomic_Max(&max, ticks);
+}
+
+// **************************************************************
+double IO_Histogram::Get_Percentile(const double percentile)
+/**
+ * @param   percentile  In [0,1] (0.99 for p99)
+ * @return  Largest duration of the bucket holding the percentile (at
+ *          most 6.25% above the exact value), bounded by the maximum
+ *          recorded (seconds)
+ */
+{
+    if (nb_values == 0)
+        return 0.0;
+
+    uint64_t rank = uint64_t(percentile * double(nb_values) + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int b = 0 ; b < IO_HISTOGRAM_NB_BUCKETS ; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+            const uint64_t bound = Bucket_Upper_Bound(b);
+            return IO_Clock_Ticks_To_Seconds(bound < max ? bound : max);
+        }
+    }
+    return IO_Clock_Ticks_To_Seconds(max);
+}
+
+// **************************************************************
+IO_Stats::IO_Stats()
+{
+    sampling    = 1;
+    countdown   = 1;
+    Reset();
+}
+
+// **************************************************************
+void IO_Stats::Reset()
+{
+    write_time.Reset();
+    write_string_time.Reset();
+    flush_time.Reset();
+
+    nb_write_calls          = 0;
+    nb_write_string_calls   = 0;
+    nb_flushes              = 0;
+    nb_opens                = 0;
+    bytes_logical           = 0;
+    bytes_physical          = 0;
+    bytes_logical_closed    = 0;
+    nb_not_stored           = 0;
+    close_time              = 0.0;
+    // A file being written keeps being tracked.
+    initial_size            = 0;
+    logical_at_open         = 0;
+}
+
+// **************************************************************
+void IO_Stats::Set_Sampling(const int _sampling)
+/**
+ * Time one Write()/WriteString() call in "_sampling" (1: every call).
+ */
+{
+    assert(_sampling >= 1);
+    sampling    = _sampling;
+    countdown   = 1;
+}
+
+// **************************************************************
+void IO_Stats::Open(const std::string &_path, const bool append)
+/**
+ * Must be called before the file is opened (or truncated).
+ */
+{
+    path            = _path;
+    initial_size    = (append ? File_Size(path) : 0);
+    logical_at_open = bytes_logical;
+    nb_opens++;
+}
+
+// **************************************************************
+void IO_Stats::Close(const uint64_t start, const int64_t sink_bytes)
+/**
+ * Called once the file is closed, before it is renamed.
+ * @param   start       IO_Clock_Ticks() when Close_File() was called
+ * @param   sink_bytes  IO_Sink::Get_Physical_Bytes() if a sink was used
+ */
+{
+    if (path == "")
+        return;
+
+    if (sink_bytes >= 0)
+    {
+        bytes_physical       += uint64_t(sink_bytes);
+        bytes_logical_closed += bytes_logical - logical_at_open;
+    }
+    else if (sink_bytes == IO_SINK_NOT_STORED || Is_Special_File(path))
+    {
+        nb_not_stored++;
+    }
+    else
+    {
+        const uint64_t size = File_Size(path);
+        bytes_physical       += (size > initial_size ? size - initial_size : 0);
+        bytes_logical_closed += bytes_logical - logical_at_open;
+    }
+    path = "";
+
+    close_time += IO_Clock_Ticks_To_Seconds(IO_Clock_Ticks() - start);
+}
+
+// **************************************************************
+void IO_Stats::Record_Write(const size_t bytes, const uint64_t start, const bool shared)
+/**
+ * @param   start   Start()'s value (0: call not timed)
+ */
+{
+    if (shared)
+    {
+        __sync_fetch_and_add(&nb_write_calls, uint64_t(1));
+        __sync_fetch_and_add(&bytes_logical, uint64_t(bytes));
+        if (start != 0)
+            write_time.Record_Shared(IO_Clock_Ticks() - start);
+    }
+    else
+    {
+        nb_write_calls++;
+        bytes_logical += bytes;
+        if (start != 0)
+            write_time.Record(IO_Clock_Ticks() - start);
+    }
+}
+
+// **************************************************************
+void IO_Stats::Record_Write_String(const size_t bytes, const uint64_t start, const bool shared)
+{
+    if (shared)
+    {
+        __sync_fetch_and_add(&nb_write_string_calls, uint64_t(1));
+        __sync_fetch_and_add(&bytes_logical, uint64_t(bytes));
+        if (start != 0)
+            write_string_time.Record_Shared(IO_Clock_Ticks() - start);
+    }
+    else
+    {
+        nb_write_string_calls++;
+        bytes_logical += bytes;
+        if (start != 0)
+            write_string_time.Record(IO_Clock_Ticks() - start);
+    }
+}
+
+// **************************************************************
+void IO_Stats::Record_Flush(const uint64_t start)
+{
+    nb_flushes++;
+    flush_time.Record(IO_Clock_Ticks() - start);
+}
+
+// **************************************************************
+double IO_Stats::Get_Compression_Ratio()
+/**
+ * Logical over physical bytes, of closed files only.
+ */
+{
+    if (bytes_physical == 0)
+        return 0.0;
+    return double(bytes_logical_closed) / double(bytes_physical);
+}
+
+// **************************************************************
+void IO_Stats::Print(const std::string &name)
+{
+    IO_Histogram *histograms[] = {&write_time, &write_string_time, &flush_time};
+    const char *names[]        = {"Write()      ", "WriteString()", "Flush()      "};
+    const uint64_t calls[]     = {nb_write_calls, nb_write_string_calls, nb_flushes};
+
+    std_cout
+        << "Statistics of '" << name << "':\n"
+        << "    opened:          " << nb_opens << " times, " << close_time << " s in Close_File()\n"
+        << "    bytes logical:   " << bytes_logical << "\n"
+        << "    bytes physical:  " << bytes_physical << " (closed files)\n";
+    if (nb_not_stored > 0)
+        std_cout << "    not stored:      " << nb_not_stored << " outputs (socket, fifo or named pipe), not in bytes physical\n";
+    if (bytes_logical_closed > 0)
+        std_cout << "    compression:     " << Get_Compression_Ratio() << "\n";
+    else
+        std_cout << "    compression:     n/a\n";
+    if (sampling > 1)
+        std_cout << "    sampling:        1 call in " << sampling << " timed (times are estimates)\n";
+    for (int i = 0 ; i < 3 ; i++)
+    {
+        IO_Histogram &h = *histograms[i];
+        std_cout
+            << "    " << names[i] << "    "
+            << calls[i] << " calls, "
+            << h.Get_Mean() * double(calls[i]) << " s, "
+            << "mean " << 1.0e6 * h.Get_Mean() << " us, "
+            << "p50 " << 1.0e6 * h.Get_Percentile(0.50) << " us, "
+            << "p99 " << 1.0e6 * h.Get_Percentile(0.99) << " us, "
+            << "p99.9 " << 1.0e6 * h.Get_Percentile(0.999) << " us, "
+            << "max " << 1.0e6 * h.Get_Max() << " us\n";
+    }
+}
+
+// ********** End of file ***************************************
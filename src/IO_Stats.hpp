@@ -0,0 +1,178 @@
+#ifndef INC_IO_STATS_hpp
+#define INC_IO_STATS_hpp
+
+#include <string>
+#include <cstddef> // size_t
+#include <time.h>  // clock_gettime()
+#include <sys/time.h> // gettimeofday()
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+
+// Log-linear buckets: 16 per power of two (values within 1/16 = 6.25%),
+// exact below 32 ticks, up to 2^44 ticks (more than an hour at 4 GHz).
+const int IO_HISTOGRAM_SUB_BUCKETS  = 16;
+const int IO_HISTOGRAM_MAX_BITS     = 44;
+const int IO_HISTOGRAM_NB_BUCKETS   = IO_HISTOGRAM_SUB_BUCKETS * (IO_HISTOGRAM_MAX_BITS - 3);
+
+// **************************************************************
+inline uint64_t IO_Clock_Ticks()
+/**
+ * Cheapest monotonic clock available: the time stamp counter on x86
+ * (constant rate on any CPU of the last decade), else clock_gettime()
+ * in nanoseconds. See IO_Clock_Ticks_To_Seconds().
+ */
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * uint64_t(1000000000) + uint64_t(now.tv_nsec);
+#endif
+}
+
+double IO_Clock_Ticks_To_Seconds(const uint64_t ticks);
+
+// **************************************************************
+inline double IO_Wall_Time()
+/**
+ * Seconds since the epoch, for timeouts, rates and deadlines shared
+ * between processes or threads.
+ */
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return double(now.tv_sec) + 1.0e-6*double(now.tv_usec);
+}
+
+class IO_Histogram
+/**
+ * Duration histogram in the style of HdrHistogram: fixed memory, O(1)
+ * recording (a count leading zeros and an increment) and percentiles
+ * with a bounded relative error. Durations are recorded in clock ticks
+ * and reported in seconds.
+ */
+{
+    private:
+        uint64_t counts[IO_HISTOGRAM_NB_BUCKETS];
+        uint64_t nb_values;
+        uint64_t total;         // Sum of values (ticks)
+        uint64_t min;
+        uint64_t max;
+
+        static int Bucket(const uint64_t value);
+        static uint64_t Bucket_Upper_Bound(const int bucket);
+
+    public:
+        IO_Histogram();
+        void Reset();
+        void Record(const uint64_t ticks);
+        void Record_Shared(const uint64_t ticks);
+        double Get_Percentile(const double percentile);
+
+        inline uint64_t Get_Nb_Values() { return nb_values; }
+        inline double   Get_Total()     { return IO_Clock_Ticks_To_Seconds(total); }
+        inline double   Get_Min()       { return (nb_values > 0 ? IO_Clock_Ticks_To_Seconds(min) : 0.0); }
+        inline double   Get_Max()       { return IO_Clock_Ticks_To_Seconds(max); }
+        inline double   Get_Mean()      { return (nb_values > 0 ? Get_Total() / double(nb_values) : 0.0); }
+};
+
+class IO_Stats
+/**
+ * Counters and latency histograms kept by every IO object.
+ *
+ *      - "logical" bytes are the bytes given to Write() and WriteString();
+ *      - "physical" bytes are the bytes added to the file on disk
+ *        (after compression, record headers included), measured when
+ *        the file is closed, or counted by the sink (segments of
+ *        "rotate"); outputs that are not files ("socket", "fifo", a
+ *        named pipe) are left out, with their logical bytes;
+ *      - time spent inside Write(), WriteString() and Flush() is
+ *        recorded per call.
+ *
+ *      energies.Print_Stats();
+ *      const double p99 = energies.Get_Stats().Write_String_Time().Get_Percentile(0.99); // s
+ *
+ * Statistics accumulate over every Open_File()/Close_File() of the
+ * object until Reset(). Timing a call costs two reads of the time stamp
+ * counter and a few increments; for streams written millions of times
+ * per second, Set_Sampling(n) only times one Write()/WriteString() call
+ * in n (counters stay exact). In "producers" mode, counters are updated
+ * with atomic operations.
+ */
+{
+    private:
+        IO_Histogram write_time;
+        IO_Histogram write_string_time;
+        IO_Histogram flush_time;
+
+        uint64_t nb_write_calls;
+        uint64_t nb_write_string_calls;
+        uint64_t nb_flushes;
+        uint64_t nb_opens;
+        uint64_t bytes_logical;
+        uint64_t bytes_physical;        // Of closed files
+        uint64_t bytes_logical_closed;  // Logical bytes matching bytes_physical
+        uint64_t nb_not_stored;         // Closed outputs that were not files
+        double close_time;              // Total time in Close_File() (seconds)
+
+        int sampling;                   // Time one call in "sampling"
+        volatile int countdown;         // Calls before the next timed one
+
+        std::string path;               // File being written ("" if none)
+        uint64_t initial_size;          // Its size before opening
+        uint64_t logical_at_open;
+
+    public:
+        IO_Stats();
+        void Reset();
+        void Set_Sampling(const int _sampling);
+
+        // Used by IO
+        inline uint64_t Start()
+        /**
+         * @return  Clock ticks, or 0 if this call is not timed
+         */
+        {
+            if (sampling > 1)
+            {
+                // Producer threads count down together: the call reaching
+                // 0 is timed and rearms, calls past it are not timed.
+                const int left = __sync_sub_and_fetch(&countdown, 1);
+                if (left != 0)
+                    return 0;
+                __sync_add_and_fetch(&countdown, sampling);
+            }
+            return IO_Clock_Ticks();
+        }
+        void Open(const std::string &_path, const bool append);
+        void Close(const uint64_t start, const int64_t sink_bytes = IO_SINK_FILE_BYTES);
+        void Record_Write(const size_t bytes, const uint64_t start, const bool shared);
+        void Record_Write_String(const size_t bytes, const uint64_t start, const bool shared);
+        void Record_Flush(const uint64_t start);
+
+        inline IO_Histogram &   Write_Time()            { return write_time;            }
+        inline IO_Histogram &   Write_String_Time()     { return write_string_time;     }
+        inline IO_Histogram &   Flush_Time()            { return flush_time;            }
+        inline uint64_t         Get_Nb_Write_Calls()    { return nb_write_calls;        }
+        inline uint64_t         Get_Nb_Write_String_Calls() { return nb_write_string_calls; }
+        inline uint64_t         Get_Nb_Flushes()        { return nb_flushes;            }
+        inline uint64_t         Get_Nb_Opens()          { return nb_opens;              }
+        inline uint64_t         Get_Bytes_Logical()     { return bytes_logical;         }
+        inline uint64_t         Get_Bytes_Physical()    { return bytes_physical;        }
+        inline double           Get_Close_Time()        { return close_time;            }
+        inline int              Get_Sampling()          { return sampling;              }
+        double Get_Compression_Ratio();
+        void Print(const std::string &name);
+};
+
+#endif // INC_IO_STATS_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,183 @@
+
+#include <cstdlib>  // abort()
+#include <cstring>  // strerror()
+#include <cerrno>
+#include <fcntl.h>  // open(), sync_file_range(), posix_fadvise()
+#include <unistd.h> // close(), fdatasync()
+#include <sys/stat.h> // fstat()
+
+#include <StdCout.hpp>
+
+#include "IO_Streaming.hpp"
+#include "IO_Stats.hpp"
+
+// **************************************************************
+static void Write_Back(const int fd, const uint64_t offset, const uint64_t size, const bool wait)
+/**
+ * Start (or finish) the writeback of [offset, offset+size), size 0
+ * meaning up to the end of the file. Without sync_file_range()
+ * (not Linux), only waiting is possible, for the whole file.
+ */
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+    const unsigned int flags = SYNC_FILE_RANGE_WRITE | (wait ? SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER : 0);
+    sync_file_range(fd, off64_t(offset), off64_t(size), flags);
+#else // #ifdef SYNC_FILE_RANGE_WRITE
+    if (wait)
+        fdatasync(fd);
+#endif // #ifdef SYNC_FILE_RANGE_WRITE
+}
+
+// **************************************************************
+IO_Streaming::IO_Streaming(const uint64_t _window)
+{
+    window          = _window;
+    fd              = -1;
+    is_open         = false;
+    pending_bytes   = 0;
+    started         = 0;
+    dropped         = 0;
+    nb_windows      = 0;
+    wait_time       = 0.0;
+}
+
+// **************************************************************
+IO_Streaming::IO_Streaming(const IO_Streaming &other)
+{
+    fd      = -1;
+    is_open = false;
+    *this   = other;
+}
+
+// **************************************************************
+IO_Streaming & IO_Streaming::operator=(const IO_Streaming &other)
+/**
+ * Copy the policy and statistics, not the state of an opened file.
+ */
+{
+    if (this == &other)
+        return *this;
+
+    assert(!is_open);
+
+    window          = other.window;
+    pending_bytes   = 0;
+    started         = 0;
+    dropped         = other.dropped;
+    nb_windows      = other.nb_windows;
+    wait_time       = other.wait_time;
+
+    return *this;
+}
+
+// **************************************************************
+IO_Streaming::~IO_Streaming()
+{
+    if (fd != -1)
+        close(fd);
+}
+
+// **************************************************************
+void IO_Streaming::Open(const std::string &_filename)
+/**
+ * Start following a file just created (or opened for appending: what
+ * it already holds is dropped at the first check).
+ */
+{
+    assert(window > 0);
+
+    if (fd != -1)
+        close(fd);
+
+    filename = _filename;
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        std_cout << "ERROR: Could not open '" << filename << "' to drop its pages from the cache: " << strerror(errno) << ". Aborting.\n" << std::flush;
+        abort();
+    }
+    is_open         = true;
+    pending_bytes   = 0;
+    started         = 0;
+    dropped         = 0;
+    nb_windows      = 0;
+    wait_time       = 0.0;
+}
+
+// **************************************************************
+void IO_Streaming::Drop(const uint64_t end)
+/**
+ * Wait for the writeback of [dropped, end) and drop its pages.
+ */
+{
+    if (end <= dropped)
+        return;
+
+    const double start = IO_Wall_Time();
+    Write_Back(fd, dropped, end - dropped, true);
+    wait_time += IO_Wall_Time() - start;
+
+    posix_fadvise(fd, off_t(dropped), off_t(end - dropped), POSIX_FADV_DONTNEED);
+    dropped = end;
+}
+
+// **************************************************************
+void IO_Streaming::Check()
+/**
+ * Pipeline step: start the writeback of the windows now complete in
+ * the file, drop the ones before the last of them.
+ */
+{
+    if (!is_open)
+        return;
+    pending_bytes = 0;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+        return;
+    const uint64_t size = uint64_t(file_stat.st_size);
+
+    bool has_started = false;
+    while (started + window <= size)
+    {
+        Write_Back(fd, started, window, false);
+        started += window;
+        nb_windows++;
+        has_started = true;
+    }
+
+    // The last window started is still being written: keep it.
+    if (has_started)
+        Drop(started - window);
+}
+
+// **************************************************************
+void IO_Streaming::Close()
+/**
+ * Called once the owner closed (or at least flushed) the file.
+ */
+{
+    if (!is_open)
+        return;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0)
+        Drop(uint64_t(file_stat.st_size));
+
+    close(fd);
+    fd = -1;
+    is_open = false;
+}
+
+// **************************************************************
+void IO_Streaming::Print()
+{
+    std_cout
+        << "Page cache of '" << filename << "':\n"
+        << "    window:          " << window << " bytes\n"
+        << "    windows:         " << nb_windows << "\n"
+        << "    dropped:         " << dropped << " bytes\n"
+        << "    writeback wait:  " << wait_time << " s\n";
+}
+
+// ********** End of file ***************************************
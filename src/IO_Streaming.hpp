@@ -0,0 +1,71 @@
+#ifndef INC_IO_STREAMING_hpp
+#define INC_IO_STREAMING_hpp
+
+#include <string>
+#include <cstddef> // size_t
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+// Size of the windows written back and dropped together (bytes)
+#define IO_STREAMING_DEFAULT_WINDOW (8*1024*1024)
+
+class IO_Streaming
+/**
+ * Write-once output kept out of the page cache ("stream" mode option
+ * of IO, NetCDF_Out's Set_Streaming()), so that gigabytes of output
+ * don't evict the simulation's memory.
+ *
+ * The file is followed in windows. Once a window is complete in the
+ * file, its writeback is started (sync_file_range()); once the next
+ * one is complete too, the window is waited for, which has usually
+ * finished by then, and its pages are dropped (POSIX_FADV_DONTNEED).
+ * At most two windows of the file are thus in the cache, plus what
+ * the owner buffers. Close() writes back and drops the rest.
+ *
+ * The file size is only checked once "window" bytes were written, so
+ * the cost per write is an addition. Data is not made durable: see
+ * IO_Durability for that.
+ */
+{
+    private:
+        uint64_t window;            // 0: disabled
+        std::string filename;
+        int fd;                     // Of our own
+        bool is_open;
+        uint64_t pending_bytes;     // Written since the last check
+        uint64_t started;           // Writeback started before this offset
+        uint64_t dropped;           // Pages dropped before this offset
+
+        uint64_t nb_windows;
+        double wait_time;           // Seconds waiting for writeback
+
+        void Drop(const uint64_t end);
+
+    public:
+        IO_Streaming(const uint64_t _window = 0);
+        IO_Streaming(const IO_Streaming &other);
+        IO_Streaming & operator=(const IO_Streaming &other);
+        ~IO_Streaming();
+
+        // Used by the file's owner
+        void Open(const std::string &_filename);
+        inline bool Written(const size_t bytes)     { pending_bytes += bytes; return (is_open && pending_bytes >= window); }
+        void Check();
+        void Close();
+
+        inline bool     Is_Enabled()        { return (window > 0);  }
+        inline uint64_t Get_Window()        { return window;        }
+        inline uint64_t Get_Bytes_Dropped() { return dropped;       }
+        inline uint64_t Get_Nb_Windows()    { return nb_windows;    }
+        inline double   Get_Wait_Time()     { return wait_time;     }
+        void Print();
+};
+
+#endif // INC_IO_STREAMING_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,522 @@
+
+#include <cstdlib>  // abort(), strtod()
+#include <cstring>  // memchr(), memcpy()
+#include <limits>   // quiet_NaN(), is_integer
+#include <pthread.h>
+#include <unistd.h> // sysconf()
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // #ifdef __SSE2__
+
+#include <StdCout.hpp>
+
+#include "IO_Text_Parser.hpp"
+
+// Clinger's fast path is only exact if doubles are rounded once per
+// operation, not with x87's extended precision.
+#if !defined(__FLT_EVAL_METHOD__) || __FLT_EVAL_METHOD__ == 0
+#define IO_TEXT_PARSER_CLINGER
+#endif
+
+// The extended path needs x87's 64 bits long double (Linux's default
+// precision), with the significand in its first 8 bytes.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__LDBL_MANT_DIG__) && __LDBL_MANT_DIG__ == 64
+#define IO_TEXT_PARSER_EXTENDED
+#endif
+
+// Exactly representable powers of ten
+static const double powers_of_ten[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#ifdef IO_TEXT_PARSER_EXTENDED
+// Exactly representable in 64 bits significands: 5^27 < 2^64
+static const long double extended_powers_of_ten[] =
+{
+    1e0L,  1e1L,  1e2L,  1e3L,  1e4L,  1e5L,  1e6L,  1e7L,  1e8L,  1e9L,
+    1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+    1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+};
+
+// **************************************************************
+static inline bool Parse_Extended(const uint64_t mantissa, const int exponent, double &value)
+/**
+ * mantissa * 10^exponent computed in extended precision with at most
+ * two roundings (relative error below 2^-63), then rounded to double.
+ * The result is the correctly rounded double unless the extended value
+ * lies within a few of its units of a midpoint between two doubles:
+ * its 11 bits below the double's precision are then close to 0x400
+ * and the conversion is left to strtod() (about 0.4% of values).
+ * @return false if the value could not be computed exactly
+ */
+{
+    if (exponent < -54 || exponent > 54)
+        return false;
+
+    long double x = (long double) mantissa;
+    const int e = (exponent < 0 ? -exponent : exponent);
+    const long double power = (e <= 27 ? extended_powers_of_ten[e] : extended_powers_of_ten[27] * extended_powers_of_ten[e-27]);
+    x = (exponent < 0 ? x / power : x * power);
+
+    // Outside of the normal range of doubles, the 11 bits test is wrong.
+    if (!(x > 1e-300L && x < 1e300L))
+        return false;
+
+    uint64_t significand;
+    memcpy(&significand, &x, sizeof(uint64_t));
+    const int low_bits = int(significand & 0x7FF);
+    if (low_bits >= 0x400 - 4 && low_bits <= 0x400 + 4)
+        return false;
+
+    value = double(x);
+    return true;
+}
+#endif // #ifdef IO_TEXT_PARSER_EXTENDED
+
+// **************************************************************
+static inline bool Is_Blank(const char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
+// **************************************************************
+static inline const char * Find_Delimiter(const char *p, const char *end)
+/**
+ * First byte at or after p which is a space or a control character
+ * (' ', '\t', '\r', '\n', ...), or end.
+ */
+{
+#ifdef __SSE2__
+    // max(b, ' ') == ' ' if and only if b <= ' ' (unsigned)
+    const __m128i space = _mm_set1_epi8(' ');
+    while (p + 16 <= end)
+    {
+        const __m128i block = _mm_loadu_si128((const __m128i *) p);
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(block, space), space));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif // #ifdef __SSE2__
+    while (p < end && (unsigned char)(*p) > ' ')
+        p++;
+    return p;
+}
+
+// **************************************************************
+static inline const char * Skip_Blanks(const char *p, const char *end)
+{
+    while (p < end && Is_Blank(*p))
+        p++;
+    return p;
+}
+
+// **************************************************************
+static double Parse_Double_Slow(const char *begin, const char *end)
+{
+    char buffer[128];
+    const size_t size = size_t(end - begin);
+    if (size < sizeof(buffer))
+    {
+        memcpy(buffer, begin, size);
+        buffer[size] = '\0';
+        return strtod(buffer, NULL);
+    }
+    return strtod(std::string(begin, size).c_str(), NULL);
+}
+
+// **************************************************************
+double IO_Parse_Double(const char *begin, const char *end)
+/**
+ * Convert [begin, end) to the nearest double, like strtod(). Decimal
+ * numbers of at most 19 significant digits whose mantissa fits in 53
+ * bits and with a small enough exponent are converted with one
+ * multiplication or division of exact doubles (Clinger's fast path),
+ * which is correctly rounded. Longer ones ("%.17g") go through
+ * extended precision when it is available (see Parse_Extended()).
+ * Anything else goes to strtod().
+ */
+{
+#if defined(IO_TEXT_PARSER_CLINGER) || defined(IO_TEXT_PARSER_EXTENDED)
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int nb_digits = 0;          // Significant digits
+    int exponent = 0;
+    const char *digits_start = p;
+    while (p < end && (unsigned char)(*p - '0') < 10)
+    {
+        mantissa = 10*mantissa + uint64_t(*p - '0');
+        if (mantissa != 0)
+            nb_digits++;
+        p++;
+    }
+    bool has_digits = (p != digits_start);
+    if (p < end && *p == '.')
+    {
+        p++;
+        const char *fraction_start = p;
+        while (p < end && (unsigned char)(*p - '0') < 10)
+        {
+            mantissa = 10*mantissa + uint64_t(*p - '0');
+            if (mantissa != 0)
+                nb_digits++;
+            exponent--;
+            p++;
+        }
+        has_digits = has_digits || (p != fraction_start);
+    }
+    if (!has_digits || nb_digits > 19)
+        return Parse_Double_Slow(begin, end);
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative_exponent = (*p == '-');
+            p++;
+        }
+        const char *exponent_start = p;
+        int e = 0;
+        while (p < end && (unsigned char)(*p - '0') < 10 && e < 100000)
+        {
+            e = 10*e + (*p - '0');
+            p++;
+        }
+        if (p == exponent_start)
+            return Parse_Double_Slow(begin, end);
+        exponent += (negative_exponent ? -e : e);
+    }
+    if (p != end)
+        return Parse_Double_Slow(begin, end);
+
+    if (mantissa == 0)
+        return (negative ? -0.0 : 0.0);
+
+#ifdef IO_TEXT_PARSER_CLINGER
+    const uint64_t max_exact = uint64_t(1) << 53;
+    if (mantissa <= max_exact)
+    {
+        double value = double(mantissa);
+        if (exponent >= -22 && exponent <= 22)
+        {
+            value = (exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent]);
+            return (negative ? -value : value);
+        }
+        // "1.5e30": move some of the exponent into the mantissa if it stays exact.
+        if (exponent > 22 && exponent <= 22 + 15)
+        {
+            uint64_t shifted = mantissa;
+            int e = exponent;
+            while (e > 22 && shifted <= max_exact / 10)
+            {
+                shifted *= 10;
+                e--;
+            }
+            if (e == 22)
+            {
+                value = double(shifted) * powers_of_ten[22];
+                return (negative ? -value : value);
+            }
+        }
+    }
+#endif // #ifdef IO_TEXT_PARSER_CLINGER
+
+#ifdef IO_TEXT_PARSER_EXTENDED
+    double extended_value;
+    if (Parse_Extended(mantissa, exponent, extended_value))
+        return (negative ? -extended_value : extended_value);
+#endif // #ifdef IO_TEXT_PARSER_EXTENDED
+#endif // #if defined(IO_TEXT_PARSER_CLINGER) || defined(IO_TEXT_PARSER_EXTENDED)
+
+    return Parse_Double_Slow(begin, end);
+}
+
+// **************************************************************
+IO_Text_Parser::IO_Text_Parser()
+{
+    nb_threads  = 0;
+    nb_columns  = 0;
+}
+
+// **************************************************************
+IO_Text_Parser::IO_Text_Parser(const std::string _filename)
+{
+    nb_threads  = 0;
+    nb_columns  = 0;
+    Open(_filename);
+}
+
+// **************************************************************
+void IO_Text_Parser::Open(const std::string _filename)
+/**
+ * Map the file (inflate it in memory if compressed) and count the
+ * columns of its first data line.
+ */
+{
+    filename = _filename;
+    reader.Open(filename);
+    reader.Read_All(data);
+
+    nb_columns = 0;
+    const char *p   = data.data;
+    const char *end = data.data + data.size;
+    while (p < end)
+    {
+        p = Skip_Blanks(p, end);
+        if (p < end && *p != '\n' && *p != '#')
+            break;
+        const char *newline = (p < end ? (const char *) memchr(p, '\n', size_t(end - p)) : NULL);
+        p = (newline != NULL ? newline + 1 : end);
+    }
+    while (p < end && *p != '\n')
+    {
+        p = Skip_Blanks(Find_Delimiter(p, end), end);
+        nb_columns++;
+    }
+}
+
+// **************************************************************
+void IO_Text_Parser::Close()
+{
+    reader.Close();
+    data        = IO_Span();
+    nb_columns  = 0;
+}
+
+// **************************************************************
+void IO_Text_Parser::Set_Nb_Threads(const int _nb_threads)
+/**
+ * @param   _nb_threads     0 for one per processor (default)
+ */
+{
+    assert(_nb_threads >= 0);
+    nb_threads = _nb_threads;
+}
+
+// **************************************************************
+void IO_Text_Parser::Parse_Chunk(Chunk &chunk, const std::vector<int> &slots)
+{
+    const double nan    = std::numeric_limits<double>::quiet_NaN();
+    const int max_column = int(slots.size()) - 1;
+    const char *p       = chunk.begin;
+    const char *end     = chunk.end;
+
+    while (p < end)
+    {
+        p = Skip_Blanks(p, end);
+        if (p == end)
+            break;
+        if (*p == '\n' || *p == '#')
+        {
+            const char *newline = (const char *) memchr(p, '\n', size_t(end - p));
+            p = (newline != NULL ? newline + 1 : end);
+            continue;
+        }
+
+        int column = 0;
+        while (p < end && *p != '\n')
+        {
+            const char *token_end = Find_Delimiter(p, end);
+            if (slots[column] >= 0)
+                chunk.values[slots[column]].push_back(IO_Parse_Double(p, token_end));
+            p = Skip_Blanks(token_end, end);
+            if (++column > max_column)
+            {
+                // Other columns are not needed: go to the next line.
+                const char *newline = (p < end ? (const char *) memchr(p, '\n', size_t(end - p)) : NULL);
+                p = (newline != NULL ? newline : end);
+            }
+        }
+        for ( ; column <= max_column ; column++)
+            if (slots[column] >= 0)
+                chunk.values[slots[column]].push_back(nan);
+
+        if (p < end)
+            p++;    // '\n'
+    }
+}
+
+// **************************************************************
+void * IO_Text_Parser::Thread_Main(void *arg)
+{
+    Job *job = (Job *) arg;
+    while (true)
+    {
+        const int i = __sync_fetch_and_add(&job->next, 1);
+        if (i >= int(job->chunks->size()))
+            break;
+        Parse_Chunk((*job->chunks)[i], *job->slots);
+    }
+    return NULL;
+}
+
+// **************************************************************
+void IO_Text_Parser::Parse(const std::vector<int> &columns, std::vector<std::vector<double> > &values)
+/**
+ * Parse the given columns (any order), in parallel.
+ */
+{
+    assert(reader.Is_Open());
+
+    values.clear();
+    if (columns.empty())
+        return;
+
+    int max_column = -1;
+    for (size_t i = 0 ; i < columns.size() ; i++)
+    {
+        assert(columns[i] >= 0);
+        if (columns[i] > max_column)
+            max_column = columns[i];
+    }
+    std::vector<int> slots(max_column + 1, -1);
+    for (size_t i = 0 ; i < columns.size() ; i++)
+        slots[columns[i]] = int(i);
+
+    int nb_workers = (nb_threads > 0 ? nb_threads : int(sysconf(_SC_NPROCESSORS_ONLN)));
+    if (nb_workers < 1 || data.size < IO_TEXT_PARSER_MIN_PARALLEL_SIZE)
+        nb_workers = 1;
+
+    // A few chunks per thread balance lines of uneven cost.
+    const size_t nb_chunks = size_t(nb_workers == 1 ? 1 : 4*nb_workers);
+    std::vector<Chunk> chunks(nb_chunks);
+    const char *end = data.data + data.size;
+    const char *begin = data.data;
+    for (size_t i = 0 ; i < nb_chunks ; i++)
+    {
+        // Chunks end just after a '\n' (or at the end of file).
+        const char *chunk_end = data.data + (data.size / nb_chunks) * (i + 1);
+        if (i == nb_chunks - 1 || chunk_end >= end)
+        {
+            chunk_end = end;
+        }
+        else if (chunk_end > begin)
+        {
+            const char *newline = (const char *) memchr(chunk_end - 1, '\n', size_t(end - chunk_end + 1));
+            chunk_end = (newline != NULL ? newline + 1 : end);
+        }
+        else
+        {
+            chunk_end = begin;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end   = chunk_end;
+        chunks[i].values.resize(columns.size());
+        begin = chunk_end;
+    }
+
+    Job job;
+    job.chunks  = &chunks;
+    job.slots   = &slots;
+    job.next    = 0;
+
+    std::vector<pthread_t> threads(nb_workers - 1);
+    for (size_t i = 0 ; i < threads.size() ; i++)
+    {
+        if (pthread_create(&threads[i], NULL, IO_Text_Parser::Thread_Main, (void *) &job) != 0)
+        {
+            std_cout << "ERROR: Could not create parsing thread " << i << " for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+    }
+    Thread_Main((void *) &job);
+    for (size_t i = 0 ; i < threads.size() ; i++)
+        pthread_join(threads[i], NULL);
+
+    // Concatenate chunks, in file order.
+    values.resize(columns.size());
+    for (size_t c = 0 ; c < columns.size() ; c++)
+    {
+        size_t nb_values = 0;
+        for (size_t i = 0 ; i < nb_chunks ; i++)
+            nb_values += chunks[i].values[c].size();
+        values[c].clear();
+        values[c].reserve(nb_values);
+        for (size_t i = 0 ; i < nb_chunks ; i++)
+        {
+            values[c].insert(values[c].end(), chunks[i].values[c].begin(), chunks[i].values[c].end());
+            std::vector<double>().swap(chunks[i].values[c]);
+        }
+    }
+}
+
+// **************************************************************
+template <class T>
+static inline T Convert_Value(const double value, const T fill)
+/**
+ * NaN (missing value), infinities and values out of an integer type's
+ * range have no conversion to it: "fill" is returned instead.
+ */
+{
+    if (!std::numeric_limits<T>::is_integer)
+        return T(value);
+
+    // 2^(number of bits), exact, unlike double(max()) + 1.0
+    const double limit = 2.0 * double(std::numeric_limits<T>::max() / 2 + 1);
+    if (value >= double(std::numeric_limits<T>::min()) && value < limit)
+        return T(value);
+    return fill;
+}
+
+// **************************************************************
+template <class T>
+void IO_Text_Parser::Read(const int column, std::vector<T> &values, const T fill)
+/**
+ * One column (numbered from 0), one value per data line.
+ * @param fill  For integer types, stored for missing values (NaN for
+ *              floating point types) and values out of T's range
+ */
+{
+    std::vector<int> columns(1, column);
+    std::vector<std::vector<double> > parsed;
+    Parse(columns, parsed);
+
+    values.resize(parsed[0].size());
+    for (size_t i = 0 ; i < values.size() ; i++)
+        values[i] = Convert_Value<T>(parsed[0][i], fill);
+}
+
+// **************************************************************
+template <class T>
+void IO_Text_Parser::Read(std::vector<std::vector<T> > &columns, const T fill)
+/**
+ * Every column (see Get_Nb_Columns()). "fill" as for one column.
+ */
+{
+    std::vector<int> indexes(nb_columns);
+    for (int c = 0 ; c < nb_columns ; c++)
+        indexes[c] = c;
+    std::vector<std::vector<double> > parsed;
+    Parse(indexes, parsed);
+
+    columns.resize(parsed.size());
+    for (size_t c = 0 ; c < parsed.size() ; c++)
+    {
+        columns[c].resize(parsed[c].size());
+        for (size_t i = 0 ; i < parsed[c].size() ; i++)
+            columns[c][i] = Convert_Value<T>(parsed[c][i], fill);
+    }
+}
+
+template void IO_Text_Parser::Read<int>(   const int column, std::vector<int>    &values, const int    fill);
+template void IO_Text_Parser::Read<long>(  const int column, std::vector<long>   &values, const long   fill);
+template void IO_Text_Parser::Read<float>( const int column, std::vector<float>  &values, const float  fill);
+template void IO_Text_Parser::Read<double>(const int column, std::vector<double> &values, const double fill);
+template void IO_Text_Parser::Read<int>(   std::vector<std::vector<int> >    &columns, const int    fill);
+template void IO_Text_Parser::Read<long>(  std::vector<std::vector<long> >   &columns, const long   fill);
+template void IO_Text_Parser::Read<float>( std::vector<std::vector<float> >  &columns, const float  fill);
+template void IO_Text_Parser::Read<double>(std::vector<std::vector<double> > &columns, const double fill);
+
+// ********** End of file ***************************************
@@ -0,0 +1,77 @@
+#ifndef INC_IO_TEXT_PARSER_hpp
+#define INC_IO_TEXT_PARSER_hpp
+
+#include <string>
+#include <vector>
+#include <cstddef> // size_t
+
+#include "IO_Reader.hpp"
+
+// Files smaller than this are parsed by the calling thread only
+#define IO_TEXT_PARSER_MIN_PARALLEL_SIZE    (1024*1024)
+
+double IO_Parse_Double(const char *begin, const char *end);
+
+class IO_Text_Parser
+/**
+ * Bulk parser of whitespace-separated numeric columns, as written by
+ * IO::WriteString("%g %g ...\n"), plain or gzip.
+ *
+ *      IO_Text_Parser parser("output/energies.txt");
+ *      std::vector<double> kinetic;
+ *      parser.Read(2, kinetic);                    // Third column
+ *      std::vector<std::vector<float> > columns;
+ *      parser.Read(columns);                       // All of them
+ *
+ * The file is cut into chunks at line boundaries, parsed in parallel.
+ * Token boundaries are found 16 bytes at a time (SSE2), values are
+ * converted with exact fast paths (Clinger's, then extended precision
+ * on x86) and strtod() for the rare values outside of them. Columns not asked for are skipped without
+ * being converted.
+ *
+ * Lines starting with '#' and empty lines are skipped. The number of
+ * columns is the first data line's; a line with fewer values gives NaN
+ * for the missing ones. Integer types have no NaN: missing values and
+ * values out of range are read as "fill" (0 by default).
+ */
+{
+    private:
+        struct Chunk
+        {
+            const char *begin;
+            const char *end;
+            std::vector<std::vector<double> > values;   // Per requested column
+        };
+        struct Job
+        {
+            std::vector<Chunk> *chunks;
+            const std::vector<int> *slots;  // Per column: index in Chunk::values, or -1
+            int next;                       // Next chunk to parse
+        };
+
+        std::string filename;
+        IO_Reader reader;
+        IO_Span data;
+        int nb_threads;
+        int nb_columns;
+
+        static void * Thread_Main(void *arg);
+        static void Parse_Chunk(Chunk &chunk, const std::vector<int> &slots);
+        void Parse(const std::vector<int> &columns, std::vector<std::vector<double> > &values);
+
+    public:
+        IO_Text_Parser();
+        IO_Text_Parser(const std::string _filename);
+        void Open(const std::string _filename);
+        void Close();
+
+        void Set_Nb_Threads(const int _nb_threads);
+        inline int Get_Nb_Columns() { return nb_columns; }
+
+        template <class T> void Read(const int column, std::vector<T> &values, const T fill = T(0));
+        template <class T> void Read(std::vector<std::vector<T> > &columns, const T fill = T(0));
+};
+
+#endif // INC_IO_TEXT_PARSER_hpp
+
+// ********** End of file ***************************************
@@ -0,0 +1,409 @@
+
+#include <cstdlib>  // abort(), posix_memalign()
+#include <cstring>  // memcpy(), memset(), strerror()
+#include <cerrno>
+#include <algorithm> // std::min(), std::max()
+#include <fcntl.h>  // open()
+#include <unistd.h> // pwrite(), lseek()
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif // #ifdef HAVE_IO_URING
+
+#include <StdCout.hpp>
+
+#include "IO_Uring_Writer.hpp"
+
+#ifdef HAVE_IO_URING
+// **************************************************************
+static int Uring_Enter(const int ring_fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags)
+{
+    int result;
+    do
+    {
+        result = int(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0));
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+#endif // #ifdef HAVE_IO_URING
+
+// **************************************************************
+IO_Uring_Writer::IO_Uring_Writer()
+{
+    fd              = -1;
+    buffer_size     = IO_URING_DEFAULT_BUFFER_SIZE;
+    file_offset     = 0;
+    current         = -1;
+    current_size    = 0;
+    in_flight       = 0;
+
+    ring_fd         = -1;
+    fixed_buffers   = false;
+    sq_ring         = NULL;
+    cq_ring         = NULL;
+    sqes            = NULL;
+    sq_ring_size    = 0;
+    cq_ring_size    = 0;
+    sqes_size       = 0;
+    sq_tail         = NULL;
+    sq_mask         = NULL;
+    sq_array        = NULL;
+    cq_head         = NULL;
+    cq_tail         = NULL;
+    cq_mask         = NULL;
+    cqes            = NULL;
+}
+
+// **************************************************************
+IO_Uring_Writer::~IO_Uring_Writer()
+{
+    Close();
+}
+
+// **************************************************************
+bool IO_Uring_Writer::Open(const std::string &_filename, const bool append,
+                           const int depth, const size_t _buffer_size)
+{
+    assert(fd == -1);
+    assert(depth > 0);
+    assert(_buffer_size > 0);
+
+    filename    = _filename;
+    buffer_size = _buffer_size;
+
+    // No O_APPEND: every write has an explicit offset, and writes in
+    // flight may complete in any order.
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0644);
+    if (fd == -1)
+        return false;
+
+    file_offset = 0;
+    if (append)
+        file_offset = uint64_t(lseek(fd, 0, SEEK_END));
+
+    buffers.resize(depth);
+    buffer_offsets.resize(depth);
+    buffer_lengths.resize(depth);
+    buffer_iovecs.resize(depth);
+    free_buffers.clear();
+    for (int i = depth-1 ; i >= 0 ; i--)
+    {
+        void *p = NULL;
+        if (posix_memalign(&p, 4096, buffer_size) != 0)
+        {
+            std_cout << "ERROR: Could not allocate " << buffer_size << " bytes for file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        buffers[i] = (char *) p;
+        free_buffers.push_back(i);
+    }
+    current         = -1;
+    current_size    = 0;
+    in_flight       = 0;
+
+    if (!Setup_Ring(unsigned(depth)))
+        std_cout << "io_uring not available for file '" << filename << "', using pwrite().\n";
+
+    return true;
+}
+
+// **************************************************************
+bool IO_Uring_Writer::Setup_Ring(const unsigned depth)
+{
+#ifdef HAVE_IO_URING
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = int(syscall(__NR_io_uring_setup, depth, &params));
+    if (ring_fd < 0)
+    {
+        ring_fd = -1;
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+#else // #ifdef IORING_FEAT_SINGLE_MMAP
+    // Headers older than Linux 5.4: the two rings are always mapped.
+    const bool single_mmap = false;
+#endif // #ifdef IORING_FEAT_SINGLE_MMAP
+    if (single_mmap)
+    {
+        sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        cq_ring_size = sq_ring_size;
+    }
+
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        sq_ring = NULL;
+        Teardown_Ring();
+        return false;
+    }
+    if (single_mmap)
+        cq_ring = sq_ring;
+    else
+    {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            cq_ring = NULL;
+            Teardown_Ring();
+            return false;
+        }
+    }
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        sqes = NULL;
+        Teardown_Ring();
+        return false;
+    }
+
+    sq_tail  = (unsigned *) ((char *) sq_ring + params.sq_off.tail);
+    sq_mask  = (unsigned *) ((char *) sq_ring + params.sq_off.ring_mask);
+    sq_array = (unsigned *) ((char *) sq_ring + params.sq_off.array);
+    cq_head  = (unsigned *) ((char *) cq_ring + params.cq_off.head);
+    cq_tail  = (unsigned *) ((char *) cq_ring + params.cq_off.tail);
+    cq_mask  = (unsigned *) ((char *) cq_ring + params.cq_off.ring_mask);
+    cqes     = (void *)     ((char *) cq_ring + params.cq_off.cqes);
+
+    // Registered buffers save the kernel from mapping them at every
+    // write. Registration can fail (RLIMIT_MEMLOCK): vectored writes
+    // then, since IORING_OP_WRITE needs Linux 5.6.
+    std::vector<struct iovec> iovecs(buffers.size());
+    for (size_t i = 0 ; i < buffers.size() ; i++)
+    {
+        iovecs[i].iov_base = buffers[i];
+        iovecs[i].iov_len  = buffer_size;
+    }
+    fixed_buffers = (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &iovecs[0], unsigned(iovecs.size())) == 0);
+
+    return true;
+#else // #ifdef HAVE_IO_URING
+    return false;
+#endif // #ifdef HAVE_IO_URING
+}
+
+// **************************************************************
+void IO_Uring_Writer::Teardown_Ring()
+{
+#ifdef HAVE_IO_URING
+    if (sqes != NULL)
+        munmap(sqes, sqes_size);
+    if (cq_ring != NULL && cq_ring != sq_ring)
+        munmap(cq_ring, cq_ring_size);
+    if (sq_ring != NULL)
+        munmap(sq_ring, sq_ring_size);
+    // Closing the ring also unregisters the buffers.
+    if (ring_fd != -1)
+        close(ring_fd);
+#endif // #ifdef HAVE_IO_URING
+    sqes            = NULL;
+    cq_ring         = NULL;
+    sq_ring         = NULL;
+    ring_fd         = -1;
+    fixed_buffers   = false;
+}
+
+// **************************************************************
+void IO_Uring_Writer::Pwrite(const char *p, const size_t size, const uint64_t offset)
+{
+    size_t written = 0;
+    while (written < size)
+    {
+        const ssize_t result = pwrite(fd, p + written, size - written, off_t(offset + written));
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+        {
+            std_cout << "ERROR: Could not write to file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        written += size_t(result);
+    }
+}
+
+// **************************************************************
+void IO_Uring_Writer::Submit_Current()
+/**
+ * Queue the current buffer as a write at the end of what was already
+ * submitted.
+ */
+{
+    assert(current != -1);
+
+    buffer_offsets[current] = file_offset;
+    buffer_lengths[current] = current_size;
+    file_offset += current_size;
+
+    if (ring_fd == -1)
+    {
+        Pwrite(buffers[current], current_size, buffer_offsets[current]);
+        free_buffers.push_back(current);
+    }
+    else
+    {
+#ifdef HAVE_IO_URING
+        // Each buffer is in flight at most once and the ring has one
+        // entry per buffer: there is always a free submission entry.
+        const unsigned tail  = *sq_tail;
+        const unsigned index = tail & *sq_mask;
+        struct io_uring_sqe *sqe = ((struct io_uring_sqe *) sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd         = fd;
+        sqe->off        = buffer_offsets[current];
+        if (fixed_buffers)
+        {
+            sqe->opcode     = IORING_OP_WRITE_FIXED;
+            sqe->addr       = (unsigned long) buffers[current];
+            sqe->len        = unsigned(current_size);
+            sqe->buf_index  = uint16_t(current);
+        }
+        else
+        {
+            // The iovec must stay valid until the write completes.
+            buffer_iovecs[current].iov_base = buffers[current];
+            buffer_iovecs[current].iov_len  = current_size;
+            sqe->opcode     = IORING_OP_WRITEV;
+            sqe->addr       = (unsigned long) &buffer_iovecs[current];
+            sqe->len        = 1;
+        }
+        sqe->user_data  = uint64_t(current);
+        sq_array[index] = index;
+
+        __sync_synchronize();
+        *sq_tail = tail + 1;
+        __sync_synchronize();
+
+        if (Uring_Enter(ring_fd, 1, 0, 0) < 0)
+        {
+            std_cout << "ERROR: io_uring submission failed for file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        in_flight++;
+#endif // #ifdef HAVE_IO_URING
+    }
+
+    current         = -1;
+    current_size    = 0;
+}
+
+// **************************************************************
+void IO_Uring_Writer::Reap(const bool wait)
+/**
+ * Process available completions, returning their buffers to the free
+ * list. If "wait", block until at least one completion was processed.
+ */
+{
+#ifdef HAVE_IO_URING
+    bool reaped = false;
+    while (true)
+    {
+        unsigned head = *cq_head;
+        __sync_synchronize();
+        if (head == *cq_tail)
+        {
+            if (!wait || reaped || in_flight == 0)
+                break;
+            if (Uring_Enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+            {
+                std_cout << "ERROR: Waiting for io_uring completions failed for file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+                abort();
+            }
+            continue;
+        }
+
+        const struct io_uring_cqe *cqe = ((const struct io_uring_cqe *) cqes) + (head & *cq_mask);
+        const int buffer = int(cqe->user_data);
+        const int result = cqe->res;
+
+        __sync_synchronize();
+        *cq_head = head + 1;
+
+        // Rejected by the kernel (e.g. an operation it does not know):
+        // written synchronously instead.
+        if (result == -EINVAL || result == -EOPNOTSUPP)
+            Pwrite(buffers[buffer], buffer_lengths[buffer], buffer_offsets[buffer]);
+        else if (result < 0)
+        {
+            std_cout << "ERROR: Could not write to file '" << filename << "': " << strerror(-result) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        // Short write (e.g. interrupted): finish it synchronously.
+        else if (size_t(result) < buffer_lengths[buffer])
+            Pwrite(buffers[buffer] + result, buffer_lengths[buffer] - size_t(result), buffer_offsets[buffer] + uint64_t(result));
+
+        free_buffers.push_back(buffer);
+        in_flight--;
+        reaped = true;
+    }
+#endif // #ifdef HAVE_IO_URING
+}
+
+// **************************************************************
+void IO_Uring_Writer::Write(const char *p, const size_t size)
+{
+    assert(fd != -1);
+
+    size_t written = 0;
+    while (written < size)
+    {
+        if (current == -1)
+        {
+            while (free_buffers.empty())
+                Reap(true);
+            current = free_buffers.back();
+            free_buffers.pop_back();
+            current_size = 0;
+        }
+
+        const size_t n = std::min(size - written, buffer_size - current_size);
+        memcpy(buffers[current] + current_size, p + written, n);
+        current_size += n;
+        written += n;
+
+        if (current_size == buffer_size)
+            Submit_Current();
+    }
+}
+
+// **************************************************************
+void IO_Uring_Writer::Flush()
+/**
+ * Submit the partial buffer and wait until every write completed.
+ */
+{
+    if (fd == -1)
+        return;
+
+    if (current != -1 && current_size > 0)
+        Submit_Current();
+    while (in_flight > 0)
+        Reap(true);
+}
+
+// **************************************************************
+void IO_Uring_Writer::Close()
+{
+    if (fd == -1)
+        return;
+
+    Flush();
+    Teardown_Ring();
+
+    for (size_t i = 0 ; i < buffers.size() ; i++)
+        free(buffers[i]);
+    buffers.clear();
+    free_buffers.clear();
+    current = -1;
+
+    close(fd);
+    fd = -1;
+}
+
+// ********** End of file ***************************************
@@ -0,0 +1,92 @@
+#ifndef INC_IO_URING_WRITER_hpp
+#define INC_IO_URING_WRITER_hpp
+
+#include <string>
+#include <vector>
+#include <sys/uio.h> // struct iovec
+
+#ifdef __PGI
+#include <boost/cstdint.hpp>
+using namespace boost;
+#else
+#include <stdint.h> // (u)int64_t
+#endif // #ifdef __PGI
+
+#include "IO_Sink.hpp"
+
+// Default number of buffers (and so of writes in flight)
+#define IO_URING_DEFAULT_DEPTH          8
+// Size of each buffer (bytes)
+#define IO_URING_DEFAULT_BUFFER_SIZE    (1024*1024)
+
+class IO_Uring_Writer : public IO_Sink
+/**
+ * Output through io_uring (Linux >= 5.1, enabled with -DHAVE_IO_URING).
+ *
+ * Writes are copied into a set of buffers registered with the kernel
+ * (or, if registration fails, e.g. RLIMIT_MEMLOCK too low, submitted
+ * as vectored writes). A full buffer is submitted as a write at its own
+ * file offset, so up to "depth" writes are in flight while the next
+ * buffer is filled.
+ * Completions are polled when a buffer is needed and on Flush(); in
+ * "async" mode, this happens in IO_Async_Writer's flusher thread.
+ *
+ * If io_uring is not available (old kernel, seccomp, not compiled in),
+ * buffers are written synchronously with pwrite(). So is a buffer whose
+ * write the kernel rejects as invalid.
+ */
+{
+    private:
+        std::string filename;
+        int fd;
+        size_t buffer_size;
+        uint64_t file_offset;           // Offset of the next submitted buffer
+
+        std::vector<char *> buffers;
+        std::vector<uint64_t> buffer_offsets;   // File offset of each submitted buffer
+        std::vector<size_t> buffer_lengths;
+        std::vector<struct iovec> buffer_iovecs;    // Unregistered buffers
+        std::vector<int> free_buffers;
+        int current;                    // Buffer being filled (-1: none)
+        size_t current_size;
+        int in_flight;
+
+        // Ring (ring_fd == -1: pwrite() fallback)
+        int ring_fd;
+        bool fixed_buffers;             // Buffers registered with the kernel
+        void  *sq_ring;
+        void  *cq_ring;
+        void  *sqes;
+        size_t sq_ring_size;
+        size_t cq_ring_size;
+        size_t sqes_size;
+        unsigned *sq_tail;
+        unsigned *sq_mask;
+        unsigned *sq_array;
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned *cq_mask;
+        void  *cqes;
+
+        bool Setup_Ring(const unsigned depth);
+        void Teardown_Ring();
+        void Pwrite(const char *p, const size_t size, const uint64_t offset);
+        void Submit_Current();
+        void Reap(const bool wait);
+
+    public:
+        IO_Uring_Writer();
+        ~IO_Uring_Writer();
+        bool Open(const std::string &_filename, const bool append,
+                  const int depth = IO_URING_DEFAULT_DEPTH,
+                  const size_t _buffer_size = IO_URING_DEFAULT_BUFFER_SIZE);
+        void Write(const char *p, const size_t size);
+        void Flush();
+        void Close();
+
+        inline bool Is_Using_Uring()    { return (ring_fd != -1); }
+};
+
+#endif // INC_IO_URING_WRITER_hpp
+
+// ********** End of file ***************************************
@@ -7,12 +7,29 @@
 #include <climits> // CHAR_BIT
 #include <sys/stat.h> // Check if folder exists
 #include <algorithm> // tolower
+#include <unistd.h> // sysconf()
+#include <cerrno>
+#include <sys/uio.h> // writev()
 
 
 #include <StdCout.hpp>
 
 #include "Constants.hpp"
 #include "InputOutput.hpp"
+#include "IO_Async_Writer.hpp"
+#include "IO_Sink.hpp"
+#include "IO_Codec.hpp"
+#include "IO_Parallel_Compressor.hpp"
+#include "IO_Mmap_Writer.hpp"
+#include "IO_Uring_Writer.hpp"
+#include "IO_Gzip_Index.hpp"
+#include "IO_Gather.hpp"
+#include "IO_Segments.hpp"
+#include "IO_Ring_Buffer.hpp"
+#include "IO_Live.hpp"
+#include "IO_Migrator.hpp"
+#include "IO_Scheduler.hpp"
+#include "IO_Producers.hpp"
 
 #define DEBUGP(x)  std_cout << __FILE__ << ":" << __LINE__ << ":\n    " << x;
 
@@ -164,6 +181,50 @@ FILE * Open_File(const std::string &filename, const std::string &mode, const boo
     return fh;
 }
 
+// **************************************************************
+std::string Mode_Flags(const std::string &full_mode)
+/**
+ * Return the single letter flags of a mode string. A mode string is
+ * made of flags ("w", "a", "r", "b", "z") optionally followed by
+ * colon-separated options: "wz:async" or "w:async=1048576".
+ * The flags are everything before the first colon.
+ */
+{
+    return full_mode.substr(0, full_mode.find(':'));
+}
+
+// **************************************************************
+bool Mode_Option(const std::string &full_mode, const std::string &key, std::string &value)
+/**
+ * Search the options of a mode string for "key" or "key=value".
+ * @param full_mode     Mode string as passed to IO::Open_File()
+ * @param key           Option to search for
+ * @param value         Set to the text after "=" (empty if none)
+ * @return              true if the option is present
+ */
+{
+    value = "";
+
+    size_t start = full_mode.find(':');
+    while (start != std::string::npos)
+    {
+        const size_t end = full_mode.find(':', start+1);
+        const std::string option = full_mode.substr(start+1, (end == std::string::npos ? std::string::npos : end-start-1));
+
+        const size_t equal = option.find('=');
+        if (option.substr(0, equal) == key)
+        {
+            if (equal != std::string::npos)
+                value = option.substr(equal+1);
+            return true;
+        }
+
+        start = end;
+    }
+
+    return false;
+}
+
 // **************************************************************
 inline std::string Pause(std::string msg = std::string(""))
 {
@@ -194,17 +255,30 @@ void IO::Clear()
     compressed              = false;
     compressed_fh           = NULL;
     string_to_save          = NULL;
+    async_writer            = NULL;
+    producers               = NULL;
+    sink                    = NULL;
+    gather                  = NULL;
+    ring                    = NULL;
+    priority                = IO_Rate_Limiter::Snapshot;
+    unmetered_bytes         = 0;
+    reader                  = NULL;
+    is_emergency_client     = false;
 }
 
 // **************************************************************
 IO::IO()
 {
+    scheduler               = NULL;
+    scheduler_index         = -1;
     Clear();
 }
 
 // **************************************************************
 IO::IO(const bool _enable)
 {
+    scheduler               = NULL;
+    scheduler_index         = -1;
     Clear();
     enable                  = _enable;
 }
@@ -213,6 +287,9 @@ IO::IO(const bool _enable)
 IO::~IO()
 {
     this->Close_File();
+
+    if (scheduler != NULL)
+        scheduler->Remove(this);
 }
 
 // **************************************************************
@@ -233,6 +310,8 @@ void IO::Set_Period(const double _period)
         enable  = true;
 
     period = _period;
+
+    Notify_Scheduler();
 }
 
 // **************************************************************
@@ -251,12 +330,21 @@ void IO::Set_Filename(const std::string _path, const std::string _filename)
 void IO::Enable()
 {
     enable = true;
+    Notify_Scheduler();
 }
 
 // **************************************************************
 void IO::Disable()
 {
     enable = false;
+    Notify_Scheduler();
+}
+
+// **************************************************************
+void IO::Notify_Scheduler()
+{
+    if (scheduler != NULL)
+        scheduler->Notify(this);
 }
 
 // **************************************************************
@@ -268,19 +356,22 @@ bool IO::Open_File(const std::string full_mode, const bool quiet,
 
     using_C_fh = _using_C_fh;
 
+    // Options (after the first ':') are not passed to fopen()/open().
+    const std::string flags = Mode_Flags(full_mode);
+
     std::ios_base::openmode file_openmode;
-    if (full_mode.find("a") != std::string::npos)
+    if (flags.find("a") != std::string::npos)
     {
         append = true;
         mode = 'a';
         file_openmode = std::fstream::out | std::fstream::app;
     }
-    else if (full_mode.find("w") != std::string::npos)
+    else if (flags.find("w") != std::string::npos)
     {
         mode = 'w';
         file_openmode = std::fstream::out;
     }
-    else if (full_mode.find("r") != std::string::npos)
+    else if (flags.find("r") != std::string::npos)
     {
         mode = 'r';
         file_openmode = std::fstream::in;
@@ -291,7 +382,31 @@ bool IO::Open_File(const std::string full_mode, const bool quiet,
         abort();
     }
 
-    if (full_mode.find("z") != std::string::npos)
+    // Block compression through a codec: "wz:codec=zstd:level=3", "wz:threads=4"
+    IO_Codec *codec = NULL;
+    std::string codec_name;
+    std::string option_value;
+    const bool has_codec = Mode_Option(full_mode, "codec", codec_name);
+    if (has_codec or (flags.find("z") != std::string::npos and Mode_Option(full_mode, "threads", option_value)))
+    {
+        int level = IO_CODEC_DEFAULT_LEVEL;
+        if (Mode_Option(full_mode, "level", option_value))
+            level = atoi(option_value.c_str());
+
+        codec = New_IO_Codec((codec_name == "" ? "deflate" : codec_name), level);
+        if (codec != NULL)
+        {
+            compressed = true;
+            filename += codec->Extension();
+        }
+        else
+        {
+            // If library not compiled with this codec, disable compression.
+            compressed = false;
+            std_cout << "Compression for file '" << filename << "' disabled.\n";
+        }
+    }
+    else if (flags.find("z") != std::string::npos)
     {
 #ifdef COMPRESS_OUTPUT
         compressed = true;
@@ -303,26 +418,349 @@ bool IO::Open_File(const std::string full_mode, const bool quiet,
 #endif // #ifdef COMPRESS_OUTPUT
     }
 
-    if (full_mode.find("b") != std::string::npos)
+    if (flags.find("b") != std::string::npos)
     {
         binary = true;
         file_openmode |= std::fstream::binary;
     }
 
+    if (codec != NULL and mode == 'r')
+    {
+        std_cout << "ERROR: Options 'codec' and 'threads' are only valid for writing (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Memory-mapped output: "wb:mmap", "ab:mmap=16777216" (window size)
+    std::string mmap_value;
+    const bool use_mmap = Mode_Option(full_mode, "mmap", mmap_value);
+    if (use_mmap and (mode == 'r' or compressed))
+    {
+        std_cout << "ERROR: Option 'mmap' is only valid for uncompressed writing (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // io_uring output: "w:uring", "w:uring=16" (writes in flight)
+    std::string uring_value;
+    const bool use_uring = Mode_Option(full_mode, "uring", uring_value);
+    if (use_uring and (mode == 'r' or compressed or use_mmap))
+    {
+        std_cout << "ERROR: Option 'uring' is only valid for uncompressed writing without 'mmap' (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Seekable gzip: "wz:index", "wz:index=262144" (bytes between restart points)
+    std::string index_value;
+    bool use_index = Mode_Option(full_mode, "index", index_value);
+    if (use_index and (mode == 'r' or flags.find("z") == std::string::npos or has_codec or codec != NULL or use_mmap or use_uring or
+                       Mode_Option(full_mode, "async", option_value) or Mode_Option(full_mode, "producers", option_value)))
+    {
+        std_cout << "ERROR: Option 'index' is only valid for 'z' writing without 'codec', 'threads', 'mmap', 'uring', 'async' or 'producers' (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+    if (use_index and !compressed)
+    {
+        std_cout << "Index for file '" << filename << "' disabled (no compression).\n";
+        use_index = false;
+    }
+
+    // Rotation: "w:rotate=1073741824" (bytes), "w:rotate_time=100" (simulation
+    // time, see Set_Time()), "rotate_codec=zstd" or "none" for the closed segments.
+    std::string rotate_value;
+    std::string rotate_time_value;
+    const bool rotate_on_size = Mode_Option(full_mode, "rotate", rotate_value);
+    const bool rotate_on_time = Mode_Option(full_mode, "rotate_time", rotate_time_value);
+    const bool use_rotate = (rotate_on_size or rotate_on_time);
+    if (use_rotate and (mode == 'r' or flags.find("z") != std::string::npos or has_codec or codec != NULL or use_mmap or use_uring or use_index or
+                        Mode_Option(full_mode, "async", option_value) or durability.Is_Enabled()))
+    {
+        std_cout << "ERROR: Options 'rotate' and 'rotate_time' are only valid for uncompressed writing without 'codec', 'threads', 'mmap', 'uring', 'index', 'async' or a durability policy (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+    if ((rotate_on_size and rotate_value == "") or (rotate_on_time and rotate_time_value == ""))
+    {
+        std_cout << "ERROR: Options 'rotate' and 'rotate_time' need a value (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Flight recorder: "w:ring=1000" (records), "w:ring_time=10" (simulation
+    // time, see Set_Time()), "ring_bytes=1048576" (memory). Dumped by Dump().
+    std::string ring_value;
+    std::string ring_time_value;
+    std::string ring_bytes_value;
+    const bool ring_on_count = Mode_Option(full_mode, "ring", ring_value);
+    const bool ring_on_time  = Mode_Option(full_mode, "ring_time", ring_time_value);
+    const bool ring_on_bytes = Mode_Option(full_mode, "ring_bytes", ring_bytes_value);
+    const bool use_ring = (ring_on_count or ring_on_time or ring_on_bytes);
+    if (use_ring and (mode == 'r' or flags.find("z") != std::string::npos or has_codec or codec != NULL or use_mmap or use_uring or use_index or use_rotate or
+                      Mode_Option(full_mode, "async", option_value) or durability.Is_Enabled()))
+    {
+        std_cout << "ERROR: Options 'ring', 'ring_time' and 'ring_bytes' are only valid for uncompressed writing without 'codec', 'threads', 'mmap', 'uring', 'index', 'rotate', 'async' or a durability policy (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+    if ((ring_on_time and ring_time_value == "") or (ring_on_bytes and ring_bytes_value == ""))
+    {
+        std_cout << "ERROR: Options 'ring_time' and 'ring_bytes' need a value (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Live output: "w:socket" (UNIX socket) or "w:fifo" (named pipe) instead of
+    // a file, "socket=1048576" (bytes queued per slow subscriber), see IO_Live_Writer.
+    std::string socket_value;
+    std::string fifo_value;
+    const bool use_socket = Mode_Option(full_mode, "socket", socket_value);
+    const bool use_fifo   = Mode_Option(full_mode, "fifo", fifo_value);
+    const bool use_live   = (use_socket or use_fifo);
+    const std::string live_value = (use_fifo ? fifo_value : socket_value);
+    if (use_live and (mode == 'r' or (use_socket and use_fifo) or flags.find("z") != std::string::npos or has_codec or codec != NULL or use_mmap or use_uring or
+                      use_index or use_rotate or use_ring or Mode_Option(full_mode, "async", option_value) or durability.Is_Enabled()))
+    {
+        std_cout << "ERROR: Options 'socket' and 'fifo' are exclusive and only valid for uncompressed writing without 'codec', 'threads', 'mmap', 'uring', 'index', 'rotate', 'ring', 'async' or a durability policy (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Page cache: "w:stream", "w:stream=16777216" (window), see IO_Streaming.
+    streaming = IO_Streaming();
+    if (Mode_Option(full_mode, "stream", option_value))
+    {
+        if (mode == 'r' or use_mmap or use_rotate or use_ring or use_live)
+        {
+            std_cout << "ERROR: Option 'stream' is only valid for writing without 'mmap', 'rotate', 'ring', 'socket' or 'fifo' (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+            abort();
+        }
+        streaming = IO_Streaming(option_value == "" ? uint64_t(IO_STREAMING_DEFAULT_WINDOW) : uint64_t(strtoull(option_value.c_str(), NULL, 10)));
+    }
+
+    // Rate limiter class: "w:priority=checkpoint", "snapshot" (default),
+    // "diagnostic" or "none" (not limited), see IO_Rate_Limiter.
+    priority        = IO_Rate_Limiter::Snapshot;
+    unmetered_bytes = 0;
+    if (Mode_Option(full_mode, "priority", option_value) and !IO_Rate_Limiter::Priority_From_Name(option_value, priority))
+    {
+        std_cout << "ERROR: Option 'priority' must be 'checkpoint', 'snapshot', 'diagnostic' or 'none' (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Durability policy: the file may be written under a temporary name.
+    std::string open_filename = filename;
+    if (durability.Is_Enabled() and mode != 'r')
+    {
+        if (append and durability.Is_Atomic_Rename())
+        {
+            std_cout << "ERROR: Atomic rename can't be used to append to file '" << filename << "'. Aborting.\n" << std::flush;
+            abort();
+        }
+        open_filename = durability.Open(filename);
+    }
+
+    // Burst-buffer staging: "w:stage=/local/scratch". The file is written there
+    // and copied to its final name in the background once closed (see IO_Migrator).
+    std::string stage_value;
+    if (Mode_Option(full_mode, "stage", stage_value))
+    {
+        if (mode != 'w' or stage_value == "" or use_rotate or use_index or use_ring or use_live or durability.Is_Enabled())
+        {
+            std_cout << "ERROR: Option 'stage' needs a folder and is only valid for 'w' mode without 'rotate', 'index', 'ring', 'socket', 'fifo' or a durability policy (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+            abort();
+        }
+        staged_filename = IO_Migrator::Instance().Stage(stage_value, filename);
+        open_filename   = staged_filename;
+    }
+
+    if (mode != 'r')
+        stats.Open(open_filename, append);
+
     bool retry = true;
     while (retry)
     {
         if (!quiet)
-            std_cout << "Opening file \"" << filename << "\" for '" << full_mode << "'...\n";
+            std_cout << "Opening file \"" << open_filename << "\" for '" << full_mode << "'...\n";
 
-        if (Is_Compressed())
+        if (codec != NULL)
+        {
+            // Blocks compressed by the caller, or by a pool of "threads" workers.
+            int nb_threads = 0;
+            if (Mode_Option(full_mode, "threads", option_value))
+                nb_threads = (option_value == "" ? int(sysconf(_SC_NPROCESSORS_ONLN)) : atoi(option_value.c_str()));
+            size_t block_size = IO_PARALLEL_DEFAULT_BLOCK_SIZE;
+            if (Mode_Option(full_mode, "block", option_value))
+                block_size = size_t(strtoul(option_value.c_str(), NULL, 10));
+
+            IO_Parallel_Compressor *compressor = new IO_Parallel_Compressor;
+            // The compressor owns the codec from now on.
+            const bool is_opened = compressor->Open(open_filename, append, codec, (nb_threads > 0 ? nb_threads : 0), block_size);
+            codec = NULL;
+            if (is_opened)
+            {
+                sink = compressor;
+                retry = false;
+            }
+            else
+            {
+                delete compressor;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+        }
+        else if (use_mmap)
+        {
+            size_t window_size = IO_MMAP_DEFAULT_WINDOW_SIZE;
+            if (mmap_value != "")
+                window_size = size_t(strtoul(mmap_value.c_str(), NULL, 10));
+
+            IO_Mmap_Writer *mmap_writer = new IO_Mmap_Writer;
+            if (mmap_writer->Open(open_filename, append, window_size))
+            {
+                sink = mmap_writer;
+                retry = false;
+            }
+            else
+            {
+                delete mmap_writer;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+        }
+        else if (use_uring)
+        {
+            int depth = IO_URING_DEFAULT_DEPTH;
+            if (uring_value != "")
+                depth = atoi(uring_value.c_str());
+            assert(depth > 0);
+
+            IO_Uring_Writer *uring_writer = new IO_Uring_Writer;
+            if (uring_writer->Open(open_filename, append, depth))
+            {
+                sink = uring_writer;
+                retry = false;
+            }
+            else
+            {
+                delete uring_writer;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+        }
+        else if (use_rotate)
+        {
+            const uint64_t max_bytes = (rotate_on_size ? uint64_t(strtoul(rotate_value.c_str(), NULL, 10)) : 0);
+            const double rotate_period = (rotate_on_time ? atof(rotate_time_value.c_str()) : 0.0);
+            assert(max_bytes > 0 or rotate_period > 0.0);
+
+            std::string rotate_codec;
+            if (!Mode_Option(full_mode, "rotate_codec", rotate_codec) or rotate_codec == "")
+                rotate_codec = "deflate";
+            int level = IO_CODEC_DEFAULT_LEVEL;
+            if (Mode_Option(full_mode, "level", option_value))
+                level = atoi(option_value.c_str());
+            // If the codec was not compiled in, segments stay uncompressed.
+            IO_Codec *segment_codec = (rotate_codec == "none" ? NULL : New_IO_Codec(rotate_codec, level));
+
+            IO_Rotating_Writer *rotating_writer = new IO_Rotating_Writer;
+            // The writer owns the codec from now on.
+            if (rotating_writer->Open(open_filename, append, max_bytes, rotate_period, segment_codec))
+            {
+                sink = rotating_writer;
+                retry = false;
+            }
+            else
+            {
+                delete rotating_writer;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+        }
+        else if (use_ring)
+        {
+            const size_t max_records = (ring_value != "" ? size_t(strtoul(ring_value.c_str(), NULL, 10)) : 0);
+            const double ring_period = (ring_on_time ? atof(ring_time_value.c_str()) : 0.0);
+            const size_t ring_bytes  = (ring_on_bytes ? size_t(strtoul(ring_bytes_value.c_str(), NULL, 10)) : size_t(IO_RING_DEFAULT_BYTES));
+            assert(ring_bytes > 0);
+
+            // The file is only created by the first dump.
+            ring = new IO_Ring_Buffer;
+            ring->Open(open_filename, append, !binary, max_records, ring_period, ring_bytes);
+            sink = ring;
+            retry = false;
+        }
+        else if (use_live)
+        {
+            const size_t backlog = (live_value != "" ? size_t(strtoul(live_value.c_str(), NULL, 10)) : size_t(IO_LIVE_DEFAULT_BACKLOG));
+
+            IO_Live_Writer *live_writer = new IO_Live_Writer;
+            if (live_writer->Open(open_filename, use_fifo, !binary, backlog))
+            {
+                sink = live_writer;
+                retry = false;
+            }
+            else
+            {
+                delete live_writer;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+        }
+        else if (use_index)
+        {
+#ifdef COMPRESS_OUTPUT
+            size_t interval = IO_GZIP_INDEX_DEFAULT_INTERVAL;
+            if (index_value != "")
+                interval = size_t(strtoul(index_value.c_str(), NULL, 10));
+            assert(interval > 0);
+            int level = IO_CODEC_DEFAULT_LEVEL;
+            if (Mode_Option(full_mode, "level", option_value))
+                level = atoi(option_value.c_str());
+
+            // The index keeps the final name, even with a durability policy.
+            IO_Gzip_Index_Writer *index_writer = new IO_Gzip_Index_Writer;
+            if (index_writer->Open(open_filename, filename + IO_GZIP_INDEX_EXTENSION, append, level, interval))
+            {
+                sink = index_writer;
+                retry = false;
+            }
+            else
+            {
+                delete index_writer;
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
+#endif // #ifdef COMPRESS_OUTPUT
+        }
+        else if (Is_Compressed())
         {
 #ifdef COMPRESS_OUTPUT
             gzFile tmp_file;
-            if (append)
-                tmp_file = gzopen(filename.c_str(), "ab");
+            if (mode == 'r')
+                tmp_file = gzopen(open_filename.c_str(), "rb");
+            else if (append)
+                tmp_file = gzopen(open_filename.c_str(), "ab");
             else
-                tmp_file = gzopen(filename.c_str(), "wb");
+                tmp_file = gzopen(open_filename.c_str(), "wb");
+            if (tmp_file == NULL)
+            {
+                if (!check_if_file_exists)
+                    return false;
+                std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'. Aborting.\n";
+                std_cout << std::flush;
+                abort();
+            }
             gzbuffer(tmp_file, DEFAULT_BUFFER_SIZE);
             compressed_fh = (void *) tmp_file;
             retry = false;
@@ -330,14 +768,14 @@ bool IO::Open_File(const std::string full_mode, const bool quiet,
         }
         else if (using_C_fh)
         {
-            C_fh = fopen(filename.c_str(), full_mode.c_str());
-std_cout << "File handle is: " << C_fh << " for name " << filename.c_str() << " in mode " << full_mode.c_str() << std::endl;
+            C_fh = fopen(open_filename.c_str(), flags.c_str());
+std_cout << "File handle is: " << C_fh << " for name " << open_filename.c_str() << " in mode " << full_mode.c_str() << std::endl;
             // Verify that the file is opened.
             if (C_fh == NULL)
             {
                 if (check_if_file_exists)
                 {
-                    std::cerr << "\nCould not open file \"" << filename << "\" for '" << full_mode << "'...\n";
+                    std::cerr << "\nCould not open file \"" << open_filename << "\" for '" << full_mode << "'...\n";
                     std::string answer = Pause("Retry? [y/N]");
                     std::transform(answer.begin(), answer.end(), answer.begin(), ::tolower);
                     if (! (answer == "y" || answer == "yes"))
@@ -351,14 +789,14 @@ std_cout << "File handle is: " << C_fh << " for name " << filename.c_str() << "
                 retry = false;
             }
         } else {
-            fh.open(filename.c_str(), file_openmode);
+            fh.open(open_filename.c_str(), file_openmode);
 
             // Verify that the file is opened.
             if (!fh.is_open())
             {
                 if (check_if_file_exists)
                 {
-                    std::cerr << "Could not open file \"" << filename << "\" for '" << full_mode << "'...\n";
+                    std::cerr << "Could not open file \"" << open_filename << "\" for '" << full_mode << "'...\n";
                     std::string answer = Pause("Retry? [y/N]");
                     std::transform(answer.begin(), answer.end(), answer.begin(), ::tolower);
                     if (! (answer == "y" || answer == "yes"))
@@ -374,6 +812,63 @@ std_cout << "File handle is: " << C_fh << " for name " << filename.c_str() << "
         }
     }
 
+    if (streaming.Is_Enabled())
+        streaming.Open(open_filename);
+
+    // Gather mode: small writes are batched for fh or C_fh,
+    // "w:gather=65536:gather_count=100" (batch size and maximum number of writes).
+    if (Mode_Option(full_mode, "gather", option_value))
+    {
+        if (mode == 'r' or sink != NULL or Is_Compressed())
+        {
+            std_cout << "ERROR: Option 'gather' is only valid for uncompressed writing through fstream or FILE* (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+            abort();
+        }
+        size_t gather_size = IO_GATHER_DEFAULT_SIZE;
+        if (option_value != "")
+            gather_size = size_t(strtoul(option_value.c_str(), NULL, 10));
+        size_t gather_count = 0;
+        if (Mode_Option(full_mode, "gather_count", option_value))
+            gather_count = size_t(strtoul(option_value.c_str(), NULL, 10));
+
+        gather = new IO_Gather;
+        gather->Start(this, gather_size, gather_count);
+    }
+
+    // Asynchronous mode: writes are buffered in memory and a
+    // background thread drains them to the file handle.
+    if (Mode_Option(full_mode, "async", option_value))
+    {
+        if (mode == 'r')
+        {
+            std_cout << "ERROR: Option 'async' is only valid for writing (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+            abort();
+        }
+        size_t buffer_size = IO_ASYNC_DEFAULT_BUFFER_SIZE;
+        if (option_value != "")
+            buffer_size = size_t(strtoul(option_value.c_str(), NULL, 10));
+        assert(buffer_size > 0);
+
+        async_writer = new IO_Async_Writer;
+        async_writer->Start(this, buffer_size);
+    }
+
+    // Multi-producer mode: every thread writes to its own buffer,
+    // merged at Flush(). "producers=ordered" sorts writes by (time, thread).
+    if (Mode_Option(full_mode, "producers", option_value))
+    {
+        if (mode == 'r' or (option_value != "" and option_value != "ordered"))
+        {
+            std_cout << "ERROR: Option 'producers' is only valid for writing, with optional value 'ordered' (mode '" << full_mode << "'). Aborting.\n" << std::flush;
+            abort();
+        }
+        producers = new IO_Producers(this, (option_value == "ordered"));
+    }
+
+    // Saved if the process dies before Close_File() (see IO_Emergency_Enable())
+    if (mode != 'r')
+        is_emergency_client = IO_Emergency_Register(this);
+
     return true;
 }
 
@@ -443,7 +938,43 @@ bool IO::Is_Output_Permitted(const double time, const bool dont_set_previous_per
 // **************************************************************
 void IO::Close_File()
 {
-    if (Is_Compressed())
+    const uint64_t start = IO_Clock_Ticks();
+
+    IO_Emergency_Unregister(this);
+
+    // Make sure everything buffered reached the file handle before closing it.
+    if (producers != NULL)
+    {
+        producers->Merge();
+        delete producers;
+        producers = NULL;
+    }
+    if (async_writer != NULL)
+    {
+        async_writer->Stop();
+        delete async_writer;
+        async_writer = NULL;
+    }
+    // The drain thread may still be saving the file: wait for it.
+    IO_Emergency_Guard guard(Handle_Lock());
+
+    if (gather != NULL)
+    {
+        gather->Flush();
+        delete gather;
+        gather = NULL;
+    }
+
+    int64_t sink_bytes = IO_SINK_FILE_BYTES;
+    if (sink != NULL)
+    {
+        sink->Close();
+        sink_bytes = sink->Get_Physical_Bytes();
+        delete sink;
+        sink = NULL;
+        ring = NULL;
+    }
+    else if (Is_Compressed())
     {
 #ifdef COMPRESS_OUTPUT
         if (compressed_fh != NULL)
@@ -463,10 +994,30 @@ void IO::Close_File()
         if (fh.is_open())
             fh.close();
     }
+    is_emergency_client = false;
 
     if (string_to_save != NULL)
         delete[] string_to_save;
     string_to_save = NULL;
+
+    if (reader != NULL)
+        delete reader;
+    reader = NULL;
+
+    stats.Close(start, sink_bytes);
+
+    streaming.Close();
+
+    // Final fsync and rename, once the file is closed.
+    durability.Close();
+
+    // Staged file: landed by the migrator thread (not if opening failed).
+    if (staged_filename != "")
+    {
+        if (access(staged_filename.c_str(), F_OK) == 0)
+            IO_Migrator::Instance().Migrate(staged_filename, filename);
+        staged_filename = "";
+    }
 }
 
 // **************************************************************
@@ -475,7 +1026,103 @@ void IO::Write(const char *p, size_t size)
     assert(Is_Open());
     assert(Is_Enable());
 
-    if (Is_Compressed())
+    const uint64_t start = stats.Start();
+
+    if (producers != NULL)
+        producers->Append(p, size);
+    else
+        Write_Serial(p, size);
+
+    stats.Record_Write(size, start, (producers != NULL));
+}
+
+// **************************************************************
+IO_Reader * IO::Reader()
+{
+    assert(Is_Open());
+
+    if (mode != 'r')
+    {
+        std_cout << "ERROR: File '" << filename << "' must be opened in 'r' mode to be read. Aborting.\n" << std::flush;
+        abort();
+    }
+    if (reader == NULL)
+        reader = new IO_Reader(filename);
+
+    return reader;
+}
+
+// **************************************************************
+bool IO::Next_Line(IO_Span &line)
+/**
+ * Next line, without its '\n'.
+ * @return false at end of file
+ */
+{
+    return Reader()->Next_Line(line);
+}
+
+// **************************************************************
+bool IO::Read(IO_Span &span, const size_t size)
+/**
+ * Next "size" bytes.
+ * @return false at end of file
+ */
+{
+    return Reader()->Read(span, size);
+}
+
+// **************************************************************
+bool IO::Next_Record(IO_Record_Header &header, IO_Span &data)
+/**
+ * Next typed record, values as stored (see IO_Reader::Next_Record()).
+ * @return false at end of file
+ */
+{
+    return Reader()->Next_Record(header, data);
+}
+
+// **************************************************************
+bool IO::Seek_Offset(const uint64_t offset)
+/**
+ * Continue reading at the given uncompressed byte (gzip files written
+ * in "index" mode, or plain files).
+ * @return false if it is past the end of the file
+ */
+{
+    return Reader()->Seek_Offset(offset);
+}
+
+// **************************************************************
+bool IO::Seek_Time(const double time)
+/**
+ * Continue reading shortly before the first write at "time" (gzip
+ * files written in "index" mode, see IO_Reader::Seek_Time()).
+ * @return false if the file is empty
+ */
+{
+    return Reader()->Seek_Time(time);
+}
+
+// **************************************************************
+void IO::Write_Serial(const char *p, size_t size)
+{
+    if (Is_Async())
+        async_writer->Append(p, size);
+    else
+        Write_Direct(p, size);
+}
+
+// **************************************************************
+void IO::Write_Direct(const char *p, size_t size)
+{
+    IO_Emergency_Guard guard(Handle_Lock());
+
+    if (sink != NULL)
+    {
+        sink->Write(p, size);
+    }
+    else if (Is_Compressed())
     {
 #ifdef COMPRESS_OUTPUT
         const int error_code = gzwrite((gzFile) compressed_fh, p, (unsigned int)size);
@@ -485,6 +1132,10 @@ void IO::Write(const char *p, size_t size)
         abort();
 #endif // #ifdef COMPRESS_OUTPUT
     }
+    else if (gather != NULL)
+    {
+        gather->Append(p, size);
+    }
     else if (using_C_fh)
     {
         fwrite(p, size, 1, C_fh);
@@ -493,6 +1144,153 @@ void IO::Write(const char *p, size_t size)
     {
         fh.write(p, size);
     }
+
+    Commit_If_Due(size);
+}
+
+// **************************************************************
+void IO::Write_Vector(const struct iovec *iov, const int nb)
+/**
+ * Write a batch of the "gather" mode. The C handle's own buffer is
+ * flushed first, then everything goes out in a single writev() (more
+ * if it is interrupted). fstream has no file descriptor: its filebuf
+ * gets one write per iovec, which it sends with its own buffer in one
+ * writev() (libstdc++) when it is large.
+ */
+{
+    if (!using_C_fh)
+    {
+        for (int i = 0 ; i < nb ; i++)
+            fh.write((const char *) iov[i].iov_base, std::streamsize(iov[i].iov_len));
+        return;
+    }
+
+    fflush(C_fh);
+    const int fd = fileno(C_fh);
+
+    std::vector<struct iovec> left(iov, iov + nb);
+    size_t first = 0;
+    while (first < left.size())
+    {
+        const ssize_t written = writev(fd, &left[first], int(left.size() - first));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std_cout << "ERROR: Could not write to file '" << filename << "': " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+
+        // Skip what was written, partially written iovec included.
+        size_t done = size_t(written);
+        while (first < left.size() and done >= left[first].iov_len)
+        {
+            done -= left[first].iov_len;
+            first++;
+        }
+        if (first < left.size())
+        {
+            left[first].iov_base = (void *) ((char *) left[first].iov_base + done);
+            left[first].iov_len -= done;
+        }
+    }
+}
+
+// **************************************************************
+void IO::Flush_Gather()
+{
+    if (gather != NULL)
+        gather->Flush();
+}
+
+// **************************************************************
+void IO::Commit_If_Due(const size_t size)
+/**
+ * Group commit: once enough data was written, push it out of our
+ * buffers and fsync() it. Streaming: drop what reached the file from
+ * the page cache. Then the rate limiter.
+ */
+{
+    if (durability.Is_Enabled() and durability.Written(size))
+    {
+        Flush_Direct();
+        durability.Sync();
+    }
+    if (streaming.Written(size))
+        streaming.Check();
+
+    // Drawn from the process' bandwidth by quanta (a no-op without a rate).
+    unmetered_bytes += size;
+    if (unmetered_bytes >= IO_RATE_LIMITER_QUANTUM)
+    {
+        IO_Rate_Limiter::Instance().Acquire(unmetered_bytes, priority);
+        unmetered_bytes = 0;
+    }
+}
+
+// **************************************************************
+void IO::Set_Durability(const IO_Durability &policy)
+/**
+ * Must be called before Open_File().
+ */
+{
+    assert(!Is_Open());
+    durability = policy;
+}
+
+// **************************************************************
+void IO::Write_Record(const char kind, const size_t element_size,
+                      const char *first, const size_t count, const ptrdiff_t stride,
+                      const IO_Endianness order)
+/**
+ * Write a typed record: header and values are gathered (and byte
+ * swapped if needed) into record_buffer, then written in one call.
+ * Records with more than 2^32-1 values are split.
+ */
+{
+    assert(element_size < 256);
+
+    const bool host_big_endian  = IO_Is_Host_Big_Endian();
+    const bool big_endian       = (order == IO_Native_Endian ? host_big_endian : (order == IO_Big_Endian));
+    const bool swap             = (big_endian != host_big_endian);
+
+    // Each thread assembles its records separately in "producers" mode.
+    std::vector<char> &buffer   = (producers != NULL ? producers->Scratch() : record_buffer);
+
+    size_t done = 0;
+    do
+    {
+        const size_t n = std::min(count - done, size_t(IO_RECORD_MAX_COUNT));
+
+        buffer.resize(IO_RECORD_HEADER_SIZE + n*element_size);
+        char *header = &buffer[0];
+        header[0] = kind;
+        header[1] = char(element_size);
+        header[2] = (big_endian ? 'B' : 'L');
+        header[3] = char(IO_RECORD_VERSION);
+        const uint32_t count32 = uint32_t(n);
+        memcpy(header + 4, &count32, sizeof(uint32_t));
+        if (swap)
+            IO_Swap_Bytes(header + 4, sizeof(uint32_t), 1);
+
+        char *data = header + IO_RECORD_HEADER_SIZE;
+        const char *source = first + ptrdiff_t(done)*stride;
+        if (stride == ptrdiff_t(element_size))
+        {
+            memcpy(data, source, n*element_size);
+        }
+        else
+        {
+            for (size_t i = 0 ; i < n ; i++)
+                memcpy(data + i*element_size, source + ptrdiff_t(i)*stride, element_size);
+        }
+        if (swap)
+            IO_Swap_Bytes(data, element_size, n);
+
+        Write(&buffer[0], buffer.size());
+
+        done += n;
+    } while (done < count);
 }
 
 // **************************************************************
@@ -500,10 +1298,34 @@ void IO::WriteString(const std::string &format, ...)
 {
     assert(Is_Open());
 
+    const uint64_t start = stats.Start();
+
     va_list args;
     va_start(args, format);
 
-    if (Is_Compressed() or !using_C_fh)
+    // string_to_save is shared: format directly into the thread's buffer.
+    if (producers != NULL)
+    {
+        const size_t length = producers->Append_Formatted(format.c_str(), args);
+        va_end(args);
+        stats.Record_Write_String(length, start, true);
+        return;
+    }
+
+    // The async buffers have their own lock.
+    IO_Emergency_Guard guard(Is_Async() ? NULL : Handle_Lock());
+
+    // Formatted directly into the batch ("gather" mode)
+    if (gather != NULL and !Is_Async())
+    {
+        const size_t length = gather->Append_Formatted(format.c_str(), args);
+        va_end(args);
+        Commit_If_Due(length);
+        stats.Record_Write_String(length, start, false);
+        return;
+    }
+
+    if (Is_Async() or sink != NULL or Is_Compressed() or !using_C_fh)
     {
         if (string_to_save == NULL)
         {
@@ -519,31 +1341,179 @@ void IO::WriteString(const std::string &format, ...)
         }
         va_end(args);
 
-        if (Is_Compressed())
+        if (Is_Async())
+        {
+            async_writer->Append(string_to_save, size_t(result));
+        }
+        else if (sink != NULL)
+        {
+            sink->Write(string_to_save, size_t(result));
+            Commit_If_Due(size_t(result));
+        }
+        else if (Is_Compressed())
         {
 #ifdef COMPRESS_OUTPUT
-        const int error_code = gzwrite((gzFile) compressed_fh, string_to_save, (unsigned int)strlen(string_to_save));
+        const int error_code = gzwrite((gzFile) compressed_fh, string_to_save, (unsigned int)result);
         assert(error_code != 0);
 #else
         std_cout << "Can't be here!!! (" << __FILE__ << " line " << __LINE__ << "). Aborting.\n" << std::flush;
         abort();
 #endif // #ifdef COMPRESS_OUTPUT
+            Commit_If_Due(size_t(result));
         }
         else
         {
             fh << string_to_save;
+            Commit_If_Due(size_t(result));
         }
+        stats.Record_Write_String(size_t(result), start, false);
     }
     else
     {
-        vfprintf(C_fh, format.c_str(), args);
+        const int result = vfprintf(C_fh, format.c_str(), args);
+        va_end(args);
+        Commit_If_Due(result > 0 ? size_t(result) : 0);
+        stats.Record_Write_String(result > 0 ? size_t(result) : 0, start, false);
     }
 }
 
 // **************************************************************
 void IO::Flush()
 {
-    if (Is_Compressed())
+    const uint64_t start = IO_Clock_Ticks();
+
+    if (producers != NULL)
+        producers->Merge();
+
+    // Wait for the background writer to hand everything to the file handle
+    if (Is_Async())
+        async_writer->Drain();
+
+    Flush_Direct();
+
+    stats.Record_Flush(start);
+}
+
+// **************************************************************
+void IO::Emergency_Flush(const int signal_number, const bool is_fatal)
+/**
+ * At exit(), close the file as Close_File() does.
+ *
+ * After a signal (from IO_Emergency's drain thread), writers are stopped
+ * first: the drain takes the lock they hold while using the file
+ * handles. If it is still held after IO_EMERGENCY_LOCK_WAIT seconds (the
+ * interrupted thread was writing to this file), the file is left alone.
+ * If the process goes on, what reached the handles is flushed. If it
+ * dies next, the async buffers and the gather batch are written too and
+ * the file is closed, compressed streams and codec or "threads" blocks
+ * finished; writers wait for the end.
+ *
+ * Lost after a signal: the threads' buffers of "producers" mode (the
+ * threads may still be appending). A durability policy is not committed
+ * (the file keeps its temporary name) and a staged file is not migrated.
+ */
+{
+    if (signal_number == 0)
+    {
+        Close_File();
+        return;
+    }
+    if (!emergency_lock.Try_Acquire(IO_EMERGENCY_LOCK_WAIT))
+        return;
+
+    if (!is_fatal)
+    {
+        Flush_Direct();
+        emergency_lock.Release();
+        return;
+    }
+
+    if (Is_Async())
+        async_writer->Emergency_Write();
+    Flush_Gather();
+
+    // Flight recorders were dumped by the signal handler.
+    if (sink != NULL)
+    {
+        if (sink != ring)
+            sink->Close();
+    }
+    else if (Is_Compressed())
+    {
+#ifdef COMPRESS_OUTPUT
+        if (compressed_fh != NULL)
+            gzclose((gzFile) compressed_fh);
+        compressed_fh = NULL;
+#endif // #ifdef COMPRESS_OUTPUT
+    }
+    else if (using_C_fh)
+    {
+        if (C_fh != NULL)
+            fclose(C_fh);
+        C_fh = NULL;
+    } else {
+        if (fh.is_open())
+            fh.close();
+    }
+    // The lock is kept: the process ends next.
+}
+
+// **************************************************************
+void IO::Dump(const std::string reason)
+/**
+ * Write what the flight recorder ("ring" mode) holds to the file,
+ * preceded in text files by a '#' line giving the reason. Nothing
+ * to do in other modes.
+ */
+{
+    if (ring == NULL)
+        return;
+
+    if (producers != NULL)
+        producers->Merge();
+
+    ring->Dump(reason);
+}
+
+// **************************************************************
+void IO::Set_Time(const double time)
+/**
+ * Time of the following writes. Used to order the threads' writes
+ * in "producers=ordered" mode, as the time of the restart points
+ * in "index" mode, and to expire old records in "ring_time" mode.
+ */
+{
+    if (producers != NULL)
+        producers->Set_Time(time);
+    if (sink != NULL)
+    {
+        IO_Emergency_Guard guard(Handle_Lock());
+        sink->Set_Time(time);
+    }
+}
+
+// **************************************************************
+size_t IO::Get_Nb_Subscribers()
+/**
+ * Readers connected to live output ("socket" or "fifo"), as of the
+ * last Write(), Flush() or Set_Time().
+ */
+{
+    return (sink != NULL ? sink->Get_Nb_Subscribers() : 0);
+}
+
+// **************************************************************
+void IO::Flush_Direct()
+{
+    IO_Emergency_Guard guard(Handle_Lock());
+
+    Flush_Gather();
+
+    if (sink != NULL)
+    {
+        sink->Flush();
+    }
+    else if (Is_Compressed())
     {
 #ifdef COMPRESS_OUTPUT
         gzflush((gzFile) compressed_fh, Z_FINISH);
@@ -584,6 +1554,11 @@ void IO::Format(const int width,
  */
 {
     assert(!using_C_fh);
+    // Async mode writes raw bytes: stream manipulators would be lost.
+    assert(!Is_Async());
+    assert(!Is_Multi_Producer());
+    // Manipulators apply to what comes next, after the gathered writes.
+    Flush_Gather();
 
     if (width > 0)
         fh << std::setw(width);
@@ -612,6 +1587,7 @@ void IO::Print()
         << "    period:                  " << period << std::endl
         << "    last_saved_time:         " << last_saved_time << std::endl
         << "    Style:                   " << (using_C_fh ? "C" : "C++") << std::endl
+        << "    async:                   " << (Is_Async() ? "yes" : "no ") << std::endl
         << "    is_open():               " << (Is_Open() ? "yes" : "no") << std::endl
         << "    mode:                    " << (Is_Open() ? mode : '-') << std::endl
         << "    binary:                  " << (binary ? "yes" : "no ") << std::endl
@@ -619,6 +1595,12 @@ void IO::Print()
     ;
 }
 
+// **************************************************************
+void IO::Print_Stats()
+{
+    stats.Print(filename);
+}
+
 // **************************************************************
 ReadXML::ReadXML(const std::string _name, const std::string _filename)
 {
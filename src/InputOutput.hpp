@@ -15,6 +15,13 @@ using namespace boost;
 #endif // #ifdef __PGI
 
 #include "tinyxml.hpp"
+#include "IO_Records.hpp"
+#include "IO_Durability.hpp"
+#include "IO_Streaming.hpp"
+#include "IO_Rate_Limiter.hpp"
+#include "IO_Stats.hpp"
+#include "IO_Reader.hpp"
+#include "IO_Emergency.hpp"
 
 
 namespace inputoutput
@@ -33,7 +40,18 @@ void Create_Folder_If_Does_Not_Exists(const std::string path);
 
 FILE * Open_File(const std::string &filename, const std::string &mode, const bool quiet = false);
 
-class IO
+std::string Mode_Flags(const std::string &full_mode);
+bool Mode_Option(const std::string &full_mode, const std::string &key, std::string &value);
+
+class IO_Async_Writer;
+class IO_Sink;
+class IO_Gather;
+class IO_Ring_Buffer;
+struct iovec;
+class IO_Producers;
+class IO_Scheduler;
+
+class IO : public IO_Emergency_Client
 {
     private:
         bool enable;            // Is output enabled?
@@ -48,8 +66,16 @@ class IO
         bool using_C_fh;
         void *compressed_fh;
         char *string_to_save;
+        IO_Async_Writer *async_writer;  // Background writer ("async" mode)
+        IO_Producers *producers;        // Per-thread buffers ("producers" mode)
+        IO_Sink *sink;          // Alternate backend selected by mode options
+        IO_Gather *gather;      // Write coalescing ("gather" mode)
+        IO_Ring_Buffer *ring;   // Same object as sink in "ring" mode
+        IO_Reader *reader;      // Read API ('r' mode), created at first use
+        std::vector<char> record_buffer;    // Typed record being assembled
 
         std::string filename;   // File name
+        std::string staged_filename;    // Written to in "stage" mode, migrated at Close_File()
         char mode;              // Read or write?
         bool binary;            // Binary file?
         bool append;            // Append to file?
@@ -59,6 +85,45 @@ class IO
         // Do we want to disable IO at next iteration?
         bool disable_at_next_iteration;
 
+        // Scheduler this object is registered in (see IO_Scheduler)
+        friend class IO_Scheduler;
+        IO_Scheduler *scheduler;
+        int scheduler_index;
+        void Notify_Scheduler();
+
+        // Write to the actual file handle, bypassing the async buffers.
+        friend class IO_Async_Writer;
+        void Write_Direct(const char *p, size_t size);
+        void Flush_Direct();
+
+        // Batches of the "gather" mode, written to fh or C_fh.
+        friend class IO_Gather;
+        void Write_Vector(const struct iovec *iov, const int nb);
+        void Flush_Gather();
+
+        IO_Durability durability;       // Copy of the policy set by Set_Durability()
+        IO_Streaming streaming;         // Page cache policy ("stream" mode)
+        IO_Rate_Limiter::Priority priority; // Class drawn from the rate limiter ("priority" mode)
+        uint64_t unmetered_bytes;       // Written, not drawn yet
+        void Commit_If_Due(const size_t size);
+
+        IO_Stats stats;                 // Counters and latencies, see Print_Stats()
+
+        // Held around uses of the file handles once registered (see IO_Emergency_Lock)
+        IO_Emergency_Lock emergency_lock;
+        bool is_emergency_client;
+        inline IO_Emergency_Lock * Handle_Lock()    { return (is_emergency_client ? &emergency_lock : NULL); }
+
+        IO_Reader * Reader();
+
+        // Write from a single thread: to the async buffers or the file handle.
+        friend class IO_Producers;
+        void Write_Serial(const char *p, size_t size);
+
+        void Write_Record(const char kind, const size_t element_size,
+                          const char *first, const size_t count, const ptrdiff_t stride,
+                          const IO_Endianness order);
+
     public:
 
         void Clear();
@@ -80,19 +145,61 @@ class IO
         void Write(const char *p, size_t size);
         void WriteString(const std::string &format, ...);
 
+        // Read API ('r' mode): spans point into the file's mapping or
+        // inflated window, no copy (see IO_Reader).
+        bool Next_Line(IO_Span &line);
+        bool Read(IO_Span &span, const size_t size);
+        bool Next_Record(IO_Record_Header &header, IO_Span &data);
+        bool Seek_Offset(const uint64_t offset);
+        bool Seek_Time(const double time);
+
+        // Typed binary records, read back with IO_Record_Reader. Each call
+        // writes a small header (type, size, byte order, count) followed
+        // by the values, copied once into a buffer and written in one call.
+        template <class T>
+        void Write(const T &value, const IO_Endianness order = IO_Native_Endian)
+        {
+            Write_Record(IO_Type_Kind<T>::value, sizeof(T), (const char *) &value, 1, sizeof(T), order);
+        }
+        template <class T>
+        void Write(const T *array, const size_t count, const IO_Endianness order = IO_Native_Endian)
+        {
+            Write_Record(IO_Type_Kind<T>::value, sizeof(T), (const char *) array, count, sizeof(T), order);
+        }
+        template <class T>
+        void Write(const IO_Strided<T> &view, const IO_Endianness order = IO_Native_Endian)
+        {
+            Write_Record(IO_Type_Kind<T>::value, sizeof(T), (const char *) view.first, view.count, view.stride, order);
+        }
+
         inline bool             Is_Enable()                 { return enable;    }
         inline bool             Is_Compressed()             { return compressed;    }
-        inline bool             Is_Open()                   { return (compressed_fh != NULL ? true : (using_C_fh ? ((C_fh != NULL) ? true : false ) : (fh.is_open() ? true : false))); }
-        inline std::fstream&    Fh()                        { return fh;        }
-        inline FILE *           C_Fh()                      { return C_fh;      }
+        inline bool             Is_Async()                  { return (async_writer != NULL); }
+        inline IO_Async_Writer* Async_Writer()              { return async_writer; }
+        inline bool             Is_Multi_Producer()         { return (producers != NULL); }
+        inline bool             Is_Open()                   { return (sink != NULL ? true : compressed_fh != NULL ? true : (using_C_fh ? ((C_fh != NULL) ? true : false ) : (fh.is_open() ? true : false))); }
+        // Direct use of the handles comes after the writes still gathered.
+        inline std::fstream&    Fh()                        { if (gather != NULL) Flush_Gather(); return fh;   }
+        inline FILE *           C_Fh()                      { if (gather != NULL) Flush_Gather(); return C_fh; }
         inline std::string      Get_Filename()              { return filename;  }
         inline double           Get_Period()                { return period;    }
-        inline void             Force_At_Next_Iteration()   { force_at_next_iteration = true; }
-        inline void             Disable_At_Next_Iteration() { disable_at_next_iteration = true; }
+        inline double           Get_Last_Saved_Time()       { return last_saved_time; }
+        inline void             Force_At_Next_Iteration()   { force_at_next_iteration = true;   if (ring != NULL) Dump("forced"); Notify_Scheduler(); }
+        inline void             Disable_At_Next_Iteration() { disable_at_next_iteration = true; Notify_Scheduler(); }
         inline bool             Is_Forced_At_Next_Iteration()   { return (force_at_next_iteration ? true : false);   }
         inline bool             Is_Disabled_At_Next_Iteration() { return (disable_at_next_iteration ? true : false); }
 
         void Flush();
+        void Emergency_Flush(const int signal_number, const bool is_fatal);
+        void Dump(const std::string reason = "trigger");
+        void Set_Time(const double time);
+        void Set_Durability(const IO_Durability &policy);
+        inline IO_Durability &  Get_Durability()            { return durability; }
+        inline IO_Streaming &   Get_Streaming()             { return streaming; }
+        inline IO_Rate_Limiter::Priority Get_Priority()     { return priority;  }
+        inline IO_Stats &       Get_Stats()                 { return stats;     }
+        size_t Get_Nb_Subscribers();
+        void Print_Stats();
         void Format(const int width, const int nb_after_dot, const char type, const char justify='r', const char fill=' ');
 
         bool Is_Output_Permitted(const double time, const bool dont_set_previous_period = false);
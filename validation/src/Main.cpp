@@ -4,11 +4,130 @@
  ***************************************************************/
 
 #include <cstdlib>
+#include <cstring> // strerror()
+#include <cerrno>
 #include <iostream>
+#include <algorithm> // std::replace()
+#include <sys/time.h> // gettimeofday()
+#include <sys/wait.h> // waitpid()
+#include <sys/stat.h> // mkfifo(), stat()
+#include <fcntl.h> // open()
+#include <unistd.h> // fork(), pipe(), read(), write(), usleep()
 
 #include <InputOutput.hpp>
+#include <IO_Async_Writer.hpp>
+#include <IO_Columns.hpp>
+#include <IO_Text_Parser.hpp>
+#include <IO_Segments.hpp>
+#include <IO_Migrator.hpp>
+#include <IO_Live.hpp>
+#include <IO_Scheduler.hpp>
 #include <Classes_NetCDF.hpp>
 
+// **************************************************************
+double Wall_Time()
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return double(now.tv_sec) + 1.0e-6*double(now.tv_usec);
+}
+
+// **************************************************************
+pid_t Start_Slow_Disk(const std::string &fifo_name)
+/**
+ * Stand-in for a slow file system: a named pipe drained by a child
+ * process that stops for 20 ms after every MiB, like a parallel file
+ * system server busy with someone else's checkpoint.
+ */
+{
+    unlink(fifo_name.c_str());
+    if (mkfifo(fifo_name.c_str(), 0644) != 0)
+    {
+        std_cout << "ERROR: Could not create named pipe '" << fifo_name << "'. Aborting.\n" << std::flush;
+        abort();
+    }
+
+    // Not printed twice by the child
+    std_cout << std::flush;
+    const pid_t reader = fork();
+    if (reader == 0)
+    {
+        const int fd = open(fifo_name.c_str(), O_RDONLY);
+        char buffer[65536];
+        size_t since_pause = 0;
+        ssize_t nb_read;
+        while ((nb_read = read(fd, buffer, sizeof(buffer))) != 0)
+        {
+            if (nb_read < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            since_pause += size_t(nb_read);
+            if (since_pause >= 1024*1024)
+            {
+                usleep(20000);
+                since_pause = 0;
+            }
+        }
+        _exit(0);
+    }
+    return reader;
+}
+
+// **************************************************************
+void Measure_Stall(const std::string mode, const int nb_records, const bool slow_disk = false)
+/**
+ * Time spent by the caller inside WriteString(), as the simulation
+ * loop would see it, and total time including Close_File(). With
+ * "slow_disk", the file is a named pipe drained by Start_Slow_Disk().
+ */
+{
+    // Build a file name from the mode string ("wz:threads=4" gives "stall_wz_threads_4.txt")
+    std::string name = mode;
+    std::replace(name.begin(), name.end(), ':', '_');
+    std::replace(name.begin(), name.end(), '=', '_');
+    if (slow_disk)
+        name = "slow_" + name;
+
+    const std::string filename = "output/stall_" + name + ".txt";
+    const pid_t slow_reader = (slow_disk ? Start_Slow_Disk(filename) : 0);
+
+    IO stall_test(true);
+    stall_test.Set_Filename(filename);
+    const double open_time = Wall_Time();
+    stall_test.Open_File(mode, true);
+
+    double total = 0.0;
+    double worst = 0.0;
+    for (int i = 0 ; i < nb_records ; i++)
+    {
+        const double start = Wall_Time();
+        stall_test.WriteString("%d %.16g %.16g %.16g\n", i, 1.0*i, 2.0*i, 3.0*i);
+        const double duration = Wall_Time() - start;
+        total += duration;
+        if (duration > worst)
+            worst = duration;
+    }
+    const double close_start = Wall_Time();
+    stall_test.Close_File();
+    const double close_duration = Wall_Time() - close_start;
+    if (slow_disk)
+    {
+        waitpid(slow_reader, NULL, 0);
+        unlink(filename.c_str());
+    }
+
+    std_cout
+        << "Mode '" << mode << "'" << (slow_disk ? " (slow disk)" : "") << ": " << nb_records << " records, "
+        << "time in WriteString() = " << total << " s, "
+        << "worst call = " << 1.0e6*worst << " us, "
+        << "Close_File() = " << close_duration << " s, "
+        << "total = " << (Wall_Time() - open_time) << " s\n";
+    stall_test.Print_Stats();
+}
+
 // **************************************************************
 int main(int argc, char *argv[])
 {
@@ -16,6 +135,9 @@ int main(int argc, char *argv[])
     // Open log file
     std_cout.open("output/output.log");
 
+    // Outputs still open are saved if the run is killed (e.g. walltime SIGTERM)
+    IO_Emergency_Enable();
+
     // **********************************************************
     // IO class
     IO test(true);
@@ -33,6 +155,253 @@ int main(int argc, char *argv[])
     test.Close_File();
     delete[] array;
 
+    // Read it back, line by line, without copies
+    {
+        IO test_in(true);
+        test_in.Set_Filename("output/test.txt");
+        test_in.Open_File("rz");
+        IO_Span line;
+        double sum = 0.0;
+        while (test_in.Next_Line(line))
+            sum += atof(line.String().c_str());
+        test_in.Close_File();
+        std_cout << "Sum of values read back: " << sum << "\n";
+    }
+
+    // Seekable gzip: jump to a time without inflating what precedes it
+    {
+        IO indexed(true);
+        indexed.Set_Filename("output/indexed.txt");
+        indexed.Open_File("wz:index=65536");
+        for (int step = 0 ; step < 100000 ; step++)
+        {
+            indexed.Set_Time(0.01 * step);
+            indexed.WriteString("%.2f %d\n", 0.01 * step, step);
+        }
+        indexed.Close_File();
+
+        indexed.Set_Filename("output/indexed.txt");
+        indexed.Open_File("rz");
+        IO_Span line;
+        indexed.Seek_Time(900.0);
+        while (indexed.Next_Line(line) && atof(line.String().c_str()) < 900.0)
+            ;
+        std_cout << "First line at time 900: " << line.String() << "\n";
+        indexed.Close_File();
+    }
+
+    // Stall time of the simulation loop: synchronous vs asynchronous writes
+    Measure_Stall("w",        1000000);
+    Measure_Stall("w:async",  1000000);
+    Measure_Stall("wz",       200000);
+    Measure_Stall("wz:async", 200000);
+    Measure_Stall("w:mmap",   1000000);
+    Measure_Stall("w:uring",  1000000);
+
+    // On a slow file system, the simulation only waits when both async buffers are full
+    Measure_Stall("w",       1000000, true);
+    Measure_Stall("w:async", 1000000, true);
+
+    // Block-parallel gzip: throughput should scale with the number of threads
+    Measure_Stall("wz:threads=1", 200000);
+    Measure_Stall("wz:threads=2", 200000);
+    Measure_Stall("wz:threads=4", 200000);
+
+    // Rotated output: 1 MiB segments, compressed in the background, read back as one
+    {
+        IO rotated(true);
+        rotated.Set_Filename("output/rotated.txt");
+        rotated.Open_File("w:rotate=1048576");
+        for (int step = 0 ; step < 200000 ; step++)
+        {
+            rotated.Set_Time(0.01 * step);
+            rotated.WriteString("%.2f %d\n", 0.01 * step, step);
+        }
+        rotated.Close_File();
+
+        IO_Segments_Reader reader("output/rotated.txt");
+        IO_Span line;
+        int nb_lines = 0;
+        while (reader.Next_Line(line))
+            nb_lines++;
+        std_cout << "Rotated output: " << reader.Get_Segments().size() << " segments, " << nb_lines << " lines\n";
+    }
+
+    // Flight recorder: only the last 1000 steps before the trigger are written
+    {
+        IO recorder(true);
+        recorder.Set_Filename("output/recorder.txt");
+        recorder.Open_File("w:ring=1000");
+        for (int step = 0 ; step < 1000000 ; step++)
+        {
+            recorder.Set_Time(0.01 * step);
+            recorder.WriteString("%.2f %d\n", 0.01 * step, step);
+        }
+        recorder.Dump("end of run");
+        recorder.Close_File();
+    }
+
+    // Staged in a local folder, migrated in the background at 100 MB/s
+    {
+        IO_Migrator::Instance().Set_Bandwidth(100.0e6);
+        IO staged(true);
+        staged.Set_Filename("output/staged.txt");
+        staged.Open_File("w:stage=/tmp/io_staging");
+        for (int step = 0 ; step < 100000 ; step++)
+            staged.WriteString("%d\n", step);
+        staged.Close_File();
+        IO_Migrator::Instance().Wait();
+        IO_Migrator::Instance().Print();
+    }
+
+    // Live output to a monitoring process subscribed to a UNIX socket
+    {
+        IO live(true);
+        live.Set_Filename("output/live.sock");
+        live.Open_File("w:socket");
+
+        // The subscriber tells through a pipe that it is connected.
+        int connected[2];
+        if (pipe(connected) != 0)
+        {
+            std_cout << "ERROR: Could not create a pipe: " << strerror(errno) << ". Aborting.\n" << std::flush;
+            abort();
+        }
+        std_cout << std::flush;
+        const pid_t subscriber = fork();
+        if (subscriber == 0)
+        {
+            close(connected[0]);
+            IO_Live_Reader reader;
+            const char is_connected = (reader.Open("output/live.sock", 10.0) ? 1 : 0);
+            if (write(connected[1], &is_connected, 1) != 1 || !is_connected)
+                _exit(1);
+            int nb_records = 0;
+            while (reader.Next())
+                nb_records++;
+            std_cout << "Live subscriber: " << nb_records << " records, " << reader.Get_Nb_Missed() << " missed, last at time " << reader.Get_Time() << "\n" << std::flush;
+            _exit(0);
+        }
+        close(connected[1]);
+
+        // Take the subscriber (it gets its hello frame) before writing.
+        for (int waited = 0 ; live.Get_Nb_Subscribers() == 0 && waited < 10000 ; waited += 10)
+        {
+            live.Flush();
+            usleep(10000);
+        }
+        char is_connected = 0;
+        if (read(connected[0], &is_connected, 1) != 1 || !is_connected)
+            std_cout << "WARNING: The live subscriber could not connect.\n";
+        close(connected[0]);
+
+        for (int step = 0 ; step < 100000 ; step++)
+        {
+            live.Set_Time(0.01 * step);
+            live.WriteString("%.2f %d\n", 0.01 * step, step);
+        }
+        live.Close_File();
+        waitpid(subscriber, NULL, 0);
+    }
+
+    // Numeric columns of a text file, parsed in parallel
+    {
+        IO_Text_Parser parser("output/stall_w.txt");
+        std::vector<double> third;
+        parser.Read(2, third);
+        std_cout << "Parsed " << parser.Get_Nb_Columns() << " columns, last value of the third = " << third.back() << "\n";
+    }
+
+    // Typed binary records, read back portably
+    {
+        double positions[3] = {1.0, 2.0, 3.0};
+        IO records(true);
+        records.Set_Filename("output/records.bin");
+        records.Open_File("wb");
+        records.Write(int(3));                          // Scalar, native byte order
+        records.Write(positions, 3, IO_Big_Endian);     // Array, explicit byte order
+        records.Close_File();
+
+        IO_Record_Reader reader("output/records.bin");
+        IO_Record_Header header;
+        std::vector<int>    nb;
+        std::vector<double> read_positions;
+        reader.Next(header);
+        reader.Read(nb);
+        reader.Next(header);
+        reader.Read(read_positions);
+        std_cout << "Records read back: " << nb[0] << " values, last = " << read_positions[2] << "\n";
+    }
+
+    // Diagnostics written from inside a parallel loop, merged in (time, thread) order
+    {
+        IO diagnostics(true);
+        diagnostics.Set_Filename("output/diagnostics.txt");
+        diagnostics.Open_File("w:producers=ordered");
+        for (int step = 0 ; step < 10 ; step++)
+        {
+            diagnostics.Set_Time(0.1 * step);
+            #pragma omp parallel for
+            for (int i = 0 ; i < 1000 ; i++)
+                diagnostics.WriteString("%d %d\n", step, i);
+            diagnostics.Flush();
+        }
+        diagnostics.Close_File();
+    }
+
+    // Many periodic outputs driven by a scheduler
+    {
+        const int nb_outputs = 100;
+        IO outputs[nb_outputs];
+        IO_Scheduler scheduler;
+        for (int i = 0 ; i < nb_outputs ; i++)
+        {
+            outputs[i].Init(0.01 * (i+1), "output/scheduled.txt");
+            scheduler.Add(&outputs[i]);
+        }
+        uint64_t nb_due = 0;
+        for (double time = 0.0 ; time < 10.0 ; time += 0.001)
+            nb_due += scheduler.Due(time).size();
+        std_cout << "Scheduler: " << nb_due << " outputs due for " << scheduler.Get_Nb_Streams() << " streams\n";
+    }
+
+    // Column-oriented time series, one column read back
+    {
+        double time;
+        double energy;
+        int    step;
+        IO_Columns_Out series;
+        series.Init(-1.0, "output/series.col");
+        series.Add_Column("time",   &time,   "s");
+        series.Add_Column("energy", &energy, "J");
+        series.Add_Column("step",   &step);
+        series.Open_File("w:gorilla");
+        // The same rows, gzipped, for comparison
+        IO series_z(true);
+        series_z.Set_Filename("output/series.bin");
+        series_z.Open_File("wbz");
+        for (step = 0 ; step < 5000 ; step++)
+        {
+            time   = 0.01 * step;
+            energy = 0.5 * time * time;
+            series.Append_Row();
+            series_z.Write((const char *) &time,   sizeof(time));
+            series_z.Write((const char *) &energy, sizeof(energy));
+            series_z.Write((const char *) &step,   sizeof(step));
+        }
+        series.Close_File();
+        series_z.Close_File();
+
+        struct stat gorilla_stat, z_stat;
+        if (stat("output/series.col", &gorilla_stat) == 0 && stat(series_z.Get_Filename().c_str(), &z_stat) == 0)
+            std_cout << "Columns: " << gorilla_stat.st_size << " bytes with 'gorilla', " << z_stat.st_size << " with 'z'\n";
+
+        IO_Columns_In columns("output/series.col");
+        std::vector<double> energies;
+        columns.Read("energy", energies);
+        std_cout << "Columns read back: " << columns.Get_Nb_Rows() << " rows, last energy = " << energies.back() << " " << columns.Get_Column_Units(columns.Column_Index("energy")) << "\n";
+    }
+
     // Save every "period" to the file. Set period to "-1" to save every time step.
     const double dt     = 0.01;
     const double tmax   = 100.0;
@@ -75,6 +444,22 @@ int main(int argc, char *argv[])
     cdf_file_in.Read("float_to_save",  &float_to_save);
     cdf_file_in.Read("float_array",     float_array); // float_array is already a pointer.
 
+    // Same variables, published to a shared-memory channel instead of a file
+    NetCDF_Out cdf_channel_out;
+    cdf_channel_out.Set_Channel(IO_Shm_Channel("/io_validation", 2, IO_Shm_Channel::Drop));
+    cdf_channel_out.Open("output", "channel.cdf");
+    cdf_channel_out.Add_Variable_Scalar("int_to_save",  netcdf_type_int,    &int_to_save, "Int units");
+    cdf_channel_out.Add_Variable_1D("float_array",      netcdf_type_float,   float_array, 5, "Five", "Array units");
+    cdf_channel_out.Write();
+
+    IO_Shm_Channel_Reader cdf_channel_in("/io_validation", 1.0);
+    while (cdf_channel_in.Next(0.0))
+    {
+        std_cout << "Channel snapshot " << cdf_channel_in.Get_Sequence() << ": int_to_save = " << *cdf_channel_in.Get<int>("int_to_save")
+                 << ", float_array[4] = " << cdf_channel_in.Get<float>("float_array")[4] << "\n";
+    }
+    cdf_channel_out.Close();
+
 
     // **********************************************************
     // XML class